@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "app_adpcm.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// 编码一个采样, 同时按解码器的方式更新预测值
+static uint8_t adpcm_encode_sample(app_adpcm_encoder_t *enc, int16_t sample)
+{
+    int32_t step = step_table[enc->index];
+    int32_t diff = sample - enc->predictor;
+    uint8_t nibble = 0;
+
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    int32_t delta = step >> 3;
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 1;
+        delta += step;
+    }
+
+    enc->predictor += (nibble & 8) ? -delta : delta;
+    if (enc->predictor > INT16_MAX) {
+        enc->predictor = INT16_MAX;
+    } else if (enc->predictor < INT16_MIN) {
+        enc->predictor = INT16_MIN;
+    }
+
+    enc->index += index_table[nibble];
+    if (enc->index < 0) {
+        enc->index = 0;
+    } else if (enc->index > 88) {
+        enc->index = 88;
+    }
+    return nibble;
+}
+
+// 编码收集满的一个块: 4 字节块头 (首个采样和步长索引), 之后每字节两个采样, 低 4 位在前
+static void adpcm_encode_block(app_adpcm_encoder_t *enc, uint8_t *out)
+{
+    enc->predictor = enc->block[0];
+    out[0] = (uint8_t)(enc->block[0] & 0xff);
+    out[1] = (uint8_t)((uint16_t)enc->block[0] >> 8);
+    out[2] = (uint8_t)enc->index;
+    out[3] = 0;
+
+    uint8_t *p = out + 4;
+    for (int i = 1; i < APP_ADPCM_SAMPLES_PER_BLOCK; i += 2) {
+        uint8_t lo = adpcm_encode_sample(enc, enc->block[i]);
+        uint8_t hi = adpcm_encode_sample(enc, enc->block[i + 1]);
+        *p++ = lo | (hi << 4);
+    }
+}
+
+void app_adpcm_encoder_reset(app_adpcm_encoder_t *enc)
+{
+    enc->count = 0;
+    enc->predictor = 0;
+    enc->index = 0;
+    enc->samples = 0;
+}
+
+size_t app_adpcm_encode(app_adpcm_encoder_t *enc, const int16_t *pcm, size_t samples, size_t stride, uint8_t *out, size_t out_size)
+{
+    size_t written = 0;
+
+    for (size_t i = 0; i < samples; i++) {
+        enc->block[enc->count++] = pcm[i * stride];
+        if (enc->count < APP_ADPCM_SAMPLES_PER_BLOCK) {
+            continue;
+        }
+        enc->count = 0;
+        if (out_size - written < APP_ADPCM_BLOCK_SIZE) {
+            // 输出已满, 丢弃剩余输入
+            break;
+        }
+        adpcm_encode_block(enc, out + written);
+        written += APP_ADPCM_BLOCK_SIZE;
+        enc->samples += APP_ADPCM_SAMPLES_PER_BLOCK;
+    }
+    return written;
+}
+
+size_t app_adpcm_encoder_flush(app_adpcm_encoder_t *enc, uint8_t *out, size_t out_size)
+{
+    size_t count = enc->count;
+    if (count == 0 || out_size < APP_ADPCM_BLOCK_SIZE) {
+        enc->count = 0;
+        return 0;
+    }
+
+    for (size_t i = count; i < APP_ADPCM_SAMPLES_PER_BLOCK; i++) {
+        enc->block[i] = enc->block[count - 1];
+    }
+    adpcm_encode_block(enc, out);
+    enc->count = 0;
+    enc->samples += count;
+    return APP_ADPCM_BLOCK_SIZE;
+}
+
+void app_adpcm_wav_header(app_adpcm_wav_header_t *head, uint32_t sample_rate, uint32_t samples, uint32_t data_size)
+{
+    memcpy(head->riff, "RIFF", 4);
+    head->riff_size = sizeof(app_adpcm_wav_header_t) - 8 + data_size;
+    memcpy(head->wave, "WAVE", 4);
+    memcpy(head->fmt, "fmt ", 4);
+    head->fmt_size = 20;
+    head->audio_format = 0x11;
+    head->channels = 1;
+    head->sample_rate = sample_rate;
+    head->byte_rate = sample_rate * APP_ADPCM_BLOCK_SIZE / APP_ADPCM_SAMPLES_PER_BLOCK;
+    head->block_align = APP_ADPCM_BLOCK_SIZE;
+    head->bits_per_sample = 4;
+    head->extra_size = 2;
+    head->samples_per_block = APP_ADPCM_SAMPLES_PER_BLOCK;
+    memcpy(head->fact, "fact", 4);
+    head->fact_size = 4;
+    head->sample_count = samples;
+    memcpy(head->data, "data", 4);
+    head->data_size = data_size;
+}
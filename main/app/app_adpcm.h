@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_ADPCM_BLOCK_SIZE            (256)   /*!< Bytes per mono IMA-ADPCM block */
+#define APP_ADPCM_SAMPLES_PER_BLOCK     (505)   /*!< One header sample plus 504 nibbles */
+
+/**
+ * @brief Incremental mono IMA-ADPCM encoder producing WAV (format 0x11) blocks.
+ *
+ * Samples are collected until a block is full, so the input can be fed in
+ * chunks of any size as it is captured.
+ */
+typedef struct {
+    int16_t block[APP_ADPCM_SAMPLES_PER_BLOCK]; /*!< Samples of the block being collected */
+    size_t count;           /*!< Samples in `block` */
+    int32_t predictor;
+    int32_t index;          /*!< Step table index, carried across blocks */
+    uint32_t samples;       /*!< Samples encoded into emitted blocks */
+} app_adpcm_encoder_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t riff[4];            /*!< "RIFF" */
+    uint32_t riff_size;         /*!< File size minus 8 */
+    uint8_t wave[4];            /*!< "WAVE" */
+    uint8_t fmt[4];             /*!< "fmt " */
+    uint32_t fmt_size;          /*!< 20 */
+    uint16_t audio_format;      /*!< 0x11, IMA-ADPCM */
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;       /*!< APP_ADPCM_BLOCK_SIZE */
+    uint16_t bits_per_sample;   /*!< 4 */
+    uint16_t extra_size;        /*!< 2 */
+    uint16_t samples_per_block; /*!< APP_ADPCM_SAMPLES_PER_BLOCK */
+    uint8_t fact[4];            /*!< "fact" */
+    uint32_t fact_size;         /*!< 4 */
+    uint32_t sample_count;      /*!< Samples per channel */
+    uint8_t data[4];            /*!< "data" */
+    uint32_t data_size;
+} app_adpcm_wav_header_t;
+
+/**
+ * @brief Reset the encoder for a new recording.
+ *
+ * @param enc: Encoder
+ */
+void app_adpcm_encoder_reset(app_adpcm_encoder_t *enc);
+
+/**
+ * @brief Encode samples, every completed block is written to `out`.
+ *
+ * Once `out` cannot hold another block, the remaining input is dropped.
+ *
+ * @param enc: Encoder
+ * @param pcm: First input sample
+ * @param samples: Number of samples to take
+ * @param stride: Distance between two samples, e.g. the channel count of interleaved input
+ * @param out: Output for completed blocks
+ * @param out_size: Space available in `out`
+ *
+ * @return bytes written to `out`, a multiple of APP_ADPCM_BLOCK_SIZE
+ */
+size_t app_adpcm_encode(app_adpcm_encoder_t *enc, const int16_t *pcm, size_t samples, size_t stride, uint8_t *out, size_t out_size);
+
+/**
+ * @brief Encode the last, partial block, padded with its final sample.
+ *
+ * @param enc: Encoder
+ * @param out: Output for the block
+ * @param out_size: Space available in `out`
+ *
+ * @return bytes written to `out`, 0 or APP_ADPCM_BLOCK_SIZE
+ */
+size_t app_adpcm_encoder_flush(app_adpcm_encoder_t *enc, uint8_t *out, size_t out_size);
+
+/**
+ * @brief Fill a mono IMA-ADPCM WAV header.
+ *
+ * @param head: Header to fill
+ * @param sample_rate: Sample rate in Hz
+ * @param samples: Number of encoded samples
+ * @param data_size: Size of the block data in bytes
+ */
+void app_adpcm_wav_header(app_adpcm_wav_header_t *head, uint32_t sample_rate, uint32_t samples, uint32_t data_size);
+
+#ifdef __cplusplus
+}
+#endif
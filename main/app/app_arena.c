@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_arena.h"
+
+static const char *TAG = "app_arena";
+
+#define ARENA_ALIGN(x)      (((x) + 7) & ~(size_t)7)
+
+// 区域分为两半, 复位时换到另一半, 上一轮仍在使用的缓冲区留在原来那一半
+struct app_arena {
+    uint8_t *buf;
+    uint32_t half;              /*!< Size of each half */
+    uint32_t caps;
+    int cur;                    /*!< Half allocations come from */
+    uint32_t used[2];
+    uint32_t live[2];           /*!< Blocks in use in each half */
+    uint32_t heap_live;         /*!< Heap fallback blocks in use */
+    bool reset_pending;         /*!< Reset asked while both halves had blocks in use */
+    app_arena_stats_t stats;
+    portMUX_TYPE lock;
+};
+
+// 回到某一半的开头并从那里分配, 调用时持有锁
+static void arena_rewind(app_arena_handle_t arena, int half)
+{
+    arena->used[half] = 0;
+    arena->cur = half;
+    arena->stats.resets++;
+    arena->reset_pending = false;
+}
+
+// 当前一半已空闲则原地复位, 否则换到空闲的另一半
+static bool arena_try_reset(app_arena_handle_t arena)
+{
+    if (arena->live[arena->cur] == 0) {
+        arena_rewind(arena, arena->cur);
+        return true;
+    }
+    if (arena->live[!arena->cur] == 0) {
+        arena_rewind(arena, !arena->cur);
+        return true;
+    }
+    return false;
+}
+
+static bool arena_owns(app_arena_handle_t arena, const void *ptr)
+{
+    const uint8_t *p = ptr;
+    return p >= arena->buf && p < arena->buf + arena->stats.size;
+}
+
+app_arena_handle_t app_arena_create(size_t size, uint32_t caps)
+{
+    app_arena_handle_t arena = heap_caps_calloc(1, sizeof(struct app_arena), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(arena, NULL, TAG, "no memory for arena");
+    arena->buf = heap_caps_malloc(size, caps);
+    if (arena->buf == NULL) {
+        ESP_LOGE(TAG, "no memory for %zu bytes arena", size);
+        heap_caps_free(arena);
+        return NULL;
+    }
+    arena->caps = caps;
+    arena->half = (size / 2) & ~(size_t)7;
+    arena->stats.size = size;
+    portMUX_INITIALIZE(&arena->lock);
+    return arena;
+}
+
+void app_arena_delete(app_arena_handle_t arena)
+{
+    if (arena) {
+        heap_caps_free(arena->buf);
+        heap_caps_free(arena);
+    }
+}
+
+void *app_arena_alloc(app_arena_handle_t arena, size_t size)
+{
+    void *ptr = NULL;
+    size = ARENA_ALIGN(MAX(size, 1));
+
+    portENTER_CRITICAL(&arena->lock);
+    int cur = arena->cur;
+    if (arena->used[cur] + size <= arena->half) {
+        ptr = arena->buf + cur * arena->half + arena->used[cur];
+        arena->used[cur] += size;
+        arena->live[cur]++;
+        arena->stats.high_water = MAX(arena->stats.high_water, arena->used[cur]);
+    }
+    portEXIT_CRITICAL(&arena->lock);
+    if (ptr) {
+        return ptr;
+    }
+
+    // 区域已满, 由堆分配, 释放时按地址区分
+    ptr = heap_caps_malloc(size, arena->caps);
+    portENTER_CRITICAL(&arena->lock);
+    arena->stats.fallbacks++;
+    if (ptr) {
+        arena->heap_live++;
+    }
+    portEXIT_CRITICAL(&arena->lock);
+    return ptr;
+}
+
+char *app_arena_strndup(app_arena_handle_t arena, const char *str, size_t n)
+{
+    size_t len = strnlen(str, n);
+    char *copy = app_arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void app_arena_free(app_arena_handle_t arena, void *ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+    if (!arena_owns(arena, ptr)) {
+        heap_caps_free(ptr);
+        portENTER_CRITICAL(&arena->lock);
+        arena->heap_live--;
+        portEXIT_CRITICAL(&arena->lock);
+        return;
+    }
+
+    int half = ((uint8_t *)ptr - arena->buf) >= arena->half;
+    portENTER_CRITICAL(&arena->lock);
+    arena->live[half]--;
+    if (arena->reset_pending) {
+        arena_try_reset(arena);
+    }
+    portEXIT_CRITICAL(&arena->lock);
+}
+
+bool app_arena_reset(app_arena_handle_t arena)
+{
+    portENTER_CRITICAL(&arena->lock);
+    bool done = arena_try_reset(arena);
+    if (!done && !arena->reset_pending) {
+        arena->reset_pending = true;
+        arena->stats.deferred++;
+    }
+    portEXIT_CRITICAL(&arena->lock);
+    return done;
+}
+
+void app_arena_get_stats(app_arena_handle_t arena, app_arena_stats_t *stats)
+{
+    portENTER_CRITICAL(&arena->lock);
+    *stats = arena->stats;
+    stats->used = arena->used[arena->cur];
+    stats->live = arena->live[0] + arena->live[1] + arena->heap_live;
+    portEXIT_CRITICAL(&arena->lock);
+}
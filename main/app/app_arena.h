@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bump allocator over one block allocated once, for buffers that share a lifetime.
+ *
+ * The block is split in two halves and allocations come from one of them.
+ * Freeing only counts the block. A reset rewinds the current half if all
+ * its blocks are free, otherwise it switches to the other half once that
+ * one is free, so buffers still held across a reset stay valid. When the
+ * half is full the allocation falls back to the heap and app_arena_free
+ * releases it there. All calls are thread safe.
+ */
+typedef struct app_arena *app_arena_handle_t;
+
+typedef struct {
+    uint32_t size;          /*!< Arena size in bytes, both halves */
+    uint32_t used;          /*!< Bytes handed out from the current half since the last reset */
+    uint32_t high_water;    /*!< Highest `used` seen */
+    uint32_t live;          /*!< Blocks not freed yet, arena and heap */
+    uint32_t resets;        /*!< Resets done */
+    uint32_t deferred;      /*!< Resets that had to wait for blocks still in use */
+    uint32_t fallbacks;     /*!< Allocations served by the heap because the arena was full */
+} app_arena_stats_t;
+
+/**
+ * @brief Create an arena.
+ *
+ * @param size: Size in bytes
+ * @param caps: heap_caps flags of the arena and of the heap fallback
+ *
+ * @return arena handle, NULL on failure
+ */
+app_arena_handle_t app_arena_create(size_t size, uint32_t caps);
+
+/**
+ * @brief Delete an arena, no block may be in use.
+ *
+ * @param arena: Arena handle
+ */
+void app_arena_delete(app_arena_handle_t arena);
+
+/**
+ * @brief Allocate a block, 8-byte aligned.
+ *
+ * @param arena: Arena handle
+ * @param size: Size in bytes
+ *
+ * @return block, NULL if neither the arena nor the heap has room
+ */
+void *app_arena_alloc(app_arena_handle_t arena, size_t size);
+
+/**
+ * @brief Copy at most `n` characters of a string into the arena.
+ *
+ * @param arena: Arena handle
+ * @param str: String
+ * @param n: Maximum length
+ *
+ * @return NUL terminated copy, free with app_arena_free
+ */
+char *app_arena_strndup(app_arena_handle_t arena, const char *str, size_t n);
+
+/**
+ * @brief Free a block from app_arena_alloc, NULL is ignored.
+ *
+ * @param arena: Arena handle
+ * @param ptr: Block
+ */
+void app_arena_free(app_arena_handle_t arena, void *ptr);
+
+/**
+ * @brief Rewind the arena, now or as soon as a half has no block in use.
+ *
+ * @param arena: Arena handle
+ *
+ * @return true if the arena was reset now
+ */
+bool app_arena_reset(app_arena_handle_t arena);
+
+/**
+ * @brief Get the arena counters.
+ *
+ * @param arena: Arena handle
+ * @param stats: Output
+ */
+void app_arena_get_stats(app_arena_handle_t arena, app_arena_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
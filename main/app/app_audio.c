@@ -5,6 +5,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
@@ -25,21 +28,91 @@
 #include "file_iterator.h"
 #include "app_ui_ctrl.h"
 #include "app_wifi.h"
+#include "app_adpcm.h"
+#include "app_prompt.h"
+#include "app_spsc.h"
+#include "app_dsp.h"
+#include "app_mixer.h"
+#include "app_replay.h"
+#include "app_event.h"
+#include "app_playback_ref.h"
+#include "app_telemetry.h"
+#include "esp_cpu.h"
 
 static const char *TAG = "app_audio";
 
+#define RECORD_SAMPLE_RATE      (16000)
+#if PCM_ONE_CHANNEL
+#define RECORD_CHANNELS         (1)
+#else
+#define RECORD_CHANNELS         (2)
+#endif
+
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+#define RECORD_HEADER_SIZE      sizeof(app_adpcm_wav_header_t)
+static app_adpcm_encoder_t record_encoder;
+#else
+#define RECORD_HEADER_SIZE      sizeof(wav_header_t)
+#endif
+#define RECORD_DATA_MAX_SIZE    (FILE_SIZE - RECORD_HEADER_SIZE)
+#define RECORD_SIZE_UNKNOWN     (0xFFFFFFFF)    /*!< WAV size fields of a file uploaded while recording */
+#define RECORD_FRAME_SIZE       (RECORD_CHANNELS * sizeof(int16_t))
+#define RECORD_RING_SIZE        (1 << CONFIG_RECORD_RING_SIZE_LOG2)
+#define RECORD_DRAIN_TIMEOUT_MS (200)
+#define RECORD_PREROLL_SIZE     (RECORD_SAMPLE_RATE * CONFIG_RECORD_PREROLL_MS / 1000 * RECORD_FRAME_SIZE)
+
 #if !CONFIG_BSP_BOARD_ESP32_S3_BOX_Lite
 static bool mute_flag = true;
 #endif
-bool record_flag = false;
-uint32_t record_total_len = 0;
-uint32_t file_total_len = 0;
+// 编解码器当前格式, 启动时为 16k 16bit 双声道
+static uint32_t codec_fs_rate = AUDIO_CODEC_SAMPLE_RATE;
+static uint32_t codec_fs_bits = 16;
+static i2s_slot_mode_t codec_fs_ch = I2S_SLOT_MODE_STEREO;
+static atomic_bool record_flag = false;     /*!< Read per frame by the feed and detect tasks */
+static uint32_t record_total_len = 0;       /*!< Bytes of encoded audio after the header */
+static uint32_t file_total_len = 0;         /*!< Bytes of the whole file, header included */
+static int64_t record_encode_us = 0;
+static uint32_t record_samples = 0;
 static uint8_t *record_audio_buffer = NULL;
+static uint8_t *record_file = NULL;         /*!< Start of the uploaded file inside record_audio_buffer */
+
+// 采集任务只把录音通道拷入内部 RAM 的无锁环形缓冲区, 由录音任务写入 PSRAM
+static app_spsc_handle_t record_ring = NULL;
+static TaskHandle_t record_task = NULL;
+static SemaphoreHandle_t record_save_lock = NULL;
+static bool record_sealed = true;           /*!< Recording stopped and drained, frames go to the pre-roll */
+static bool record_stopping = false;        /*!< Stop requested, frames up to record_stop_pos still belong to the recording */
+static uint32_t record_stop_pos = 0;        /*!< Ring write position when the recording was stopped */
+static uint32_t record_ring_pos = 0;        /*!< Ring bytes consumed by the record task */
+
+// 预录: 不在录音时保留最近 CONFIG_RECORD_PREROLL_MS 的采样, 开始录音时接在录音前面
+static uint8_t *record_preroll = NULL;
+static size_t record_preroll_pos = 0;       /*!< Write position in the circular pre-roll */
+static size_t record_preroll_fill = 0;
+static uint32_t record_preroll_samples = 0; /*!< Pre-roll samples at the front of the current recording */
+
+// 录音期间的 VAD 状态, 以采样为单位
+static bool record_vad_speech = false;
+static uint32_t record_vad_first = 0;       /*!< First sample of the first speech frame */
+static uint32_t record_vad_last = 0;        /*!< End of the last speech frame */
+static uint32_t record_vad_pos = 0;         /*!< Samples covered by the VAD frames so far */
+
+#if CONFIG_RECORD_UPLOAD_STREAMING
+// 边录音边上传: 上传任务读取 record_file 之后已确定保留的部分
+static SemaphoreHandle_t record_stream_lock = NULL;
+static SemaphoreHandle_t record_stream_data = NULL;
+static bool record_stream_open = false;     /*!< Start and header fixed, the upload may have begun */
+static bool record_stream_done = false;     /*!< Recording stopped, file_total_len is final */
+#endif
 uint8_t *audio_rx_buffer = NULL;
 audio_play_finish_cb_t audio_play_finish_cb = NULL;
+static audio_barge_in_cb_t audio_barge_in_cb = NULL;
+static audio_command_cb_t audio_command_cb = NULL;
+static int audio_volume = CONFIG_VOLUME_LEVEL;
 
 extern sr_data_t *g_sr_data;
 extern esp_err_t start_openai(uint8_t *audio, int audio_len);
+extern void start_openai_stream(void);
 extern int Cache_WriteBack_Addr(uint32_t addr, uint32_t size);
 
 // 静音按钮处理函数
@@ -64,32 +137,170 @@ static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting)
     bsp_codec_mute_set(setting == AUDIO_PLAYER_MUTE ? true : false);
     // restore the voice volume upon unmuting
     if (setting == AUDIO_PLAYER_UNMUTE) {
-        bsp_codec_volume_set(CONFIG_VOLUME_LEVEL, NULL);
+        bsp_codec_volume_set(audio_volume, NULL);
     }
     return ESP_OK;
 }
 
+// 记录编解码器当前格式, 格式相同时不再重新配置
+static void audio_codec_update_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch, esp_err_t ret)
+{
+    codec_fs_rate = (ret == ESP_OK) ? rate : 0;
+    codec_fs_bits = bits_cfg;
+    codec_fs_ch = ch;
+}
+
 // 设置音频编解码器采样率
 static esp_err_t audio_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
 {
     esp_err_t ret = ESP_OK;
     ret = bsp_codec_set_fs(rate, bits_cfg, ch);
+    audio_codec_update_fs(rate, bits_cfg, ch, ret);
 
     bsp_codec_mute_set(true);
     bsp_codec_mute_set(false);
-    bsp_codec_volume_set(CONFIG_VOLUME_LEVEL, NULL);
+    bsp_codec_volume_set(audio_volume, NULL);
     vTaskDelay(pdMS_TO_TICKS(50));
 
     return ret;
 }
 
+int audio_volume_adjust(int delta)
+{
+    audio_volume = MIN(MAX(audio_volume + delta, 0), 100);
+    bsp_codec_volume_set(audio_volume, NULL);
+    ESP_LOGI(TAG, "volume %d", audio_volume);
+    return audio_volume;
+}
+
+esp_err_t audio_codec_prepare(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    if (rate == codec_fs_rate && bits_cfg == codec_fs_bits && ch == codec_fs_ch) {
+        return ESP_OK;
+    }
+    return audio_codec_set_fs(rate, bits_cfg, ch);
+}
+
+#if CONFIG_SR_AEC
+// 播放参考: 写入 I2S 的数据混为单声道, 采集任务取出作为 AFE 的参考通道
+#define PLAYBACK_REF_RING_SIZE      (16384)
+#define PLAYBACK_REF_DELAY_FRAMES   (AUDIO_CODEC_SAMPLE_RATE * CONFIG_SR_AEC_REF_DELAY_MS / 1000)
+
+static app_playback_ref_handle_t playback_ref = NULL;
+#endif
+
+esp_err_t audio_playback_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    esp_err_t ret = bsp_i2s_write(audio_buffer, len, bytes_written, timeout_ms);
+#if CONFIG_SR_AEC
+    if (playback_ref && codec_fs_rate == AUDIO_CODEC_SAMPLE_RATE &&
+            codec_fs_bits == 16 && codec_fs_ch == I2S_SLOT_MODE_STEREO) {
+        app_playback_ref_write(playback_ref, (const int16_t *)audio_buffer, len / (2 * sizeof(int16_t)));
+    }
+#endif
+    return ret;
+}
+
+size_t audio_playback_ref_read(int16_t *ref, size_t frames)
+{
+#if CONFIG_SR_AEC
+    if (playback_ref) {
+        return app_playback_ref_read(playback_ref, ref, frames);
+    }
+#endif
+    memset(ref, 0, frames * sizeof(int16_t));
+    return 0;
+}
+
+// 播放器输出: 编解码器固定在 AUDIO_CODEC_SAMPLE_RATE 双声道, 解码输出在软件中重采样
+#define OUTPUT_BLOCK_FRAMES     (256)
+
+static app_dsp_resampler_t output_resampler = {0};
+static bool output_resample = false;
+static uint8_t output_channels = 2;
+static int16_t output_buffer[OUTPUT_BLOCK_FRAMES * 2];
+static uint64_t output_cycles = 0;
+static uint32_t output_frames = 0;
+
+// 播放器切换格式时调用, 只更新重采样参数, 不重新配置编解码器
+static esp_err_t audio_output_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    // 混音器只接受 16bit, MP3 解码输出总是 16bit
+    ESP_RETURN_ON_FALSE(bits_cfg == 16, ESP_ERR_NOT_SUPPORTED, TAG, "%" PRIu32 " bits output not supported", bits_cfg);
+
+    output_channels = (I2S_SLOT_MODE_MONO == ch) ? 1 : 2;
+    output_resample = (rate != AUDIO_CODEC_SAMPLE_RATE);
+    if (output_resample) {
+        esp_err_t ret = app_dsp_resampler_init(&output_resampler, rate, AUDIO_CODEC_SAMPLE_RATE, output_channels);
+        ESP_RETURN_ON_ERROR(ret, TAG, "resampler %" PRIu32 " Hz not supported", rate);
+    }
+    return ESP_OK;
+}
+
+// 单声道原地展开为双声道
+static void audio_output_upmix(int16_t *pcm, size_t frames)
+{
+    for (size_t i = frames; i-- > 0;) {
+        pcm[i * 2 + 1] = pcm[i];
+        pcm[i * 2 + 0] = pcm[i];
+    }
+}
+
+// 播放器写出函数, 按需重采样和展开声道后交给混音器
+static esp_err_t audio_output_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    TickType_t timeout = (portMAX_DELAY == timeout_ms) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    if (!output_resample && output_channels == 2) {
+        *bytes_written = app_mixer_write(APP_MIXER_SOURCE_TTS, audio_buffer, len, timeout);
+        return (*bytes_written == len) ? ESP_OK : ESP_ERR_TIMEOUT;
+    }
+
+    const int16_t *in = (const int16_t *)audio_buffer;
+    size_t frames = len / (output_channels * sizeof(int16_t));
+    esp_err_t ret = ESP_OK;
+    while (frames && ESP_OK == ret) {
+        size_t consumed, produced;
+        if (output_resample) {
+            uint32_t start = esp_cpu_get_cycle_count();
+            produced = app_dsp_resample(&output_resampler, in, frames, &consumed, output_buffer, OUTPUT_BLOCK_FRAMES);
+            output_cycles += esp_cpu_get_cycle_count() - start;
+            output_frames += produced;
+        } else {
+            produced = consumed = MIN(frames, OUTPUT_BLOCK_FRAMES);
+            memcpy(output_buffer, in, produced * sizeof(int16_t));
+        }
+        if (output_channels == 1) {
+            audio_output_upmix(output_buffer, produced);
+        }
+        size_t bytes = produced * 2 * sizeof(int16_t);
+        if (bytes && app_mixer_write(APP_MIXER_SOURCE_TTS, output_buffer, bytes, timeout) != bytes) {
+            ret = ESP_ERR_TIMEOUT;
+        }
+        in += consumed * output_channels;
+        frames -= consumed;
+    }
+    *bytes_written = len;
+    return ret;
+}
+
 // 音频播放器回调函数
 static void audio_player_cb(audio_player_cb_ctx_t *ctx)
 {
     switch (ctx->audio_event) {
     case AUDIO_PLAYER_CALLBACK_EVENT_IDLE:
         ESP_LOGI(TAG, "Player IDLE");
-        bsp_codec_set_fs(16000, 16, 2);
+        // 已写入的数据由混音器播完
+        app_mixer_close(APP_MIXER_SOURCE_TTS);
+        // 编解码器保持固定采样率, 只清空重采样的历史
+        if (output_resample) {
+            app_dsp_resampler_reset(&output_resampler);
+        }
+        if (output_frames) {
+            ESP_LOGI(TAG, "resampler %" PRIu32 " -> %d Hz, %" PRIu32 " cycles/frame",
+                     output_resampler.in_rate, AUDIO_CODEC_SAMPLE_RATE, (uint32_t)(output_cycles / output_frames));
+            output_cycles = 0;
+            output_frames = 0;
+        }
         if (audio_play_finish_cb) {
             audio_play_finish_cb();
         }
@@ -112,6 +323,83 @@ static void audio_player_cb(audio_player_cb_ctx_t *ctx)
     }
 }
 
+// 按配置的编码格式把一段录音写入录音缓冲区, 在录音任务中调用
+static void audio_record_consume(const int16_t *pcm, int frames)
+{
+    int64_t start = esp_timer_get_time();
+    uint8_t *out = record_audio_buffer + RECORD_HEADER_SIZE + record_total_len;
+    size_t space = RECORD_DATA_MAX_SIZE - record_total_len;
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+    record_total_len += app_adpcm_encode(&record_encoder, pcm, frames, RECORD_CHANNELS, out, space);
+    record_samples = record_encoder.samples;
+#else
+    frames = MIN(frames, space / RECORD_FRAME_SIZE);
+    memcpy(out, pcm, frames * RECORD_FRAME_SIZE);
+    record_total_len += frames * RECORD_FRAME_SIZE;
+    record_samples += frames;
+#endif
+    record_encode_us += esp_timer_get_time() - start;
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    xSemaphoreGive(record_stream_data);
+#endif
+}
+
+// 写入预录环形缓冲区, 满时覆盖最早的采样, 调用前需持有 record_save_lock
+static void audio_record_preroll_push(const uint8_t *data, size_t len)
+{
+    if (len > RECORD_PREROLL_SIZE) {
+        data += len - RECORD_PREROLL_SIZE;
+        len = RECORD_PREROLL_SIZE;
+    }
+    size_t first = MIN(len, RECORD_PREROLL_SIZE - record_preroll_pos);
+    memcpy(record_preroll + record_preroll_pos, data, first);
+    memcpy(record_preroll, data + first, len - first);
+    record_preroll_pos = (record_preroll_pos + len) % RECORD_PREROLL_SIZE;
+    record_preroll_fill = MIN(record_preroll_fill + len, RECORD_PREROLL_SIZE);
+}
+
+// 把预录内容按时间顺序写到录音开头, 调用前需持有 record_save_lock
+static void audio_record_preroll_stitch(void)
+{
+    size_t start = (record_preroll_pos + RECORD_PREROLL_SIZE - record_preroll_fill) % RECORD_PREROLL_SIZE;
+    size_t first = MIN(record_preroll_fill, RECORD_PREROLL_SIZE - start);
+    audio_record_consume((const int16_t *)(record_preroll + start), first / RECORD_FRAME_SIZE);
+    audio_record_consume((const int16_t *)record_preroll, (record_preroll_fill - first) / RECORD_FRAME_SIZE);
+    record_preroll_samples = record_preroll_fill / RECORD_FRAME_SIZE;
+    record_preroll_pos = 0;
+    record_preroll_fill = 0;
+}
+
+// 录音任务, 消费环形缓冲区中的采样, PSRAM 写入的延迟不再影响 I2S 读取
+static void audio_record_task(void *arg)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        const uint8_t *data;
+        size_t len;
+        while ((len = app_spsc_read_acquire(record_ring, &data)) > 0) {
+            xSemaphoreTake(record_save_lock, portMAX_DELAY);
+            size_t keep = 0;
+            if (!record_sealed) {
+                // 停止之前写入的帧属于录音, 停止之后采集的帧只进入预录
+                keep = record_stopping ? MIN(len, record_stop_pos - record_ring_pos) : len;
+                audio_record_consume((const int16_t *)data, keep / RECORD_FRAME_SIZE);
+                if (record_stopping && record_ring_pos + keep == record_stop_pos) {
+                    record_sealed = true;
+                }
+            }
+            if (keep < len && record_preroll) {
+                audio_record_preroll_push(data + keep, len - keep);
+            }
+            record_ring_pos += len;
+            xSemaphoreGive(record_save_lock);
+            app_spsc_read_commit(record_ring, len);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
 // 初始化音频录制
 void audio_record_init()
 {
@@ -130,38 +418,97 @@ void audio_record_init()
         return; // Return or handle the error condition appropriately
     }
 
+    record_ring = app_spsc_create(RECORD_RING_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    record_save_lock = xSemaphoreCreateMutex();
+    assert(record_ring && record_save_lock);
+#if CONFIG_RECORD_PREROLL_MS
+    record_preroll = heap_caps_malloc(RECORD_PREROLL_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    assert(record_preroll);
+#endif
+    BaseType_t ret_val = xTaskCreatePinnedToCore(audio_record_task, "Record Task", 4 * 1024, NULL, 4, &record_task, 1);
+    assert(pdPASS == ret_val);
+    app_telemetry_add_task("Record Task", record_task);
+
+#if CONFIG_SR_AEC
+    playback_ref = app_playback_ref_create(PLAYBACK_REF_RING_SIZE, PLAYBACK_REF_DELAY_FRAMES);
+    assert(playback_ref);
+#endif
+
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    record_stream_lock = xSemaphoreCreateMutex();
+    record_stream_data = xSemaphoreCreateBinary();
+    assert(record_stream_lock && record_stream_data);
+#endif
+
+    ESP_ERROR_CHECK(app_mixer_init());
+    app_telemetry_add_task("Mixer Task", app_mixer_get_task());
+
     file_iterator_instance_t *file_iterator = file_iterator_new(BSP_SPIFFS_MOUNT_POINT);
     assert(file_iterator != NULL);
 
     audio_player_config_t config = { .mute_fn = audio_mute_function,
-                                     .write_fn = bsp_i2s_write,
-                                     .clk_set_fn = audio_codec_set_fs,
+                                     .write_fn = audio_output_write,
+                                     .clk_set_fn = audio_output_set_fs,
                                      .priority = 5
                                    };
     ESP_ERROR_CHECK(audio_player_new(config));
     audio_player_callback_register(audio_player_cb, NULL);
 }
 
-// 保存音频录制
+// 保存音频录制: 在采集任务中只把录音通道拷入环形缓冲区, 放不下时丢弃整帧并计数
 void audio_record_save(int16_t *audio_buffer, int audio_chunksize)
 {
 #if DEBUG_SAVE_PCM
-    if (record_flag) {
-        uint16_t *record_buff = (uint16_t *)(record_audio_buffer + sizeof(wav_header_t));
-        record_buff += record_total_len;
-        for (int i = 0; i < (audio_chunksize - 1); i++) {
-            if (record_total_len < (MAX_FILE_SIZE - sizeof(wav_header_t)) / 2) {
+    // 开启预录时不在录音也要写入, 由录音任务放入预录缓冲区
+    if ((!record_flag && record_preroll == NULL) || record_ring == NULL) {
+        return;
+    }
+    if (!app_spsc_write_reserve(record_ring, audio_chunksize * RECORD_FRAME_SIZE)) {
+        return;
+    }
+
+    // 环形缓冲区大小是 2 的幂, 每段可写区域都是整帧
+    int i = 0;
+    while (i < audio_chunksize) {
+        uint8_t *ptr;
+        int frames = MIN(audio_chunksize - i, app_spsc_write_acquire(record_ring, &ptr) / RECORD_FRAME_SIZE);
+        int16_t *record_buff = (int16_t *)ptr;
+        for (int j = 0; j < frames; j++, i++) {
 #if PCM_ONE_CHANNEL
-                record_buff[ i * 1 + 0] = audio_buffer[i * 3 + 0];
-                record_total_len += 1;
+            record_buff[j * 1 + 0] = audio_buffer[i * 3 + 0];
 #else
-                record_buff[ i * 2 + 0] = audio_buffer[i * 3 + 0];
-                record_buff[ i * 2 + 1] = audio_buffer[i * 3 + 1];
-                record_total_len += 2;
+            record_buff[j * 2 + 0] = audio_buffer[i * 3 + 0];
+            record_buff[j * 2 + 1] = audio_buffer[i * 3 + 1];
 #endif
-            }
         }
+        app_spsc_write_commit(record_ring, frames * RECORD_FRAME_SIZE);
     }
+    xTaskNotifyGive(record_task);
+#endif
+}
+
+// 记录一帧 VAD 结果, 录音结束时据此裁剪首尾静音
+void audio_record_vad_update(int frame_samples, bool speech)
+{
+#if DEBUG_SAVE_PCM
+    if (!record_flag) {
+        return;
+    }
+    // 上传任务在 record_save_lock 下读取裁剪位置, 停止录音之后到达的帧不再计入
+    xSemaphoreTake(record_save_lock, portMAX_DELAY);
+    if (record_sealed || record_stopping) {
+        xSemaphoreGive(record_save_lock);
+        return;
+    }
+    if (speech) {
+        if (!record_vad_speech) {
+            record_vad_first = record_vad_pos;
+            record_vad_speech = true;
+        }
+        record_vad_last = record_vad_pos + frame_samples;
+    }
+    record_vad_pos += frame_samples;
+    xSemaphoreGive(record_save_lock);
 #endif
 }
 
@@ -171,123 +518,268 @@ void audio_register_play_finish_cb(audio_play_finish_cb_t cb)
     audio_play_finish_cb = cb;
 }
 
+void audio_register_barge_in_cb(audio_barge_in_cb_t cb)
+{
+    audio_barge_in_cb = cb;
+}
+
+void audio_register_command_cb(audio_command_cb_t cb)
+{
+    audio_command_cb = cb;
+}
+
 // 开始音频录制
 static void audio_record_start()
 {
 #if DEBUG_SAVE_PCM
     ESP_LOGI(TAG, "### record Start");
     audio_player_stop();
+    app_mixer_flush(APP_MIXER_SOURCE_TTS);
 
-    record_flag = true;
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    xSemaphoreTake(record_stream_lock, portMAX_DELAY);
+    record_stream_open = false;
+    record_stream_done = false;
+#endif
+    xSemaphoreTake(record_save_lock, portMAX_DELAY);
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+    app_adpcm_encoder_reset(&record_encoder);
+#endif
     record_total_len = 0;
-    file_total_len = sizeof(wav_header_t);
+    record_samples = 0;
+    record_encode_us = 0;
+    file_total_len = RECORD_HEADER_SIZE;
+    record_file = record_audio_buffer;
+    record_vad_speech = false;
+    record_preroll_samples = 0;
+    if (record_preroll) {
+        audio_record_preroll_stitch();
+    }
+    // VAD 帧从唤醒处开始计数, 预录部分在它之前
+    record_vad_pos = record_preroll_samples;
+    record_stopping = false;
+    record_sealed = false;
+    xSemaphoreGive(record_save_lock);
+    record_flag = true;
+    app_event_publish(APP_EVENT_RECORD_START, 0);
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    xSemaphoreGive(record_stream_lock);
+#endif
 #endif
 }
 
-// 停止音频录制
-static esp_err_t audio_record_stop()
+// 采样位置换算为数据区内的字节偏移, ADPCM 向上取整到块边界
+static uint32_t audio_record_data_offset(uint32_t sample)
 {
-    esp_err_t ret = ESP_OK;
-#if DEBUG_SAVE_PCM
-    record_flag = false;
-#if PCM_ONE_CHANNEL
-    record_total_len *= 1;
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+    return (sample + APP_ADPCM_SAMPLES_PER_BLOCK - 1) / APP_ADPCM_SAMPLES_PER_BLOCK * APP_ADPCM_BLOCK_SIZE;
 #else
-    record_total_len *= 2;
+    return sample * RECORD_CHANNELS * sizeof(int16_t);
 #endif
-    file_total_len += record_total_len;
-    ESP_LOGI(TAG, "### record Stop, %" PRIu32 " %" PRIu32 "K", \
-             record_total_len, \
-             record_total_len / 1024);
-
-    FILE *fp = fopen("/spiffs/echo_en_wake.wav", "r");
-    ESP_GOTO_ON_FALSE(NULL != fp, ESP_FAIL, err, TAG, "Failed create record file");
+}
 
-    wav_header_t wav_head;
-    int len = fread(&wav_head, 1, sizeof(wav_header_t), fp);
-    ESP_GOTO_ON_FALSE(len > 0, ESP_FAIL, err, TAG, "Failed create record file");
+// 保留区间的起点, 还未检测到语音时返回 false
+static bool audio_record_lead(uint32_t *start)
+{
+    *start = 0;
+#if CONFIG_RECORD_TRIM_SILENCE
+    if (!record_vad_speech) {
+        return false;
+    }
+    uint32_t guard = RECORD_SAMPLE_RATE * CONFIG_RECORD_TRIM_GUARD_MS / 1000;
+    // 唤醒后马上开口时保留整个预录部分, 接在唤醒词后的字不被裁掉
+    *start = (record_vad_first > record_preroll_samples + guard) ? record_vad_first - guard : 0;
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+    // 每个块自带预测值和步长索引, 只能按块裁剪
+    *start = *start / APP_ADPCM_SAMPLES_PER_BLOCK * APP_ADPCM_SAMPLES_PER_BLOCK;
+#endif
+#endif
+    return true;
+}
 
-    wav_head.SampleRate = 16000;
-#if PCM_ONE_CHANNEL
-    wav_head.NumChannels = 1;
+// 保留区间的终点, 最后一帧语音之后再留出保护区
+static uint32_t audio_record_tail(void)
+{
+#if CONFIG_RECORD_TRIM_SILENCE
+    uint32_t guard = RECORD_SAMPLE_RATE * CONFIG_RECORD_TRIM_GUARD_MS / 1000;
+    return MIN(record_samples, record_vad_last + guard);
 #else
-    wav_head.NumChannels = 2;
-#endif
-    wav_head.BitsPerSample = 16;
-    wav_head.ChunkSize = file_total_len - 8;
-    wav_head.ByteRate = wav_head.SampleRate * wav_head.BitsPerSample * wav_head.NumChannels / 8;
-    wav_head.Subchunk2ID[0] = 'd';
-    wav_head.Subchunk2ID[1] = 'a';
-    wav_head.Subchunk2ID[2] = 't';
-    wav_head.Subchunk2ID[3] = 'a';
-    wav_head.Subchunk2Size = record_total_len;
-    memcpy((void *)record_audio_buffer, &wav_head, sizeof(wav_header_t));
-    Cache_WriteBack_Addr((uint32_t)record_audio_buffer, record_total_len);
-
-#endif
-err:
-    if (fp) {
-        fclose(fp);
-    }
-    return ret;
+    return record_samples;
+#endif
 }
 
-// 播放音频任务
-esp_err_t audio_play_task(void *filepath)
+// 填写 WAV 头, 大小未知时填 RECORD_SIZE_UNKNOWN
+static void audio_record_write_header(uint8_t *dst, uint32_t samples, uint32_t data_size)
 {
-    FILE *fp = NULL;
-    struct stat file_stat;
-    esp_err_t ret = ESP_OK;
+    uint32_t riff_size = (RECORD_SIZE_UNKNOWN == data_size) ? RECORD_SIZE_UNKNOWN : RECORD_HEADER_SIZE - 8 + data_size;
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+    app_adpcm_wav_header_t wav_head;
+    app_adpcm_wav_header(&wav_head, RECORD_SAMPLE_RATE, samples, data_size);
+    wav_head.riff_size = riff_size;
+#else
+    wav_header_t wav_head = {
+        .ChunkID = {'R', 'I', 'F', 'F'},
+        .ChunkSize = riff_size,
+        .Format = {'W', 'A', 'V', 'E'},
+        .Subchunk1ID = {'f', 'm', 't', ' '},
+        .Subchunk1Size = 16,
+        .AudioFormat = 1,
+        .NumChannels = RECORD_CHANNELS,
+        .SampleRate = RECORD_SAMPLE_RATE,
+        .ByteRate = RECORD_SAMPLE_RATE * RECORD_CHANNELS * sizeof(int16_t),
+        .BlockAlign = RECORD_CHANNELS * sizeof(int16_t),
+        .BitsPerSample = 16,
+        .Subchunk2ID = {'d', 'a', 't', 'a'},
+        .Subchunk2Size = data_size,
+    };
+#endif
+    memcpy(dst, &wav_head, RECORD_HEADER_SIZE);
+}
 
-    const size_t chunk_size = 4096;
-    uint8_t *buffer = malloc(chunk_size);
-    ESP_GOTO_ON_FALSE(NULL != buffer, ESP_FAIL, EXIT, TAG, "buffer malloc failed");
+// 停止录音: 以当前写入位置为界, 等待录音任务处理完此前已采集的帧后封存; 之后到达的帧进入预录或丢弃
+static void audio_record_drain(void)
+{
+    xSemaphoreTake(record_save_lock, portMAX_DELAY);
+    record_stop_pos = app_spsc_write_pos(record_ring);
+    record_stopping = true;
+    record_sealed = (record_ring_pos == record_stop_pos);
+    xSemaphoreGive(record_save_lock);
+    record_flag = false;
 
-    ESP_GOTO_ON_FALSE(-1 != stat(filepath, &file_stat), ESP_FAIL, EXIT, TAG, "Failed to stat file");
+    int64_t deadline = esp_timer_get_time() + RECORD_DRAIN_TIMEOUT_MS * 1000;
+    bool sealed = false;
+    while (!sealed) {
+        xSemaphoreTake(record_save_lock, portMAX_DELAY);
+        sealed = record_sealed || esp_timer_get_time() >= deadline;
+        if (sealed) {
+            record_sealed = true;
+            record_stopping = false;
+        }
+        xSemaphoreGive(record_save_lock);
+        if (!sealed) {
+            vTaskDelay(1);
+        }
+    }
+}
 
-    fp = fopen(filepath, "r");
-    ESP_GOTO_ON_FALSE(NULL != fp, ESP_FAIL, EXIT, TAG, "Failed create record file");
+// 停止音频录制, 补齐最后一个编码块, 裁剪首尾静音并在保留部分之前写入 WAV 头
+static esp_err_t audio_record_stop()
+{
+    esp_err_t ret = ESP_OK;
+#if DEBUG_SAVE_PCM
+    audio_record_drain();
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    xSemaphoreTake(record_stream_lock, portMAX_DELAY);
+#endif
 
-    wav_header_t wav_head;
-    int len = fread(&wav_head, 1, sizeof(wav_header_t), fp);
-    ESP_GOTO_ON_FALSE(len > 0, ESP_FAIL, EXIT, TAG, "Read wav header failed");
+#if CONFIG_RECORD_CODEC_IMA_ADPCM
+    record_total_len += app_adpcm_encoder_flush(&record_encoder,
+                                                record_audio_buffer + RECORD_HEADER_SIZE + record_total_len,
+                                                RECORD_DATA_MAX_SIZE - record_total_len);
+    record_samples = record_encoder.samples;
+#endif
 
-    if (NULL == strstr((char *)wav_head.Subchunk1ID, "fmt") &&
-            NULL == strstr((char *)wav_head.Subchunk2ID, "data")) {
-        ESP_LOGI(TAG, "PCM format");
-        fseek(fp, 0, SEEK_SET);
-        wav_head.SampleRate = 16000;
-        wav_head.NumChannels = 2;
-        wav_head.BitsPerSample = 16;
+    uint32_t start, end;
+    if (audio_record_lead(&start)) {
+        end = audio_record_tail();
+    } else {
+        // 没有检测到语音, 原样上传交给服务器判断
+        end = record_samples;
+    }
+    uint32_t data_offset = audio_record_data_offset(start);
+    uint32_t data_size = audio_record_data_offset(end) - data_offset;
+
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    if (record_stream_open) {
+        // 上传已经开始, 头部保持大小未知
+        record_total_len = data_size;
+        file_total_len = RECORD_HEADER_SIZE + data_size;
+        record_stream_done = true;
+        xSemaphoreGive(record_stream_lock);
+        xSemaphoreGive(record_stream_data);
+        goto log;
     }
+#endif
+    // 头部覆盖被裁掉的数据, 文件从这里开始
+    record_file = record_audio_buffer + data_offset;
+    audio_record_write_header(record_file, end - start, data_size);
+    record_total_len = data_size;
+    file_total_len = RECORD_HEADER_SIZE + data_size;
+    Cache_WriteBack_Addr((uint32_t)record_file, file_total_len);
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    record_stream_open = true;
+    record_stream_done = true;
+    xSemaphoreGive(record_stream_lock);
+    xSemaphoreGive(record_stream_data);
+log:
+#endif
 
-    ESP_LOGI(TAG, "frame_rate= %" PRIi32 ", ch=%d, width=%d", wav_head.SampleRate, wav_head.NumChannels, wav_head.BitsPerSample);
-    bsp_codec_set_fs(wav_head.SampleRate, wav_head.BitsPerSample, I2S_SLOT_MODE_STEREO);
+    ESP_LOGI(TAG, "### record Stop, pre-roll %" PRIu32 " ms, %" PRIu32 " ms, trim lead %" PRIu32 " ms, tail %" PRIu32 " ms, %" PRIu32 "K, encode %lld us",
+             record_preroll_samples * 1000 / RECORD_SAMPLE_RATE,
+             (end - start) * 1000 / RECORD_SAMPLE_RATE,
+             start * 1000 / RECORD_SAMPLE_RATE,
+             (record_samples - end) * 1000 / RECORD_SAMPLE_RATE,
+             file_total_len / 1024,
+             record_encode_us);
+    app_spsc_stats_t ring_stats;
+    app_spsc_get_stats(record_ring, &ring_stats);
+    ESP_LOGI(TAG, "record ring: %" PRIu32 " writes, %" PRIu32 " overruns (%" PRIu32 " bytes), high water %" PRIu32 "/%d",
+             ring_stats.writes, ring_stats.overruns, ring_stats.dropped, ring_stats.high_water, RECORD_RING_SIZE);
+    app_event_publish(APP_EVENT_RECORD_STOP, file_total_len);
+#endif
+    return ret;
+}
 
-    bsp_codec_mute_set(true);
-    bsp_codec_mute_set(false);
-    bsp_codec_volume_set(CONFIG_VOLUME_LEVEL, NULL);
-
-    size_t cnt, total_cnt = 0;
-    do {
-        /* Read file in chunks into the scratch buffer */
-        len = fread(buffer, 1, chunk_size, fp);
-        if (len <= 0) {
-            break;
-        } else if (len > 0) {
-            bsp_i2s_write(buffer, len, &cnt, portMAX_DELAY);
-            total_cnt += cnt;
+esp_err_t audio_record_stream_get(size_t offset, const uint8_t **data, size_t *len, bool *done, TickType_t timeout)
+{
+#if CONFIG_RECORD_UPLOAD_STREAMING
+    *len = 0;
+    *done = false;
+
+    // 加锁顺序: record_stream_lock, 然后 record_save_lock
+    xSemaphoreTake(record_stream_lock, portMAX_DELAY);
+    uint32_t start = 0;
+    size_t file_len = 0;
+    if (record_stream_done) {
+        file_len = file_total_len;
+        *done = true;
+    } else {
+        // 录音任务和检测任务仍在写入, 在 record_save_lock 下一次取出长度和裁剪位置
+        xSemaphoreTake(record_save_lock, portMAX_DELAY);
+        bool lead = audio_record_lead(&start);
+        uint32_t total_len = record_total_len;
+        uint32_t tail = audio_record_tail();
+        xSemaphoreGive(record_save_lock);
+
+        if (lead) {
+            uint32_t data_offset = audio_record_data_offset(start);
+            if (!record_stream_open) {
+                // 起点已确定, 写入大小未知的头部后开始上传
+                record_file = record_audio_buffer + data_offset;
+                audio_record_write_header(record_file, RECORD_SIZE_UNKNOWN, RECORD_SIZE_UNKNOWN);
+                record_stream_open = true;
+            }
+            // 只发送已完整编码且在保护区之内的数据, 后面的静音等说话继续时再发
+            uint32_t data_end = MIN(total_len, audio_record_data_offset(tail));
+            file_len = RECORD_HEADER_SIZE + MAX(data_end, data_offset) - data_offset;
         }
-    } while (1);
+    }
+    xSemaphoreGive(record_stream_lock);
 
-EXIT:
-    if (fp) {
-        fclose(fp);
+    if (offset < file_len) {
+        *data = record_file + offset;
+        *len = file_len - offset;
+        *done = false;
+        return ESP_OK;
     }
-    if (buffer) {
-        free(buffer);
+    if (*done) {
+        return ESP_OK;
     }
-    return ret;
+    xSemaphoreTake(record_stream_data, timeout);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 // 语音识别处理任务
@@ -316,39 +808,53 @@ void sr_handler_task(void *pvParam)
         if (mute_state != mute_flag) {
             mute_state = mute_flag;
             if (false == mute_state) {
-                bsp_codec_set_fs(16000, 16, 2);
+                audio_codec_update_fs(AUDIO_CODEC_SAMPLE_RATE, 16, 2, bsp_codec_set_fs(AUDIO_CODEC_SAMPLE_RATE, 16, 2));
             }
         }
 #endif
         if (ESP_MN_STATE_TIMEOUT == result.state) {
             ESP_LOGI(TAG, "ESP_MN_STATE_TIMEOUT");
             audio_record_stop();
-            FILE *fp = fopen("/spiffs/waitPlease.mp3", "r");
-            if (fp) {
-                audio_player_play(fp);
-            }
+            app_replay_mark(APP_REPLAY_RECORDED, file_total_len);
+            app_prompt_play(APP_PROMPT_WAIT);
+#if !CONFIG_RECORD_UPLOAD_STREAMING
             if (WIFI_STATUS_CONNECTED_OK == wifi_connected_already()) {
-                start_openai((uint8_t *)record_audio_buffer, record_total_len);
+                start_openai(record_file, file_total_len);
             }
+#endif
             continue;
         }
 
         if (WAKENET_DETECTED == result.wakenet_mode) {
+            // 每次唤醒开始新的一轮对话, 回复进行中则将其打断
+            if (audio_barge_in_cb) {
+                audio_barge_in_cb();
+            }
             audio_record_start();
+#if CONFIG_RECORD_UPLOAD_STREAMING
+            // 唤醒后立即开始上传, 说话结束时上传也基本完成
+            if (WIFI_STATUS_CONNECTED_OK == wifi_connected_already()) {
+                start_openai_stream();
+            }
+#endif
 
             // UI show listen
             ui_ctrl_guide_jump();
             ui_ctrl_show_panel(UI_CTRL_PANEL_LISTEN, 0);
 
-            audio_play_task("/spiffs/echo_en_wake.wav");
+            // 提示音已预加载, 异步播放, 不阻塞唤醒处理
+            app_prompt_play(APP_PROMPT_EN_WAKE);
             continue;
         }
 
         if (ESP_MN_STATE_DETECTED & result.state) {
-            ESP_LOGI(TAG, "STOP:%d", result.command_id);
+            ESP_LOGI(TAG, "command:%d", result.command_id);
+            // 本地命令: 先处理命令, 已开始的边录边传请求随之取消, 录音不再上传
+            if (audio_command_cb) {
+                audio_command_cb(result.command_id);
+            }
             audio_record_stop();
-            audio_play_task("/spiffs/echo_en_ok.wav");
-            //How to stop the transmission, when start_openai begins.
+            app_prompt_play(APP_PROMPT_EN_OK);
             continue;
         }
     }
@@ -6,11 +6,19 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/i2s_std.h"
+
 #define DEBUG_SAVE_PCM      (1)
 #define PCM_ONE_CHANNEL     (1)
 #define FILE_SIZE (256000)
 #define MAX_FILE_SIZE       (1*1024*1024)
 #define RECORD_NAME         "/spiffs/record.wav"
+#define AUDIO_CODEC_SAMPLE_RATE (16000)   /*!< Fixed codec rate, shared by capture and playback */
 
 typedef struct {
     // The "RIFF" chunk descriptor
@@ -32,6 +40,8 @@ typedef struct {
 } wav_header_t;
 
 typedef void (*audio_play_finish_cb_t)(void);
+typedef void (*audio_barge_in_cb_t)(void);
+typedef void (*audio_command_cb_t)(int command_id);
 
 void sr_handler_task(void *pvParam);
 
@@ -40,10 +50,93 @@ void sr_handler_task(void *pvParam);
  */
 extern uint8_t *audio_rx_buffer;
 
-esp_err_t audio_play_task(void *filepath);
+/**
+ * @brief Set the codec format for playback, skipped if the codec already runs at this format.
+ *
+ * @param rate: Sample rate
+ * @param bits_cfg: Bits per sample
+ * @param ch: Slot mode
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - Others: Fail, see bsp_codec_set_fs
+ */
+esp_err_t audio_codec_prepare(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
 
 void audio_record_init();
 
 void audio_record_save(int16_t *audio_buffer, int audio_chunksize);
 
+/**
+ * @brief Report the VAD result of one AFE frame, used to trim silence when the recording stops.
+ *
+ * @param frame_samples: Samples per channel in the frame
+ * @param speech: true if the frame holds speech
+ */
+void audio_record_vad_update(int frame_samples, bool speech);
+
+/**
+ * @brief Get the part of the current recording that is ready to upload, while the user is still speaking.
+ *
+ * The file starts with a WAV header whose size fields are unknown. Leading
+ * silence is skipped and trailing silence is held back until speech resumes
+ * or the recording stops. Without CONFIG_RECORD_UPLOAD_STREAMING this
+ * returns ESP_ERR_NOT_SUPPORTED.
+ *
+ * @param offset: Bytes of the file already consumed
+ * @param data: Output, file bytes from `offset` on
+ * @param len: Output, number of bytes at `data`, 0 if nothing new arrived within `timeout`
+ * @param done: Output, true once the recording stopped and `offset` is the end of the file
+ * @param timeout: Max time to wait for new data
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_SUPPORTED: Streaming upload disabled
+ */
+esp_err_t audio_record_stream_get(size_t offset, const uint8_t **data, size_t *len, bool *done, TickType_t timeout);
+
 void audio_register_play_finish_cb(audio_play_finish_cb_t cb);
+
+/**
+ * @brief Register the callback run on a wake word, before recording starts, to begin a new turn and interrupt a reply in progress.
+ *
+ * @param cb: Callback, runs in the SR handler task
+ */
+void audio_register_barge_in_cb(audio_barge_in_cb_t cb);
+
+/**
+ * @brief Register the callback run when a local voice command is recognized, instead of uploading the recording.
+ *
+ * @param cb: Callback, gets a sr_cmd_t and runs in the SR handler task
+ */
+void audio_register_command_cb(audio_command_cb_t cb);
+
+/**
+ * @brief Change the speaker volume, kept across mute and codec reconfiguration.
+ *
+ * @param delta: Change in percent, negative to turn it down
+ *
+ * @return new volume, 0 to 100
+ */
+int audio_volume_adjust(int delta);
+
+/**
+ * @brief Write PCM to the speaker and keep a copy as the AEC playback reference.
+ *
+ * Same signature as bsp_i2s_write. Called by the mixer task only, other
+ * playback goes through app_mixer.
+ */
+esp_err_t audio_playback_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+
+/**
+ * @brief Get the playback reference matching the next captured frames, called by the feed task only.
+ *
+ * The reference is delayed by CONFIG_SR_AEC_REF_DELAY_MS to line up with
+ * the echo. Frames without playback are filled with zeros.
+ *
+ * @param ref: Output, `frames` mono samples
+ * @param frames: Number of frames captured
+ *
+ * @return frames of real reference, the rest are zeros
+ */
+size_t audio_playback_ref_read(int16_t *ref, size_t frames);
@@ -0,0 +1,228 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <sys/param.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_dsp.h"
+
+static const char *TAG = "app_dsp";
+
+#define RESAMPLE_WORK_FRAMES    (APP_DSP_RESAMPLE_TAPS - 1 + APP_DSP_RESAMPLE_BLOCK)
+#define RESAMPLE_PASSBAND       (0.9f)      /*!< Cutoff as a fraction of the lower Nyquist frequency */
+
+// 从后往前展开, 输出区间总在输入区间之后, 原地展开时不会覆盖未读取的输入
+void app_dsp_interleave_2to3_ref(const int16_t *in, const int16_t *ref, int16_t *out, size_t frames)
+{
+    for (size_t i = frames; i-- > 0;) {
+        int16_t mic0 = in[i * 2 + 0];
+        int16_t mic1 = in[i * 2 + 1];
+        out[i * 3 + 2] = ref ? ref[i] : 0;
+        out[i * 3 + 1] = mic1;
+        out[i * 3 + 0] = mic0;
+    }
+}
+
+// 每次处理两帧: 读 2 个字, 写 3 个字, 两帧的输出正好字对齐
+IRAM_ATTR void app_dsp_interleave_2to3(const int16_t *in, const int16_t *ref, int16_t *out, size_t frames)
+{
+    if ((((uintptr_t)in | (uintptr_t)out) & 3) != 0) {
+        app_dsp_interleave_2to3_ref(in, ref, out, frames);
+        return;
+    }
+
+    const uint32_t *src = (const uint32_t *)in;
+    uint32_t *dst = (uint32_t *)out;
+    size_t pairs = frames / 2;
+
+    // 奇数帧时先处理最后一帧
+    if (frames & 1) {
+        app_dsp_interleave_2to3_ref(in + pairs * 4, ref ? ref + pairs * 2 : NULL, out + pairs * 6, 1);
+    }
+
+    if (ref) {
+        for (size_t k = pairs; k-- > 0;) {
+            uint32_t w0 = src[k * 2 + 0];
+            uint32_t w1 = src[k * 2 + 1];
+            uint32_t r0 = (uint16_t)ref[k * 2 + 0];
+            uint32_t r1 = (uint16_t)ref[k * 2 + 1];
+            dst[k * 3 + 2] = (w1 >> 16) | (r1 << 16);
+            dst[k * 3 + 1] = r0 | (w1 << 16);
+            dst[k * 3 + 0] = w0;
+        }
+    } else {
+        for (size_t k = pairs; k-- > 0;) {
+            uint32_t w0 = src[k * 2 + 0];
+            uint32_t w1 = src[k * 2 + 1];
+            dst[k * 3 + 2] = w1 >> 16;
+            dst[k * 3 + 1] = w1 << 16;
+            dst[k * 3 + 0] = w0;
+        }
+    }
+}
+
+static uint32_t dsp_gcd(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// 计算各相位的 Blackman 窗 sinc 系数, 每相位之和归一化为 Q15 的 1.0
+static void dsp_resampler_design(app_dsp_resampler_t *rs)
+{
+    const int taps = APP_DSP_RESAMPLE_TAPS;
+    float fc = 0.5f * RESAMPLE_PASSBAND * MIN(1.0f, (float)rs->out_rate / rs->in_rate);
+    float half = taps / 2.0f;
+    float h[APP_DSP_RESAMPLE_TAPS];
+
+    for (int p = 0; p < rs->up; p++) {
+        float sum = 0;
+        for (int k = 0; k < taps; k++) {
+            // 该抽头到输出时刻的距离, 以输入采样为单位
+            float d = k - (float)p / rs->up - (taps - 1) / 2.0f;
+            float x = 2.0f * fc * d;
+            float sinc = (fabsf(x) < 1e-6f) ? 1.0f : sinf(M_PI * x) / (M_PI * x);
+            float w = (fabsf(d) >= half) ? 0 : 0.42f + 0.5f * cosf(M_PI * d / half) + 0.08f * cosf(2 * M_PI * d / half);
+            h[k] = sinc * w;
+            sum += h[k];
+        }
+        int16_t *coef = rs->coef + p * taps;
+        for (int k = 0; k < taps; k++) {
+            coef[k] = (int16_t)lrintf(h[k] / sum * 32767.0f);
+        }
+    }
+}
+
+esp_err_t app_dsp_resampler_init(app_dsp_resampler_t *rs, uint32_t in_rate, uint32_t out_rate, uint8_t channels)
+{
+    ESP_RETURN_ON_FALSE(in_rate && out_rate && (channels == 1 || channels == 2), ESP_ERR_INVALID_ARG, TAG, "invalid format");
+
+    if (rs->coef && rs->in_rate == in_rate && rs->out_rate == out_rate && rs->channels == channels) {
+        app_dsp_resampler_reset(rs);
+        return ESP_OK;
+    }
+
+    uint32_t gcd = dsp_gcd(in_rate, out_rate);
+    uint32_t up = out_rate / gcd;
+    uint32_t down = in_rate / gcd;
+    ESP_RETURN_ON_FALSE(up <= APP_DSP_RESAMPLE_MAX_PHASES && down <= UINT16_MAX, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "%" PRIu32 " -> %" PRIu32 " needs %" PRIu32 " phases", in_rate, out_rate, up);
+
+    app_dsp_resampler_deinit(rs);
+    size_t coef_size = up * APP_DSP_RESAMPLE_TAPS * sizeof(int16_t);
+    rs->coef = heap_caps_malloc(coef_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (rs->coef == NULL) {
+        rs->coef = heap_caps_malloc(coef_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    rs->work = heap_caps_malloc(RESAMPLE_WORK_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (rs->coef == NULL || rs->work == NULL) {
+        app_dsp_resampler_deinit(rs);
+        ESP_LOGE(TAG, "no memory for resampler");
+        return ESP_ERR_NO_MEM;
+    }
+
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->up = up;
+    rs->down = down;
+    rs->channels = channels;
+    dsp_resampler_design(rs);
+    app_dsp_resampler_reset(rs);
+    ESP_LOGI(TAG, "resample %" PRIu32 " -> %" PRIu32 " Hz, %d ch, %" PRIu32 "/%" PRIu32, in_rate, out_rate, channels, up, down);
+    return ESP_OK;
+}
+
+void app_dsp_resampler_reset(app_dsp_resampler_t *rs)
+{
+    // 先填半个滤波器长度的零, 第一个输出对齐第一个输入
+    rs->frames = APP_DSP_RESAMPLE_TAPS / 2;
+    rs->phase = 0;
+    memset(rs->work, 0, rs->frames * rs->channels * sizeof(int16_t));
+}
+
+void app_dsp_resampler_deinit(app_dsp_resampler_t *rs)
+{
+    if (rs->coef) {
+        heap_caps_free(rs->coef);
+    }
+    if (rs->work) {
+        heap_caps_free(rs->work);
+    }
+    memset(rs, 0, sizeof(app_dsp_resampler_t));
+}
+
+static inline int16_t dsp_sat16(int32_t acc)
+{
+    acc = (acc + (1 << 14)) >> 15;
+    return (acc > INT16_MAX) ? INT16_MAX : (acc < INT16_MIN) ? INT16_MIN : acc;
+}
+
+IRAM_ATTR size_t app_dsp_resample(app_dsp_resampler_t *rs, const int16_t *in, size_t in_frames, size_t *consumed,
+                                  int16_t *out, size_t out_frames)
+{
+    const int taps = APP_DSP_RESAMPLE_TAPS;
+    const int ch = rs->channels;
+    size_t produced = 0;
+    *consumed = 0;
+
+    while (true) {
+        // 输入足够时逐个计算输出
+        while (produced < out_frames) {
+            uint32_t pos = rs->phase / rs->up;
+            if (pos + taps > rs->frames) {
+                break;
+            }
+            const int16_t *coef = rs->coef + (rs->phase % rs->up) * taps;
+            const int16_t *x = rs->work + pos * ch;
+            if (ch == 2) {
+                int32_t acc0 = 0, acc1 = 0;
+                for (int k = 0; k < taps; k++) {
+                    acc0 += coef[k] * x[k * 2 + 0];
+                    acc1 += coef[k] * x[k * 2 + 1];
+                }
+                out[produced * 2 + 0] = dsp_sat16(acc0);
+                out[produced * 2 + 1] = dsp_sat16(acc1);
+            } else {
+                int32_t acc = 0;
+                for (int k = 0; k < taps; k++) {
+                    acc += coef[k] * x[k];
+                }
+                out[produced] = dsp_sat16(acc);
+            }
+            produced++;
+            rs->phase += rs->down;
+        }
+
+        // 丢弃不再需要的历史
+        uint32_t drop = MIN(rs->phase / rs->up, rs->frames);
+        if (drop) {
+            memmove(rs->work, rs->work + drop * ch, (rs->frames - drop) * ch * sizeof(int16_t));
+            rs->frames -= drop;
+            rs->phase -= drop * rs->up;
+        }
+
+        if (produced == out_frames || *consumed == in_frames) {
+            break;
+        }
+        size_t n = MIN(in_frames - *consumed, RESAMPLE_WORK_FRAMES - rs->frames);
+        memcpy(rs->work + rs->frames * ch, in + *consumed * ch, n * ch * sizeof(int16_t));
+        rs->frames += n;
+        *consumed += n;
+    }
+    return produced;
+}
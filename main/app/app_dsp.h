@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Expand stereo I2S frames into the 3-channel layout AFE feeds on: mic0, mic1, reference.
+ *
+ * `out` may be the same buffer as `in` for an in-place expansion, any other
+ * overlap is not allowed. A 32-bit path handling two frames per step is used
+ * when `in` and `out` are 4-byte aligned, otherwise a per-sample loop; both
+ * give the same output.
+ *
+ * @param in: Interleaved stereo samples, `frames * 2` values
+ * @param ref: Reference channel, `frames` values, or NULL to fill it with zeros
+ * @param out: Output, `frames * 3` values
+ * @param frames: Number of frames
+ */
+void app_dsp_interleave_2to3(const int16_t *in, const int16_t *ref, int16_t *out, size_t frames);
+
+/**
+ * @brief Per-sample version of app_dsp_interleave_2to3, for checking the optimized path.
+ */
+void app_dsp_interleave_2to3_ref(const int16_t *in, const int16_t *ref, int16_t *out, size_t frames);
+
+#define APP_DSP_RESAMPLE_TAPS       (32)    /*!< Filter taps per phase */
+#define APP_DSP_RESAMPLE_MAX_PHASES (640)   /*!< Largest reduced output rate ratio term, 11.025 -> 16 kHz */
+#define APP_DSP_RESAMPLE_BLOCK      (256)   /*!< Input frames buffered per step */
+
+/**
+ * @brief Rational polyphase sample-rate converter with Q15 coefficients, 16-bit interleaved samples.
+ *
+ * The output rate is exactly `in_rate * up / down`. Each output frame is a
+ * APP_DSP_RESAMPLE_TAPS-tap windowed-sinc interpolation, band-limited to the
+ * lower of the two Nyquist frequencies.
+ */
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint16_t up;                /*!< L, phases of the filter */
+    uint16_t down;              /*!< M, input step per output in 1/L samples */
+    uint8_t channels;
+    int16_t *coef;              /*!< up * APP_DSP_RESAMPLE_TAPS, phase-major */
+    int16_t *work;              /*!< History followed by new input */
+    size_t frames;              /*!< Frames held in `work` */
+    uint32_t phase;             /*!< Position of the next output between work[0] and work[1], in 1/L samples */
+} app_dsp_resampler_t;
+
+/**
+ * @brief Set up a resampler, reusing its buffers when only the history has to change.
+ *
+ * @param rs: Resampler, zero-initialized before the first call
+ * @param in_rate: Input sample rate
+ * @param out_rate: Output sample rate
+ * @param channels: 1 or 2
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_SUPPORTED: Rate ratio needs more than APP_DSP_RESAMPLE_MAX_PHASES phases
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_dsp_resampler_init(app_dsp_resampler_t *rs, uint32_t in_rate, uint32_t out_rate, uint8_t channels);
+
+/**
+ * @brief Drop the input history, e.g. at the start of a new stream.
+ *
+ * @param rs: Resampler
+ */
+void app_dsp_resampler_reset(app_dsp_resampler_t *rs);
+
+/**
+ * @brief Free the buffers of a resampler.
+ *
+ * @param rs: Resampler
+ */
+void app_dsp_resampler_deinit(app_dsp_resampler_t *rs);
+
+/**
+ * @brief Convert a block of samples.
+ *
+ * Input that produces no output yet is kept as history for the next call.
+ *
+ * @param rs: Resampler
+ * @param in: Interleaved input samples
+ * @param in_frames: Input frames available
+ * @param consumed: Output, input frames taken, call again with the rest
+ * @param out: Output, interleaved samples
+ * @param out_frames: Capacity of `out` in frames
+ *
+ * @return number of frames written to `out`
+ */
+size_t app_dsp_resample(app_dsp_resampler_t *rs, const int16_t *in, size_t in_frames, size_t *consumed,
+                        int16_t *out, size_t out_frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <math.h>
+#include <sys/param.h>
+#include "app_endpoint.h"
+
+#define ENDPOINT_NOISE_ALPHA    (0.05f)     /*!< Noise floor smoothing per silent frame */
+
+void app_endpoint_init(app_endpoint_t *ep, const app_endpoint_config_t *config)
+{
+    memset(ep, 0, sizeof(app_endpoint_t));
+    ep->config = *config;
+    app_endpoint_reset(ep);
+}
+
+void app_endpoint_reset(app_endpoint_t *ep)
+{
+    ep->frames = 0;
+    ep->elapsed_ms = 0;
+    ep->speech_ms = 0;
+    ep->silence_ms = 0;
+    ep->speech_db = 0;
+    ep->speech_frames = 0;
+    ep->hangover_ms = ep->config.min_ms;
+}
+
+static float endpoint_level_db(const int16_t *pcm, size_t samples)
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += pcm[i] * pcm[i];
+    }
+    return 10.0f * log10f((float)sum / samples + 1.0f);
+}
+
+// 所需静音时长: 随已说话时长线性增加, 语音接近噪声时再加长一半
+static uint32_t endpoint_hangover(const app_endpoint_t *ep)
+{
+    const app_endpoint_config_t *cfg = &ep->config;
+    uint32_t hang = cfg->min_ms + ep->speech_ms * cfg->length_percent / 100;
+    if (ep->noise_valid && ep->speech_frames && ep->speech_db - ep->noise_db < cfg->low_snr_db) {
+        hang = hang * 3 / 2;
+    }
+    return MIN(MAX(hang, cfg->min_ms), cfg->max_ms);
+}
+
+app_endpoint_result_t app_endpoint_update(app_endpoint_t *ep, bool speech, const int16_t *pcm, size_t samples)
+{
+    uint32_t frame_ms = samples * 1000 / ep->config.sample_rate;
+    ep->frames++;
+    ep->elapsed_ms += frame_ms;
+
+    if (pcm && samples) {
+        float db = endpoint_level_db(pcm, samples);
+        if (speech) {
+            ep->speech_frames++;
+            ep->speech_db += (db - ep->speech_db) / ep->speech_frames;
+        } else if (ep->noise_valid) {
+            ep->noise_db += (db - ep->noise_db) * ENDPOINT_NOISE_ALPHA;
+        } else {
+            ep->noise_db = db;
+            ep->noise_valid = true;
+        }
+    }
+
+    if (speech) {
+        ep->speech_ms += frame_ms;
+        ep->silence_ms = 0;
+        return APP_ENDPOINT_CONTINUE;
+    }
+
+    ep->silence_ms += frame_ms;
+    if (ep->speech_ms == 0) {
+        return (ep->elapsed_ms >= ep->config.no_speech_ms) ? APP_ENDPOINT_NO_SPEECH : APP_ENDPOINT_CONTINUE;
+    }
+    ep->hangover_ms = endpoint_hangover(ep);
+    return (ep->silence_ms >= ep->hangover_ms) ? APP_ENDPOINT_END_OF_SPEECH : APP_ENDPOINT_CONTINUE;
+}
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t sample_rate;
+    uint32_t min_ms;            /*!< Shortest silence that ends speech */
+    uint32_t max_ms;            /*!< Longest silence before speech is ended */
+    uint32_t length_percent;    /*!< Silence added per speech time, in percent */
+    int32_t low_snr_db;         /*!< Below this speech-to-noise ratio the silence is 1.5x longer */
+    uint32_t no_speech_ms;      /*!< End the turn if no speech starts within this time */
+} app_endpoint_config_t;
+
+typedef enum {
+    APP_ENDPOINT_CONTINUE = 0,  /*!< Keep listening */
+    APP_ENDPOINT_END_OF_SPEECH, /*!< Speech ended */
+    APP_ENDPOINT_NO_SPEECH,     /*!< Nothing was said */
+} app_endpoint_result_t;
+
+/**
+ * @brief End-of-speech detector on top of the per-frame VAD decision.
+ *
+ * The silence needed to end speech grows with the speech heard so far, and
+ * is 1.5 times longer when speech is close to the noise floor, where VAD
+ * misses more quiet syllables. It is kept within [min_ms, max_ms].
+ */
+typedef struct {
+    app_endpoint_config_t config;
+    uint32_t frames;            /*!< Frames seen since the reset */
+    uint32_t elapsed_ms;
+    uint32_t speech_ms;         /*!< Speech heard, pauses excluded */
+    uint32_t silence_ms;        /*!< Current run of silence */
+    uint32_t hangover_ms;       /*!< Silence currently needed to end speech */
+    float speech_db;            /*!< Mean level of speech frames */
+    float noise_db;             /*!< Tracked level of silent frames */
+    uint32_t speech_frames;
+    bool noise_valid;
+} app_endpoint_t;
+
+/**
+ * @brief Set up an endpointer and reset it.
+ *
+ * @param ep: Endpointer
+ * @param config: Configuration, copied
+ */
+void app_endpoint_init(app_endpoint_t *ep, const app_endpoint_config_t *config);
+
+/**
+ * @brief Start a new utterance, keeping the noise floor.
+ *
+ * @param ep: Endpointer
+ */
+void app_endpoint_reset(app_endpoint_t *ep);
+
+/**
+ * @brief Feed the VAD decision and samples of one frame.
+ *
+ * @param ep: Endpointer
+ * @param speech: VAD result of the frame
+ * @param pcm: Mono samples of the frame, may be NULL to skip the level tracking
+ * @param samples: Number of samples in the frame
+ *
+ * @return what to do after this frame
+ */
+app_endpoint_result_t app_endpoint_update(app_endpoint_t *ep, bool speech, const int16_t *pcm, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,254 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_event.h"
+
+static const char *TAG = "app_event";
+
+#define EVENT_SUB_MAX       (8)
+
+// 有界多生产者单消费者队列: 生产者用 CAS 抢占写位置, 槽位序号表示槽位是否可写可读
+typedef struct {
+    atomic_uint_fast32_t seq;
+    app_event_t event;
+} event_slot_t;
+
+struct app_event_sub {
+    uint32_t mask;                  /*!< APP_EVENT_BIT of the subscribed types */
+    uint32_t slot_mask;             /*!< depth - 1 */
+    event_slot_t *slots;
+    atomic_uint_fast32_t head;      /*!< Next position to publish, shared by the producers */
+    uint32_t tail;                  /*!< Next position to receive, subscriber only */
+    atomic_uint_fast32_t dropped;   /*!< Events dropped because the queue was full */
+};
+
+// 统计的流水线阶段: 前一事件之后第一次出现后一事件的间隔
+typedef struct {
+    app_event_type_t from;
+    app_event_type_t to;
+    const char *name;
+} event_pair_t;
+
+static const event_pair_t event_pairs[] = {
+    { APP_EVENT_WAKE,        APP_EVENT_RECORD_START,      "wake>record" },
+    { APP_EVENT_RECORD_STOP, APP_EVENT_UPLOADED,          "speech_end>uploaded" },
+    { APP_EVENT_UPLOADED,    APP_EVENT_REPLY_TEXT,        "uploaded>reply_text" },
+    { APP_EVENT_RECORD_STOP, APP_EVENT_REPLY_TEXT,        "speech_end>reply_text" },
+    { APP_EVENT_RECORD_STOP, APP_EVENT_REPLY_AUDIO_START, "speech_end>reply_audio" },
+};
+
+#define EVENT_PAIR_COUNT    (sizeof(event_pairs) / sizeof(event_pairs[0]))
+
+typedef struct {
+    uint32_t measured;              /*!< Publish count of `from` already measured */
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} event_pair_stats_t;
+
+static app_event_sub_handle_t _Atomic event_subs[EVENT_SUB_MAX];
+static atomic_uint_fast32_t event_sub_count;
+static atomic_uint_fast32_t event_value[APP_EVENT_MAX];
+
+// 延迟统计只在发布时更新几个字段, 用自旋锁保护, 队列本身不加锁
+static portMUX_TYPE event_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t event_time[APP_EVENT_MAX];
+static uint32_t event_count[APP_EVENT_MAX];
+static event_pair_stats_t event_pair_stats[EVENT_PAIR_COUNT];
+
+app_event_sub_handle_t app_event_subscribe(uint32_t mask, size_t depth)
+{
+    ESP_RETURN_ON_FALSE(depth && (depth & (depth - 1)) == 0, NULL, TAG, "depth %zu is not a power of two", depth);
+
+    app_event_sub_handle_t sub = heap_caps_calloc(1, sizeof(struct app_event_sub), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(sub, NULL, TAG, "no memory for subscriber");
+    sub->slots = heap_caps_calloc(depth, sizeof(event_slot_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (sub->slots == NULL) {
+        ESP_LOGE(TAG, "no memory for %zu events", depth);
+        heap_caps_free(sub);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < depth; i++) {
+        atomic_init(&sub->slots[i].seq, i);
+    }
+    sub->mask = mask;
+    sub->slot_mask = depth - 1;
+    atomic_init(&sub->head, 0);
+    atomic_init(&sub->dropped, 0);
+
+    // 分配成功后才占用订阅位置, 失败的订阅不留下空位
+    uint_fast32_t index = atomic_load_explicit(&event_sub_count, memory_order_relaxed);
+    do {
+        if (index >= EVENT_SUB_MAX) {
+            ESP_LOGE(TAG, "too many subscribers");
+            heap_caps_free(sub->slots);
+            heap_caps_free(sub);
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&event_sub_count, &index, index + 1,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    // 队列初始化完成后才对发布者可见
+    atomic_store_explicit(&event_subs[index], sub, memory_order_release);
+    return sub;
+}
+
+static void event_enqueue(app_event_sub_handle_t sub, const app_event_t *event)
+{
+    uint_fast32_t pos = atomic_load_explicit(&sub->head, memory_order_relaxed);
+    event_slot_t *slot;
+    while (true) {
+        slot = &sub->slots[pos & sub->slot_mask];
+        int32_t diff = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&sub->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 订阅者还没取走一圈之前的事件, 丢弃而不是等待
+            atomic_fetch_add(&sub->dropped, 1);
+            return;
+        } else {
+            pos = atomic_load_explicit(&sub->head, memory_order_relaxed);
+        }
+    }
+    slot->event = *event;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+bool app_event_receive(app_event_sub_handle_t sub, app_event_t *event)
+{
+    event_slot_t *slot = &sub->slots[sub->tail & sub->slot_mask];
+    if ((uint32_t)atomic_load_explicit(&slot->seq, memory_order_acquire) != sub->tail + 1) {
+        return false;
+    }
+    *event = slot->event;
+    atomic_store_explicit(&slot->seq, sub->tail + sub->slot_mask + 1, memory_order_release);
+    sub->tail++;
+    return true;
+}
+
+uint32_t app_event_get_dropped(app_event_sub_handle_t sub)
+{
+    return atomic_load(&sub->dropped);
+}
+
+static void event_measure(const app_event_t *event)
+{
+    portENTER_CRITICAL(&event_lock);
+    for (int i = 0; i < EVENT_PAIR_COUNT; i++) {
+        const event_pair_t *pair = &event_pairs[i];
+        event_pair_stats_t *stats = &event_pair_stats[i];
+        if (pair->to != event->type || event_count[pair->from] == stats->measured) {
+            continue;
+        }
+        // 同一个起点只统计第一次, 后续语音段不算
+        stats->measured = event_count[pair->from];
+        uint32_t interval = event->time_us - event_time[pair->from];
+        stats->count++;
+        stats->last_us = interval;
+        stats->max_us = MAX(stats->max_us, interval);
+        stats->sum_us += interval;
+    }
+    event_time[event->type] = event->time_us;
+    event_count[event->type]++;
+    portEXIT_CRITICAL(&event_lock);
+}
+
+void app_event_publish(app_event_type_t type, uint32_t value)
+{
+    if (type >= APP_EVENT_MAX) {
+        return;
+    }
+    app_event_t event = {
+        .type = type,
+        .value = value,
+        .time_us = esp_timer_get_time(),
+    };
+    atomic_store_explicit(&event_value[type], value, memory_order_release);
+    event_measure(&event);
+
+    for (int i = 0; i < EVENT_SUB_MAX; i++) {
+        app_event_sub_handle_t sub = atomic_load_explicit(&event_subs[i], memory_order_acquire);
+        if (sub && (sub->mask & APP_EVENT_BIT(type))) {
+            event_enqueue(sub, &event);
+        }
+    }
+}
+
+uint32_t app_event_value(app_event_type_t type)
+{
+    if (type >= APP_EVENT_MAX) {
+        return 0;
+    }
+    return atomic_load_explicit(&event_value[type], memory_order_acquire);
+}
+
+esp_err_t app_event_get_latency(app_event_type_t from, app_event_type_t to, app_event_latency_t *latency)
+{
+    for (int i = 0; i < EVENT_PAIR_COUNT; i++) {
+        if (event_pairs[i].from != from || event_pairs[i].to != to) {
+            continue;
+        }
+        portENTER_CRITICAL(&event_lock);
+        event_pair_stats_t stats = event_pair_stats[i];
+        portEXIT_CRITICAL(&event_lock);
+        latency->count = stats.count;
+        latency->last_us = stats.last_us;
+        latency->max_us = stats.max_us;
+        latency->avg_us = stats.count ? stats.sum_us / stats.count : 0;
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void app_event_log(void)
+{
+    app_event_latency_t latency;
+    for (int i = 0; i < EVENT_PAIR_COUNT; i++) {
+        app_event_get_latency(event_pairs[i].from, event_pairs[i].to, &latency);
+        if (latency.count) {
+            ESP_LOGI(TAG, "%s: last %" PRIu32 " ms, avg %" PRIu32 " ms, max %" PRIu32 " ms, %" PRIu32 " times",
+                     event_pairs[i].name, latency.last_us / 1000, latency.avg_us / 1000, latency.max_us / 1000, latency.count);
+        }
+    }
+    for (int i = 0; i < EVENT_SUB_MAX; i++) {
+        app_event_sub_handle_t sub = atomic_load_explicit(&event_subs[i], memory_order_acquire);
+        uint32_t dropped = sub ? atomic_load(&sub->dropped) : 0;
+        if (dropped) {
+            ESP_LOGW(TAG, "subscriber %d (mask 0x%" PRIx32 ") dropped %" PRIu32 " events", i, sub->mask, dropped);
+        }
+    }
+}
+
+cJSON *app_event_to_json(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return NULL;
+    }
+    app_event_latency_t latency;
+    for (int i = 0; i < EVENT_PAIR_COUNT; i++) {
+        app_event_get_latency(event_pairs[i].from, event_pairs[i].to, &latency);
+        cJSON *item = cJSON_AddObjectToObject(root, event_pairs[i].name);
+        if (item) {
+            cJSON_AddNumberToObject(item, "count", latency.count);
+            cJSON_AddNumberToObject(item, "last_us", latency.last_us);
+            cJSON_AddNumberToObject(item, "avg_us", latency.avg_us);
+            cJSON_AddNumberToObject(item, "max_us", latency.max_us);
+        }
+    }
+    return root;
+}
@@ -0,0 +1,134 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Events shared between the SR, audio, network, UART and UI tasks.
+ *
+ * Every event is timestamped when published. The bus keeps the value of
+ * the latest event of each type, for state that is polled, and copies the
+ * event into the queue of every subscriber of its type.
+ */
+typedef enum {
+    APP_EVENT_WIFI = 0,             /*!< Wi-Fi status changed, value: WiFi_Connect_Status */
+    APP_EVENT_MANUAL_WAKE,          /*!< Wake requested without the wake word */
+    APP_EVENT_WAKE,                 /*!< Wake detected, value: 1 for the wake word, 0 for a manual wake */
+    APP_EVENT_RECORD_START,         /*!< Recording started */
+    APP_EVENT_RECORD_STOP,          /*!< Recording stopped at the end of speech, value: file bytes */
+    APP_EVENT_UPLOADED,             /*!< Request body sent, value: bytes */
+    APP_EVENT_REPLY_TEXT,           /*!< First reply text of a request, value: bytes */
+    APP_EVENT_REPLY_AUDIO_START,    /*!< Reply segment started playing */
+    APP_EVENT_REPLY_AUDIO_END,      /*!< Whole reply finished playing, once per reply */
+    APP_EVENT_MAX,
+} app_event_type_t;
+
+#define APP_EVENT_BIT(type)     (1UL << (type))
+
+typedef struct {
+    app_event_type_t type;
+    uint32_t value;
+    int64_t time_us;                /*!< esp_timer time of the publish */
+} app_event_t;
+
+typedef struct {
+    uint32_t count;                 /*!< Intervals measured */
+    uint32_t last_us;               /*!< Latest interval */
+    uint32_t max_us;                /*!< Longest interval */
+    uint32_t avg_us;                /*!< Mean interval */
+} app_event_latency_t;
+
+/**
+ * @brief Subscriber queue, a lock-free ring that any task can publish into and one task reads.
+ */
+typedef struct app_event_sub *app_event_sub_handle_t;
+
+/**
+ * @brief Subscribe to event types, once at init; subscriptions are never removed.
+ *
+ * @param mask: APP_EVENT_BIT of each type to receive
+ * @param depth: Queue length, must be a power of two; events published into a full queue are dropped
+ *
+ * @return subscriber handle, NULL on failure
+ */
+app_event_sub_handle_t app_event_subscribe(uint32_t mask, size_t depth);
+
+/**
+ * @brief Publish an event, callable from any task without blocking.
+ *
+ * @param type: Event type
+ * @param value: Payload, see app_event_type_t
+ */
+void app_event_publish(app_event_type_t type, uint32_t value);
+
+/**
+ * @brief Take the oldest event of a subscriber, from the subscribing task only.
+ *
+ * @param sub: Subscriber handle
+ * @param event: Output
+ *
+ * @return false if the queue is empty
+ */
+bool app_event_receive(app_event_sub_handle_t sub, app_event_t *event);
+
+/**
+ * @brief Get the number of events dropped because the subscriber queue was full.
+ *
+ * @param sub: Subscriber handle
+ *
+ * @return events dropped since subscribing
+ */
+uint32_t app_event_get_dropped(app_event_sub_handle_t sub);
+
+/**
+ * @brief Get the value of the latest event of a type.
+ *
+ * @param type: Event type
+ *
+ * @return value, 0 before the first publish
+ */
+uint32_t app_event_value(app_event_type_t type);
+
+/**
+ * @brief Get the interval from an event to the first event of another type after it.
+ *
+ * Only the stage pairs of the conversation pipeline are measured.
+ *
+ * @param from: Earlier event type
+ * @param to: Later event type
+ * @param latency: Output
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_FOUND: The pair is not measured
+ */
+esp_err_t app_event_get_latency(app_event_type_t from, app_event_type_t to, app_event_latency_t *latency);
+
+/**
+ * @brief Log the stage latencies and the events dropped by full subscriber queues.
+ */
+void app_event_log(void);
+
+/**
+ * @brief Stage latencies as a JSON object.
+ *
+ * @return object to be freed with cJSON_Delete, NULL if out of memory
+ */
+cJSON *app_event_to_json(void);
+
+#ifdef __cplusplus
+}
+#endif
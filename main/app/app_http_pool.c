@@ -0,0 +1,306 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_http_pool.h"
+
+static const char *TAG = "app_http_pool";
+
+#define HTTP_POOL_SIZE              (CONFIG_HTTP_POOL_SIZE)
+#define HTTP_POOL_IDLE_TIMEOUT_US   (CONFIG_HTTP_POOL_IDLE_TIMEOUT_S * 1000000LL)
+#define HTTP_POOL_KEY_MAX_SIZE      (96)
+#define HTTP_POOL_DEFAULT_TIMEOUT   (5000)
+#define HTTP_POOL_SWEEP_PERIOD_US   (HTTP_POOL_IDLE_TIMEOUT_US / 2)
+
+typedef struct {
+    char key[HTTP_POOL_KEY_MAX_SIZE];       /*!< scheme://host:port */
+    esp_http_client_handle_t client;
+    http_event_handle_cb event_handler;     /*!< Handler of the current request */
+    void *user_data;                        /*!< User data of the current request */
+    int64_t last_used;
+    bool in_use;
+    bool server_close;                      /*!< Server asked to close, or the connection dropped */
+    bool expired;                           /*!< Idle past the timeout, set by the sweep timer */
+} pool_entry_t;
+
+// 复用前删除上一个请求的请求头; Content-Length 和 Transfer-Encoding 由 esp_http_client_open 按写入长度加上
+static const char *const pool_request_headers[] = {
+    "Content-Type",
+    "Content-Length",
+    "Transfer-Encoding",
+};
+
+static pool_entry_t pool[HTTP_POOL_SIZE];
+static SemaphoreHandle_t pool_lock = NULL;
+static esp_timer_handle_t pool_sweep_timer = NULL;
+static app_http_pool_stats_t pool_stats = {0};
+
+// 由 URL 生成连接键: scheme://host:port
+static bool pool_make_key(const char *url, char *key, size_t size)
+{
+    const char *sep = strstr(url, "://");
+    if (sep == NULL) {
+        return false;
+    }
+    int scheme_len = sep - url;
+    const char *host = sep + 3;
+    int host_len = strcspn(host, "/?#");
+
+    // 去掉 user:password@
+    for (int i = 0; i < host_len; i++) {
+        if (host[i] == '@') {
+            host += i + 1;
+            host_len -= i + 1;
+            break;
+        }
+    }
+
+    int port = (scheme_len == 5 && strncasecmp(url, "https", 5) == 0) ? 443 : 80;
+    for (int i = host_len - 1; i >= 0 && host[i] != ']'; i--) {
+        if (host[i] == ':') {
+            port = atoi(host + i + 1);
+            host_len = i;
+            break;
+        }
+    }
+
+    int n = snprintf(key, size, "%.*s://%.*s:%d", scheme_len, url, host_len, host, port);
+    return n > 0 && n < size;
+}
+
+// 转发事件到当前请求的处理函数, 并记录服务器是否关闭连接
+static esp_err_t pool_event_handler(esp_http_client_event_t *evt)
+{
+    pool_entry_t *entry = (pool_entry_t *)evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_HEADER &&
+            strcasecmp(evt->header_key, "Connection") == 0 &&
+            strcasecmp(evt->header_value, "close") == 0) {
+        entry->server_close = true;
+    } else if (evt->event_id == HTTP_EVENT_DISCONNECTED) {
+        entry->server_close = true;
+    }
+
+    if (entry->event_handler == NULL) {
+        return ESP_OK;
+    }
+    evt->user_data = entry->user_data;
+    return entry->event_handler(evt);
+}
+
+// 释放一个缓存的连接, 调用前需持有锁
+static void pool_evict(pool_entry_t *entry)
+{
+    ESP_LOGI(TAG, "evict %s", entry->key);
+    esp_http_client_cleanup(entry->client);
+    memset(entry, 0, sizeof(pool_entry_t));
+    pool_stats.evictions++;
+}
+
+static bool pool_idle_expired(const pool_entry_t *entry, int64_t now)
+{
+    return entry->client && !entry->in_use && (entry->expired || (now - entry->last_used) > HTTP_POOL_IDLE_TIMEOUT_US);
+}
+
+// 释放空闲超时的连接, 在请求连接的任务中调用, 调用前需持有锁
+static void pool_evict_idle(int64_t now)
+{
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (pool_idle_expired(&pool[i], now)) {
+            pool_evict(&pool[i]);
+        }
+    }
+}
+
+// 定时检查只标记超时的连接: 释放 TLS 连接要用较多栈, 不在 esp_timer 任务中做;
+// 由下一次 acquire 或 release 释放. 锁被占用时跳过这一次
+static void pool_sweep_callback(void *arg)
+{
+    if (xSemaphoreTake(pool_lock, 0) != pdTRUE) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (pool_idle_expired(&pool[i], now)) {
+            pool[i].expired = true;
+        }
+    }
+    xSemaphoreGive(pool_lock);
+}
+
+static pool_entry_t *pool_find(esp_http_client_handle_t client)
+{
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (pool[i].client == client) {
+            return &pool[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t app_http_pool_init(void)
+{
+    if (pool_lock) {
+        return ESP_OK;
+    }
+    pool_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(pool_lock, ESP_ERR_NO_MEM, TAG, "create lock failed");
+
+    const esp_timer_create_args_t sweep_timer_args = {
+        .callback = &pool_sweep_callback,
+        .name = "http_pool",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&sweep_timer_args, &pool_sweep_timer), TAG, "create sweep timer failed");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(pool_sweep_timer, HTTP_POOL_SWEEP_PERIOD_US), TAG, "start sweep timer failed");
+    return ESP_OK;
+}
+
+esp_http_client_handle_t app_http_pool_acquire(const esp_http_client_config_t *config, bool *reused)
+{
+    char key[HTTP_POOL_KEY_MAX_SIZE];
+    pool_entry_t *hit = NULL;
+    pool_entry_t *slot = NULL;
+    pool_entry_t *lru = NULL;
+
+    if (reused) {
+        *reused = false;
+    }
+    ESP_RETURN_ON_FALSE(pool_lock && config && config->url, NULL, TAG, "invalid state or config");
+    ESP_RETURN_ON_FALSE(pool_make_key(config->url, key, sizeof(key)), NULL, TAG, "invalid url %s", config->url);
+
+    xSemaphoreTake(pool_lock, portMAX_DELAY);
+    pool_evict_idle(esp_timer_get_time());
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        pool_entry_t *entry = &pool[i];
+        if (entry->client == NULL) {
+            if (slot == NULL && !entry->in_use) {
+                slot = entry;
+            }
+            continue;
+        }
+        if (entry->in_use) {
+            continue;
+        }
+        if (hit == NULL && strcmp(entry->key, key) == 0) {
+            hit = entry;
+        }
+        if (lru == NULL || entry->last_used < lru->last_used) {
+            lru = entry;
+        }
+    }
+
+    if (hit) {
+        hit->in_use = true;
+        hit->server_close = false;
+        hit->event_handler = config->event_handler;
+        hit->user_data = config->user_data;
+        pool_stats.hits++;
+        xSemaphoreGive(pool_lock);
+
+        esp_http_client_set_url(hit->client, config->url);
+        esp_http_client_set_method(hit->client, config->method);
+        esp_http_client_set_timeout_ms(hit->client, config->timeout_ms ? config->timeout_ms : HTTP_POOL_DEFAULT_TIMEOUT);
+        for (size_t i = 0; i < sizeof(pool_request_headers) / sizeof(pool_request_headers[0]); i++) {
+            esp_http_client_delete_header(hit->client, pool_request_headers[i]);
+        }
+        if (reused) {
+            *reused = true;
+        }
+        ESP_LOGD(TAG, "hit %s", key);
+        return hit->client;
+    }
+
+    pool_stats.misses++;
+    if (slot == NULL && lru) {
+        pool_evict(lru);
+        slot = lru;
+    }
+    if (slot) {
+        // 先占用, 创建客户端时不持有锁
+        slot->in_use = true;
+        strlcpy(slot->key, key, sizeof(slot->key));
+        slot->event_handler = config->event_handler;
+        slot->user_data = config->user_data;
+    }
+    xSemaphoreGive(pool_lock);
+
+    esp_http_client_config_t pool_config = *config;
+    if (slot) {
+        pool_config.event_handler = pool_event_handler;
+        pool_config.user_data = slot;
+    } else {
+        ESP_LOGW(TAG, "pool full, %s not cached", key);
+    }
+    esp_http_client_handle_t client = esp_http_client_init(&pool_config);
+
+    if (slot) {
+        xSemaphoreTake(pool_lock, portMAX_DELAY);
+        if (client) {
+            slot->client = client;
+        } else {
+            memset(slot, 0, sizeof(pool_entry_t));
+        }
+        xSemaphoreGive(pool_lock);
+    }
+    ESP_LOGD(TAG, "miss %s", key);
+    return client;
+}
+
+void app_http_pool_reconnect(esp_http_client_handle_t client)
+{
+    ESP_LOGW(TAG, "connection closed by server, reconnect");
+    esp_http_client_close(client);
+
+    xSemaphoreTake(pool_lock, portMAX_DELAY);
+    pool_entry_t *entry = pool_find(client);
+    if (entry) {
+        entry->server_close = false;
+    }
+    pool_stats.reconnects++;
+    xSemaphoreGive(pool_lock);
+}
+
+void app_http_pool_release(esp_http_client_handle_t client, bool reusable)
+{
+    if (client == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(pool_lock, portMAX_DELAY);
+    pool_entry_t *entry = pool_find(client);
+    if (entry == NULL) {
+        xSemaphoreGive(pool_lock);
+        esp_http_client_cleanup(client);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (!reusable || entry->server_close) {
+        pool_evict(entry);
+    } else {
+        entry->in_use = false;
+        entry->event_handler = NULL;
+        entry->user_data = NULL;
+        entry->last_used = now;
+    }
+    pool_evict_idle(now);
+    xSemaphoreGive(pool_lock);
+}
+
+void app_http_pool_get_stats(app_http_pool_stats_t *stats)
+{
+    xSemaphoreTake(pool_lock, portMAX_DELAY);
+    *stats = pool_stats;
+    xSemaphoreGive(pool_lock);
+}
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t hits;          /*!< Requests served by an idle, already connected client */
+    uint32_t misses;        /*!< Requests that needed a new client and connection */
+    uint32_t evictions;     /*!< Clients dropped for idleness, server close or pool pressure */
+    uint32_t reconnects;    /*!< Reused connections found closed by the server */
+} app_http_pool_stats_t;
+
+/**
+ * @brief Init the keep-alive connection cache.
+ *
+ * Idle connections are closed after CONFIG_HTTP_POOL_IDLE_TIMEOUT_S. A periodic
+ * timer only marks them expired; they are closed by the next acquire or
+ * release, in the calling task, and never handed out again.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_http_pool_init(void);
+
+/**
+ * @brief Get a client for `config->url`, reusing an idle connection to the same scheme, host and port.
+ *
+ * `event_handler` and `user_data` of `config` are honoured for this request
+ * only. Request headers left by the previous request on a reused handle are
+ * removed. Do not call esp_http_client_set_user_data or esp_http_client_cleanup
+ * on the returned handle, give it back with app_http_pool_release.
+ *
+ * @param config: Client configuration, `url` is required
+ * @param reused: Optional output, true if the handle already has an open connection
+ *
+ * @return client handle, NULL on failure
+ */
+esp_http_client_handle_t app_http_pool_acquire(const esp_http_client_config_t *config, bool *reused);
+
+/**
+ * @brief Close the connection of a reused client after the server dropped it, the next open reconnects.
+ *
+ * @param client: Handle from app_http_pool_acquire
+ */
+void app_http_pool_reconnect(esp_http_client_handle_t client);
+
+/**
+ * @brief Give a client back to the cache.
+ *
+ * @param client: Handle from app_http_pool_acquire
+ * @param reusable: true if the response was read completely and the connection can carry another request
+ */
+void app_http_pool_release(esp_http_client_handle_t client, bool reusable);
+
+/**
+ * @brief Get the cache counters.
+ *
+ * @param stats: Output
+ */
+void app_http_pool_get_stats(app_http_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
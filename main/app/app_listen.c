@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "app_listen.h"
+
+void app_listen_init(app_listen_t *ls, const app_endpoint_config_t *config)
+{
+    memset(ls, 0, sizeof(app_listen_t));
+    app_endpoint_init(&ls->endpoint, config);
+}
+
+void app_listen_start(app_listen_t *ls, bool command_window)
+{
+    app_endpoint_reset(&ls->endpoint);
+    ls->active = true;
+    ls->command_window = command_window;
+    ls->end_deferred = false;
+}
+
+static app_listen_result_t listen_finish(app_listen_t *ls, app_listen_result_t result)
+{
+    ls->active = false;
+    ls->command_window = false;
+    return result;
+}
+
+app_listen_result_t app_listen_update(app_listen_t *ls, app_listen_mn_t mn, bool speech, const int16_t *pcm, size_t samples)
+{
+    if (!ls->active) {
+        return APP_LISTEN_CONTINUE;
+    }
+    if (ls->command_window) {
+        // 唤醒后先在本地识别命令, 命中则不再上传
+        if (APP_LISTEN_MN_DETECTED == mn) {
+            return listen_finish(ls, APP_LISTEN_COMMAND);
+        } else if (APP_LISTEN_MN_TIMEOUT == mn) {
+            // 不是本地命令, 交给云端
+            ls->command_window = false;
+        }
+    }
+
+    // 说话结束判定: 所需静音时长随说话长度和信噪比调整
+    switch (app_endpoint_update(&ls->endpoint, speech, pcm, samples)) {
+    case APP_ENDPOINT_END_OF_SPEECH:
+        // MultiNet 要在命令说完后才给出结果, 窗口打开时等它识别或超时, 期间继续说话则重新计时
+        if (ls->command_window) {
+            ls->end_deferred = true;
+            return APP_LISTEN_CONTINUE;
+        }
+        return listen_finish(ls, APP_LISTEN_END_OF_SPEECH);
+    case APP_ENDPOINT_NO_SPEECH:
+        return listen_finish(ls, APP_LISTEN_NO_SPEECH);
+    default:
+        return APP_LISTEN_CONTINUE;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "app_endpoint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_LISTEN_MN_NONE = 0,     /*!< MultiNet still detecting, or not run this frame */
+    APP_LISTEN_MN_DETECTED,     /*!< MultiNet recognised a command */
+    APP_LISTEN_MN_TIMEOUT,      /*!< MultiNet window ended without a command */
+} app_listen_mn_t;
+
+typedef enum {
+    APP_LISTEN_CONTINUE = 0,    /*!< Keep listening */
+    APP_LISTEN_COMMAND,         /*!< Local command, the recording is not uploaded */
+    APP_LISTEN_END_OF_SPEECH,   /*!< Speech ended, upload the recording */
+    APP_LISTEN_NO_SPEECH,       /*!< Nothing was said */
+} app_listen_result_t;
+
+/**
+ * @brief What the detect task does with each AFE frame after the wake word.
+ *
+ * Kept free of esp-sr so the same decisions run in the host replay test.
+ */
+typedef struct {
+    app_endpoint_t endpoint;
+    bool active;                /*!< Woken, the utterance has not ended yet */
+    bool command_window;        /*!< MultiNet is listening for a local command */
+    bool end_deferred;          /*!< Speech ended inside the command window, held until MultiNet decides */
+} app_listen_t;
+
+/**
+ * @brief Set up the listener, idle until app_listen_start.
+ *
+ * @param ls: Listener
+ * @param config: Endpointer configuration, copied
+ */
+void app_listen_init(app_listen_t *ls, const app_endpoint_config_t *config);
+
+/**
+ * @brief Start an utterance after the wake word.
+ *
+ * @param ls: Listener
+ * @param command_window: true if MultiNet runs on the following frames
+ */
+void app_listen_start(app_listen_t *ls, bool command_window);
+
+/**
+ * @brief Feed one AFE frame.
+ *
+ * End of speech is not reported while the command window is open: it waits
+ * for MultiNet to detect a command or time out, so a command is never cut off
+ * and uploaded.
+ *
+ * @param ls: Listener
+ * @param mn: MultiNet result of the frame, only looked at while the command window is open
+ * @param speech: VAD result of the frame
+ * @param pcm: Mono samples of the frame, may be NULL
+ * @param samples: Number of samples in the frame
+ *
+ * @return what to do after this frame; the listener is idle again after any result but APP_LISTEN_CONTINUE
+ */
+app_listen_result_t app_listen_update(app_listen_t *ls, app_listen_mn_t mn, bool speech, const int16_t *pcm, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,309 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "driver/i2s_std.h"
+#include "app_audio.h"
+#include "app_spsc.h"
+#include "app_mixer.h"
+
+static const char *TAG = "app_mixer";
+
+#define MIXER_PERIOD_FRAMES     (256)       /*!< Frames mixed per I2S write, 16 ms */
+#define MIXER_FRAME_SIZE        (2 * sizeof(int16_t))
+#define MIXER_UNITY             (1 << 15)   /*!< Gain 1.0 in Q15 */
+#define MIXER_DUCK_GAIN         (MIXER_UNITY * CONFIG_MIXER_DUCK_PERCENT / 100)
+#define MIXER_RING_SIZE         (CONFIG_MIXER_RING_SIZE)
+
+typedef struct {
+    uint8_t priority;
+    app_spsc_handle_t ring;             /*!< Stream sources only */
+    SemaphoreHandle_t space;            /*!< Given by the mixer after it reads the ring */
+    volatile bool open;                 /*!< Stream writer active, cleared by app_mixer_close */
+    const int16_t *buf;                 /*!< Buffer sources, owned by the mixer task */
+    size_t buf_frames;
+    size_t buf_pos;
+    const int16_t *next_buf;            /*!< Submitted buffer, guarded by mixer_lock */
+    size_t next_frames;
+    bool next_pending;
+    bool flush;                         /*!< Guarded by mixer_lock */
+    int64_t submit_us;                  /*!< When the current play was submitted */
+    bool playing;                       /*!< Mixer side, produced audio since it became active */
+    int32_t gain;                       /*!< Q15, ramps to the target over one period */
+} mixer_source_t;
+
+// 各音源的优先级, 数值大的播放时压低数值小的
+static mixer_source_t mixer_sources[APP_MIXER_SOURCE_MAX] = {
+    [APP_MIXER_SOURCE_TTS]    = { .priority = 0 },
+    [APP_MIXER_SOURCE_PROMPT] = { .priority = 1 },
+};
+
+static TaskHandle_t mixer_task = NULL;
+static portMUX_TYPE mixer_lock = portMUX_INITIALIZER_UNLOCKED;
+static app_mixer_stats_t mixer_stats = {0};
+static int32_t mixer_acc[MIXER_PERIOD_FRAMES * 2];
+static int16_t mixer_out[MIXER_PERIOD_FRAMES * 2];
+
+// 取出提交的缓冲区和清空请求, 只在混音任务中调用
+static void mixer_source_update(mixer_source_t *src)
+{
+    portENTER_CRITICAL(&mixer_lock);
+    bool flush = src->flush;
+    bool pending = src->next_pending;
+    const int16_t *next = src->next_buf;
+    size_t next_frames = src->next_frames;
+    src->flush = false;
+    src->next_pending = false;
+    portEXIT_CRITICAL(&mixer_lock);
+
+    if (flush) {
+        src->buf_pos = src->buf_frames;
+        src->playing = false;
+        if (src->ring) {
+            const uint8_t *ptr;
+            size_t n;
+            while ((n = app_spsc_read_acquire(src->ring, &ptr)) > 0) {
+                app_spsc_read_commit(src->ring, n);
+            }
+            xSemaphoreGive(src->space);
+        }
+    }
+    if (pending) {
+        src->buf = next;
+        src->buf_frames = next_frames;
+        src->buf_pos = 0;
+        src->playing = false;
+    }
+}
+
+static bool mixer_source_active(mixer_source_t *src)
+{
+    if (src->buf_pos < src->buf_frames) {
+        return true;
+    }
+    return src->ring && (src->open || app_spsc_used(src->ring) > 0);
+}
+
+// 按增益累加 n 帧, 增益在整个周期内从 g0 线性变到 g1, 避免切换时的咔嗒声
+static void mixer_accumulate(const int16_t *pcm, size_t pos, size_t n, int32_t g0, int32_t g1)
+{
+    int32_t *acc = mixer_acc + pos * 2;
+    if (g0 == MIXER_UNITY && g1 == MIXER_UNITY) {
+        for (size_t i = 0; i < n * 2; i++) {
+            acc[i] += pcm[i];
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int32_t g = g0 + (g1 - g0) * (int32_t)(pos + i) / MIXER_PERIOD_FRAMES;
+        acc[i * 2 + 0] += (pcm[i * 2 + 0] * g) >> 15;
+        acc[i * 2 + 1] += (pcm[i * 2 + 1] * g) >> 15;
+    }
+}
+
+// 从一个音源取一个周期的数据混入累加器, 返回取到的帧数
+static size_t mixer_source_mix(mixer_source_t *src, int32_t target)
+{
+    size_t got = 0;
+    if (src->buf_pos < src->buf_frames) {
+        got = MIN(MIXER_PERIOD_FRAMES, src->buf_frames - src->buf_pos);
+        mixer_accumulate(src->buf + src->buf_pos * 2, 0, got, src->gain, target);
+        src->buf_pos += got;
+    } else if (src->ring) {
+        while (got < MIXER_PERIOD_FRAMES) {
+            const uint8_t *ptr;
+            size_t n = MIN(MIXER_PERIOD_FRAMES - got, app_spsc_read_acquire(src->ring, &ptr) / MIXER_FRAME_SIZE);
+            if (n == 0) {
+                break;
+            }
+            mixer_accumulate((const int16_t *)ptr, got, n, src->gain, target);
+            app_spsc_read_commit(src->ring, n * MIXER_FRAME_SIZE);
+            got += n;
+        }
+        if (got) {
+            xSemaphoreGive(src->space);
+        }
+        // 写端仍在播放但数据不足一个周期, 不足部分补零
+        if (src->playing && src->open && got < MIXER_PERIOD_FRAMES) {
+            mixer_stats.underruns++;
+        }
+    }
+    src->gain = target;
+
+    if (got && !src->playing) {
+        src->playing = true;
+        mixer_stats.start_latency_us = esp_timer_get_time() - src->submit_us;
+        mixer_stats.start_latency_max_us = MAX(mixer_stats.start_latency_max_us, mixer_stats.start_latency_us);
+    }
+    return got;
+}
+
+// 混音任务: 唯一写 I2S 的任务, 没有音源时休眠
+static void mixer_task_fn(void *args)
+{
+    bool idle = true;
+    while (1) {
+        int top = -1;
+        bool active[APP_MIXER_SOURCE_MAX];
+        for (int i = 0; i < APP_MIXER_SOURCE_MAX; i++) {
+            mixer_source_t *src = &mixer_sources[i];
+            mixer_source_update(src);
+            active[i] = mixer_source_active(src);
+            if (active[i]) {
+                top = MAX(top, src->priority);
+            } else {
+                src->playing = false;
+                src->gain = MIXER_UNITY;
+            }
+        }
+
+        if (top < 0) {
+            if (!idle) {
+                idle = true;
+                ESP_LOGI(TAG, "idle, %" PRIu32 " periods, %" PRIu32 " underruns, start latency %" PRIu32 " us (max %" PRIu32 "), queue max %" PRIu32 " ms",
+                         mixer_stats.periods, mixer_stats.underruns, mixer_stats.start_latency_us,
+                         mixer_stats.start_latency_max_us, mixer_stats.queue_max_ms);
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (idle) {
+            idle = false;
+            audio_codec_prepare(AUDIO_CODEC_SAMPLE_RATE, 16, I2S_SLOT_MODE_STEREO);
+        }
+
+        memset(mixer_acc, 0, sizeof(mixer_acc));
+        for (int i = 0; i < APP_MIXER_SOURCE_MAX; i++) {
+            mixer_source_t *src = &mixer_sources[i];
+            if (active[i]) {
+                mixer_source_mix(src, (src->priority < top) ? MIXER_DUCK_GAIN : MIXER_UNITY);
+            }
+        }
+        for (int i = 0; i < MIXER_PERIOD_FRAMES * 2; i++) {
+            int32_t v = mixer_acc[i];
+            mixer_out[i] = (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v;
+        }
+
+        // 写满 DMA 队列后阻塞, 由 I2S 的节拍驱动混音周期
+        size_t written = 0;
+        audio_playback_write(mixer_out, sizeof(mixer_out), &written, portMAX_DELAY);
+        mixer_stats.periods++;
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_mixer_init(void)
+{
+    if (mixer_task) {
+        return ESP_OK;
+    }
+
+    // 环形缓冲区按掩码取下标, 大小必须是 2 的幂
+    ESP_RETURN_ON_FALSE((MIXER_RING_SIZE & (MIXER_RING_SIZE - 1)) == 0, ESP_ERR_INVALID_ARG, TAG,
+                        "MIXER_RING_SIZE %d is not a power of two", MIXER_RING_SIZE);
+    mixer_source_t *tts = &mixer_sources[APP_MIXER_SOURCE_TTS];
+    tts->ring = app_spsc_create(MIXER_RING_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    tts->space = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(tts->ring && tts->space, ESP_ERR_NO_MEM, TAG, "no memory for stream ring");
+    for (int i = 0; i < APP_MIXER_SOURCE_MAX; i++) {
+        mixer_sources[i].gain = MIXER_UNITY;
+    }
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(mixer_task_fn, "Mixer Task", 3 * 1024, NULL, 6, &mixer_task, 1);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_ERR_NO_MEM, TAG, "create mixer task failed");
+    return ESP_OK;
+}
+
+size_t app_mixer_write(app_mixer_source_t source, const void *data, size_t len, TickType_t timeout)
+{
+    mixer_source_t *src = &mixer_sources[source];
+    if (mixer_task == NULL || src->ring == NULL) {
+        return 0;
+    }
+
+    if (!src->open) {
+        src->submit_us = esp_timer_get_time();
+        src->open = true;
+    }
+    uint32_t queued_ms = app_spsc_used(src->ring) * 1000 / (AUDIO_CODEC_SAMPLE_RATE * MIXER_FRAME_SIZE);
+    mixer_stats.queue_max_ms = MAX(mixer_stats.queue_max_ms, queued_ms);
+
+    const uint8_t *in = data;
+    size_t done = 0;
+    len &= ~(MIXER_FRAME_SIZE - 1);
+    TimeOut_t time_out;
+    vTaskSetTimeOutState(&time_out);
+    while (done < len) {
+        uint8_t *ptr;
+        size_t n = MIN(len - done, app_spsc_write_acquire(src->ring, &ptr));
+        if (n) {
+            memcpy(ptr, in + done, n);
+            app_spsc_write_commit(src->ring, n);
+            done += n;
+            xTaskNotifyGive(mixer_task);
+            continue;
+        }
+        // 缓冲区已满, 等混音任务取走数据
+        if (xTaskCheckForTimeOut(&time_out, &timeout) == pdTRUE || xSemaphoreTake(src->space, timeout) != pdTRUE) {
+            break;
+        }
+    }
+    return done;
+}
+
+void app_mixer_close(app_mixer_source_t source)
+{
+    mixer_sources[source].open = false;
+    if (mixer_task) {
+        xTaskNotifyGive(mixer_task);
+    }
+}
+
+esp_err_t app_mixer_play_buffer(app_mixer_source_t source, const void *data, size_t len)
+{
+    ESP_RETURN_ON_FALSE(mixer_task, ESP_ERR_INVALID_STATE, TAG, "mixer not started");
+    mixer_source_t *src = &mixer_sources[source];
+
+    portENTER_CRITICAL(&mixer_lock);
+    src->next_buf = data;
+    src->next_frames = len / MIXER_FRAME_SIZE;
+    src->next_pending = true;
+    src->submit_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&mixer_lock);
+    xTaskNotifyGive(mixer_task);
+    return ESP_OK;
+}
+
+void app_mixer_flush(app_mixer_source_t source)
+{
+    mixer_source_t *src = &mixer_sources[source];
+    portENTER_CRITICAL(&mixer_lock);
+    src->flush = true;
+    src->next_pending = false;
+    portEXIT_CRITICAL(&mixer_lock);
+    if (mixer_task) {
+        xTaskNotifyGive(mixer_task);
+    }
+}
+
+void app_mixer_get_stats(app_mixer_stats_t *stats)
+{
+    *stats = mixer_stats;
+}
+
+TaskHandle_t app_mixer_get_task(void)
+{
+    return mixer_task;
+}
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mixer sources, a higher value has a higher priority.
+ *
+ * While a source plays, every lower-priority source is ducked to
+ * CONFIG_MIXER_DUCK_PERCENT of its level.
+ */
+typedef enum {
+    APP_MIXER_SOURCE_TTS = 0,       /*!< Decoded replies, streamed with app_mixer_write */
+    APP_MIXER_SOURCE_PROMPT,        /*!< Preloaded prompts, played with app_mixer_play_buffer */
+    APP_MIXER_SOURCE_MAX,
+} app_mixer_source_t;
+
+typedef struct {
+    uint32_t underruns;             /*!< Mix periods where an open stream had too little data */
+    uint32_t periods;               /*!< Mix periods written to I2S */
+    uint32_t start_latency_us;      /*!< Submit to first mixed period, last start */
+    uint32_t start_latency_max_us;  /*!< Same, worst since boot */
+    uint32_t queue_max_ms;          /*!< Most audio seen queued in a stream ring */
+} app_mixer_stats_t;
+
+/**
+ * @brief Start the mixer task, the only writer of the speaker output.
+ *
+ * All sources are 16-bit stereo at AUDIO_CODEC_SAMPLE_RATE.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: CONFIG_MIXER_RING_SIZE is not a power of two
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_mixer_init(void);
+
+/**
+ * @brief Queue PCM on a streamed source.
+ *
+ * @param source: Source id
+ * @param data: Interleaved stereo samples
+ * @param len: Bytes, a multiple of 4
+ * @param timeout: Max time to wait for space, 0 to take only what fits now
+ *
+ * @return bytes queued
+ */
+size_t app_mixer_write(app_mixer_source_t source, const void *data, size_t len, TickType_t timeout);
+
+/**
+ * @brief Mark the end of a stream, queued audio still plays out.
+ *
+ * @param source: Source id
+ */
+void app_mixer_close(app_mixer_source_t source);
+
+/**
+ * @brief Play a PCM buffer on a source without copying it, replacing what the source was playing.
+ *
+ * Never blocks. `data` must stay valid until it has played or the source is flushed.
+ *
+ * @param source: Source id
+ * @param data: Interleaved stereo samples
+ * @param len: Bytes, a multiple of 4
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Mixer not started
+ */
+esp_err_t app_mixer_play_buffer(app_mixer_source_t source, const void *data, size_t len);
+
+/**
+ * @brief Drop everything queued on a source, it goes silent within one mix period.
+ *
+ * @param source: Source id
+ */
+void app_mixer_flush(app_mixer_source_t source);
+
+/**
+ * @brief Get the mixer counters.
+ *
+ * @param stats: Output
+ */
+void app_mixer_get_stats(app_mixer_stats_t *stats);
+
+/**
+ * @brief Get the mixer task.
+ *
+ * @return task handle, NULL before app_mixer_init
+ */
+TaskHandle_t app_mixer_get_task(void);
+
+#ifdef __cplusplus
+}
+#endif
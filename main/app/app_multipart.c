@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_multipart.h"
+
+static const char *TAG = "app_multipart";
+
+#define MULTIPART_HEAD_MAX_SIZE     (256)
+#define MULTIPART_CLOSE             "\r\n--" APP_MULTIPART_BOUNDARY "--\r\n"
+
+// 生成一个分段的头部, buf 为 NULL 时只计算长度
+static int multipart_format_head(char *buf, size_t size, const app_multipart_part_t *part, bool first)
+{
+    return snprintf(buf, size, "%s--%s\r\nContent-Disposition: form-data; name=\"%s\"%s%s%s%s%s\r\n\r\n",
+                    first ? "" : "\r\n",
+                    APP_MULTIPART_BOUNDARY,
+                    part->name,
+                    part->filename ? "; filename=\"" : "",
+                    part->filename ? part->filename : "",
+                    part->filename ? "\"" : "",
+                    part->content_type ? "\r\nContent-Type: " : "",
+                    part->content_type ? part->content_type : "");
+}
+
+// 写入全部数据, 直到发送完成或出错
+static esp_err_t multipart_send(esp_http_client_handle_t client, const char *data, size_t len)
+{
+    while (len > 0) {
+        int n = esp_http_client_write(client, data, len);
+        ESP_RETURN_ON_FALSE(n > 0, ESP_FAIL, TAG, "write failed: %d", n);
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+size_t app_multipart_length(const app_multipart_part_t *parts, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += multipart_format_head(NULL, 0, &parts[i], i == 0) + parts[i].len;
+    }
+    return total + strlen(MULTIPART_CLOSE);
+}
+
+esp_err_t app_multipart_open(app_multipart_writer_t *writer, const app_multipart_part_t *parts, size_t count)
+{
+    ESP_RETURN_ON_FALSE(writer && writer->client, ESP_ERR_INVALID_ARG, TAG, "invalid writer");
+
+    esp_http_client_set_method(writer->client, HTTP_METHOD_POST);
+    esp_http_client_set_header(writer->client, "Content-Type", "multipart/form-data; boundary=" APP_MULTIPART_BOUNDARY);
+
+    // 长度为 -1 时 esp_http_client 使用 chunked 编码, 分块格式由写入方负责
+    int write_len = writer->chunked ? -1 : (int)app_multipart_length(parts, count);
+    writer->sent = 0;
+    ESP_LOGI(TAG, "open multipart request, length %d", write_len);
+    return esp_http_client_open(writer->client, write_len);
+}
+
+esp_err_t app_multipart_write(app_multipart_writer_t *writer, const void *data, size_t len)
+{
+    if (len == 0) {
+        return ESP_OK;
+    }
+    if (!writer->chunked) {
+        ESP_RETURN_ON_ERROR(multipart_send(writer->client, data, len), TAG, "body");
+        writer->sent += len;
+        return ESP_OK;
+    }
+
+    char size_line[12];
+    int n = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned int)len);
+    ESP_RETURN_ON_ERROR(multipart_send(writer->client, size_line, n), TAG, "chunk size");
+    ESP_RETURN_ON_ERROR(multipart_send(writer->client, data, len), TAG, "chunk data");
+    writer->sent += len;
+    return multipart_send(writer->client, "\r\n", 2);
+}
+
+esp_err_t app_multipart_write_part_head(app_multipart_writer_t *writer, const app_multipart_part_t *part, bool first)
+{
+    char head[MULTIPART_HEAD_MAX_SIZE];
+    int n = multipart_format_head(head, sizeof(head), part, first);
+    ESP_RETURN_ON_FALSE(n > 0 && n < sizeof(head), ESP_ERR_INVALID_SIZE, TAG, "part head too long");
+    return app_multipart_write(writer, head, n);
+}
+
+esp_err_t app_multipart_write_close(app_multipart_writer_t *writer)
+{
+    ESP_RETURN_ON_ERROR(app_multipart_write(writer, MULTIPART_CLOSE, strlen(MULTIPART_CLOSE)), TAG, "closing boundary");
+    if (writer->chunked) {
+        return multipart_send(writer->client, "0\r\n\r\n", 5);
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_multipart_write_parts(app_multipart_writer_t *writer, const app_multipart_part_t *parts, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        ESP_RETURN_ON_ERROR(app_multipart_write_part_head(writer, &parts[i], i == 0), TAG, "part %s", parts[i].name);
+        ESP_RETURN_ON_ERROR(app_multipart_write(writer, parts[i].data, parts[i].len), TAG, "part %s", parts[i].name);
+    }
+    return app_multipart_write_close(writer);
+}
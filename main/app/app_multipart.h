@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_MULTIPART_BOUNDARY  "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+
+typedef struct {
+    const char *name;           /*!< Form field name */
+    const char *filename;       /*!< File name, NULL for a plain field */
+    const char *content_type;   /*!< Content type, NULL to omit */
+    const void *data;           /*!< Part body, sent in place without copying */
+    size_t len;                 /*!< Length of the part body */
+} app_multipart_part_t;
+
+typedef struct {
+    esp_http_client_handle_t client;
+    bool chunked;               /*!< Body length unknown, frame every write as an HTTP chunk */
+    size_t sent;                /*!< Body bytes written since open, chunk framing excluded */
+} app_multipart_writer_t;
+
+/**
+ * @brief Total body length of a multipart request made of `parts`.
+ *
+ * @param parts: Parts of the form
+ * @param count: Number of parts
+ *
+ * @return body length in bytes, computed from the parts themselves
+ */
+size_t app_multipart_length(const app_multipart_part_t *parts, size_t count);
+
+/**
+ * @brief Set the multipart Content-Type and open the request.
+ *
+ * With `writer->chunked` false the Content-Length is computed from `parts`,
+ * otherwise the request is opened with chunked transfer encoding and `parts`
+ * may be NULL.
+ *
+ * @param writer: Writer, `client` and `chunked` must be set
+ * @param parts: Parts of the form
+ * @param count: Number of parts
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - Others: Fail
+ */
+esp_err_t app_multipart_open(app_multipart_writer_t *writer, const app_multipart_part_t *parts, size_t count);
+
+/**
+ * @brief Write raw body bytes, as one chunk if the writer is chunked.
+ *
+ * @param writer: Writer
+ * @param data: Bytes to send
+ * @param len: Number of bytes
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_FAIL: Connection error
+ */
+esp_err_t app_multipart_write(app_multipart_writer_t *writer, const void *data, size_t len);
+
+/**
+ * @brief Write the boundary and headers of a part, the body follows with app_multipart_write.
+ *
+ * @param writer: Writer
+ * @param part: Part whose header is sent, `data` and `len` are ignored
+ * @param first: true for the first part of the form
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - Others: Fail
+ */
+esp_err_t app_multipart_write_part_head(app_multipart_writer_t *writer, const app_multipart_part_t *part, bool first);
+
+/**
+ * @brief Write the closing boundary, and the last chunk if the writer is chunked.
+ *
+ * @param writer: Writer
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - Others: Fail
+ */
+esp_err_t app_multipart_write_close(app_multipart_writer_t *writer);
+
+/**
+ * @brief Write a complete form: every part header and body, then the closing boundary.
+ *
+ * @param writer: Writer
+ * @param parts: Parts of the form
+ * @param count: Number of parts
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - Others: Fail
+ */
+esp_err_t app_multipart_write_parts(app_multipart_writer_t *writer, const app_multipart_part_t *parts, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_spsc.h"
+#include "app_playback_ref.h"
+
+static const char *TAG = "app_playback_ref";
+
+struct app_playback_ref {
+    app_spsc_handle_t ring;
+    size_t delay_frames;
+    bool primed;                /*!< Reader side, delay line filled */
+};
+
+app_playback_ref_handle_t app_playback_ref_create(size_t ring_size, size_t delay_frames)
+{
+    ESP_RETURN_ON_FALSE(delay_frames * sizeof(int16_t) < ring_size, NULL, TAG, "delay %zu frames does not fit", delay_frames);
+
+    app_playback_ref_handle_t ref = heap_caps_calloc(1, sizeof(struct app_playback_ref), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(ref, NULL, TAG, "no memory for playback reference");
+    ref->ring = app_spsc_create(ring_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (ref->ring == NULL) {
+        heap_caps_free(ref);
+        return NULL;
+    }
+    ref->delay_frames = delay_frames;
+    return ref;
+}
+
+void app_playback_ref_delete(app_playback_ref_handle_t ref)
+{
+    if (ref) {
+        app_spsc_delete(ref->ring);
+        heap_caps_free(ref);
+    }
+}
+
+bool app_playback_ref_write(app_playback_ref_handle_t ref, const int16_t *pcm, size_t frames)
+{
+    // 写入返回后数据已进入 DMA 队列, 此时放入参考, 环形缓冲区的水位即为播放延迟
+    if (!app_spsc_write_reserve(ref->ring, frames * sizeof(int16_t))) {
+        return false;
+    }
+    size_t i = 0;
+    while (i < frames) {
+        uint8_t *ptr;
+        size_t n = MIN(frames - i, app_spsc_write_acquire(ref->ring, &ptr) / sizeof(int16_t));
+        int16_t *mono = (int16_t *)ptr;
+        for (size_t j = 0; j < n; j++, i++) {
+            mono[j] = (pcm[i * 2 + 0] + pcm[i * 2 + 1]) >> 1;
+        }
+        app_spsc_write_commit(ref->ring, n * sizeof(int16_t));
+    }
+    return true;
+}
+
+size_t app_playback_ref_read(app_playback_ref_handle_t ref, int16_t *out, size_t frames)
+{
+    size_t got = 0;
+    size_t used = app_spsc_used(ref->ring) / sizeof(int16_t);
+    // 播放开始时先积累到 DMA 队列的深度; 等待期间多出的部分已经播放过, 丢掉,
+    // 读取之后环形缓冲区里只剩还在 DMA 队列中的部分, 参考才与扬声器的声音对齐
+    if (!ref->primed && used >= frames + ref->delay_frames) {
+        app_spsc_read_commit(ref->ring, (used - frames - ref->delay_frames) * sizeof(int16_t));
+        used = frames + ref->delay_frames;
+        ref->primed = true;
+    }
+    if (ref->primed) {
+        size_t want = MIN(frames, used);
+        while (got < want) {
+            const uint8_t *ptr;
+            size_t n = MIN(want - got, app_spsc_read_acquire(ref->ring, &ptr) / sizeof(int16_t));
+            memcpy(out + got, ptr, n * sizeof(int16_t));
+            app_spsc_read_commit(ref->ring, n * sizeof(int16_t));
+            got += n;
+        }
+        // 播放结束或断流, 下次重新对齐
+        ref->primed = (got == frames);
+    }
+    memset(out + got, 0, (frames - got) * sizeof(int16_t));
+    return got;
+}
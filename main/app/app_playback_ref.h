@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Playback reference tap for AEC: a mono copy of the speaker output, aligned to the microphone feed.
+ *
+ * The output task writes each block right after handing it to I2S, the feed
+ * task reads one chunk per captured chunk. The reader holds the reference
+ * back until the ring is `delay_frames` ahead, i.e. until the first sample
+ * written has gone through the output DMA queue, and starts over after the
+ * playback runs dry.
+ */
+typedef struct app_playback_ref *app_playback_ref_handle_t;
+
+/**
+ * @brief Create a playback reference tap.
+ *
+ * @param ring_size: Ring size in bytes, a power of two larger than the delay plus a capture chunk
+ * @param delay_frames: Frames between handing samples to I2S and hearing them
+ *
+ * @return handle, NULL on failure
+ */
+app_playback_ref_handle_t app_playback_ref_create(size_t ring_size, size_t delay_frames);
+
+/**
+ * @brief Delete a playback reference tap.
+ *
+ * @param ref: Handle
+ */
+void app_playback_ref_delete(app_playback_ref_handle_t ref);
+
+/**
+ * @brief Writer side: add interleaved stereo samples just handed to I2S, mixed down to mono.
+ *
+ * @param ref: Handle
+ * @param pcm: Stereo samples, `frames * 2` values
+ * @param frames: Number of frames
+ *
+ * @return false if the ring was full and the block was dropped
+ */
+bool app_playback_ref_write(app_playback_ref_handle_t ref, const int16_t *pcm, size_t frames);
+
+/**
+ * @brief Reader side: get the reference for the next captured frames.
+ *
+ * @param ref: Handle
+ * @param out: Output, `frames` mono samples, zeros where nothing was playing
+ * @param frames: Number of frames captured
+ *
+ * @return frames of real reference, the rest are zeros
+ */
+size_t app_playback_ref_read(app_playback_ref_handle_t ref, int16_t *out, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,234 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "bsp_board.h"
+#include "bsp/esp-bsp.h"
+#include "audio_player.h"
+#include "app_audio.h"
+#include "app_dsp.h"
+#include "app_mixer.h"
+#include "app_prompt.h"
+
+static const char *TAG = "app_prompt";
+
+#define PROMPT_DEFAULT_RATE     (16000)
+#define PROMPT_DEFAULT_BITS     (16)
+
+static const char *prompt_files[APP_PROMPT_MAX] = {
+    [APP_PROMPT_EN_WAKE]    = BSP_SPIFFS_MOUNT_POINT "/echo_en_wake.wav",
+    [APP_PROMPT_EN_OK]      = BSP_SPIFFS_MOUNT_POINT "/echo_en_ok.wav",
+    [APP_PROMPT_EN_END]     = BSP_SPIFFS_MOUNT_POINT "/echo_en_end.wav",
+    [APP_PROMPT_CN_WAKE]    = BSP_SPIFFS_MOUNT_POINT "/echo_cn_wake.wav",
+    [APP_PROMPT_CN_OK]      = BSP_SPIFFS_MOUNT_POINT "/echo_cn_ok.wav",
+    [APP_PROMPT_CN_END]     = BSP_SPIFFS_MOUNT_POINT "/echo_cn_end.wav",
+    [APP_PROMPT_WAIT]       = BSP_SPIFFS_MOUNT_POINT "/waitPlease.mp3",
+    [APP_PROMPT_TTS_FAILED] = BSP_SPIFFS_MOUNT_POINT "/tts_failed.mp3",
+};
+
+static app_prompt_t prompts[APP_PROMPT_MAX] = {0};
+static bool prompt_loaded = false;
+
+static uint32_t prompt_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t prompt_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+// 解析 WAV 文件, 按块查找 fmt 和 data, 跳过 LIST 等其他块; 转换为编解码器的固定格式
+static esp_err_t prompt_parse_wav(uint8_t *file, size_t size, app_prompt_t *prompt)
+{
+    uint16_t format = 1;
+    uint16_t channels = 2;
+    uint32_t rate = PROMPT_DEFAULT_RATE;
+    uint16_t bits = PROMPT_DEFAULT_BITS;
+    uint8_t *data = NULL;
+    size_t data_len = 0;
+
+    if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0) {
+        // 没有文件头, 按 16k 16bit 双声道 PCM 处理
+        ESP_LOGI(TAG, "PCM format");
+        data = file;
+        data_len = size;
+    } else {
+        size_t pos = 12;
+        while (pos + 8 <= size) {
+            const uint8_t *id = file + pos;
+            uint32_t chunk_size = prompt_le32(file + pos + 4);
+            size_t body = pos + 8;
+            if (memcmp(id, "fmt ", 4) == 0 && chunk_size >= 16 && body + 16 <= size) {
+                format = prompt_le16(file + body);
+                channels = prompt_le16(file + body + 2);
+                rate = prompt_le32(file + body + 4);
+                bits = prompt_le16(file + body + 14);
+            } else if (memcmp(id, "data", 4) == 0) {
+                data = file + body;
+                data_len = MIN(chunk_size, size - body);
+                break;
+            }
+            pos = body + chunk_size + (chunk_size & 1);
+        }
+    }
+
+    ESP_RETURN_ON_FALSE(data && data_len, ESP_ERR_INVALID_SIZE, TAG, "no data chunk");
+    ESP_RETURN_ON_FALSE(format == 1 && bits == 16 && (channels == 1 || channels == 2),
+                        ESP_ERR_NOT_SUPPORTED, TAG, "unsupported wav, format=%d ch=%d bits=%d", format, channels, bits);
+
+    size_t frames = data_len / (channels * sizeof(int16_t));
+    prompt->bits = bits;
+    prompt->sample_rate = AUDIO_CODEC_SAMPLE_RATE;
+    if (channels == 2 && rate == AUDIO_CODEC_SAMPLE_RATE) {
+        prompt->data = data;
+        prompt->len = frames * 2 * sizeof(int16_t);
+        return ESP_OK;
+    }
+
+    // 转换为编解码器的固定格式: AUDIO_CODEC_SAMPLE_RATE 双声道, 播放时不再切换采样率
+    size_t out_frames = (uint64_t)frames * AUDIO_CODEC_SAMPLE_RATE / rate + 1;
+    int16_t *pcm = heap_caps_malloc(out_frames * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(pcm, ESP_ERR_NO_MEM, TAG, "no memory for pcm");
+    const int16_t *in = (const int16_t *)data;
+    if (rate == AUDIO_CODEC_SAMPLE_RATE) {
+        memcpy(pcm, in, frames * sizeof(int16_t));
+        out_frames = frames;
+    } else {
+        app_dsp_resampler_t rs = {0};
+        esp_err_t ret = app_dsp_resampler_init(&rs, rate, AUDIO_CODEC_SAMPLE_RATE, channels);
+        if (ret != ESP_OK) {
+            heap_caps_free(pcm);
+            return ret;
+        }
+        size_t done = 0, produced = 0, consumed, n;
+        do {
+            n = app_dsp_resample(&rs, in + done * channels, frames - done, &consumed,
+                                 pcm + produced * channels, out_frames - produced);
+            done += consumed;
+            produced += n;
+        } while (n || consumed);
+        app_dsp_resampler_deinit(&rs);
+        out_frames = produced;
+    }
+    if (channels == 1) {
+        // 从后往前展开为双声道
+        for (size_t i = out_frames; i-- > 0;) {
+            pcm[i * 2 + 1] = pcm[i];
+            pcm[i * 2 + 0] = pcm[i];
+        }
+    }
+    ESP_LOGI(TAG, "converted %" PRIu32 " Hz %d ch to %d Hz stereo", rate, channels, AUDIO_CODEC_SAMPLE_RATE);
+    heap_caps_free(file);
+    prompt->data = (const uint8_t *)pcm;
+    prompt->len = out_frames * 2 * sizeof(int16_t);
+    return ESP_OK;
+}
+
+// 读入一个提示音文件
+static esp_err_t prompt_load(app_prompt_id_t id)
+{
+    esp_err_t ret = ESP_OK;
+    const char *path = prompt_files[id];
+    FILE *fp = NULL;
+    uint8_t *file = NULL;
+    struct stat file_stat;
+
+    ESP_GOTO_ON_FALSE(-1 != stat(path, &file_stat) && file_stat.st_size > 0, ESP_ERR_NOT_FOUND, err, TAG, "stat %s failed", path);
+    file = heap_caps_malloc(file_stat.st_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(file, ESP_ERR_NO_MEM, err, TAG, "no memory for %s", path);
+    fp = fopen(path, "rb");
+    ESP_GOTO_ON_FALSE(fp, ESP_ERR_NOT_FOUND, err, TAG, "open %s failed", path);
+    size_t size = fread(file, 1, file_stat.st_size, fp);
+    fclose(fp);
+    ESP_GOTO_ON_FALSE(size == file_stat.st_size, ESP_FAIL, err, TAG, "read %s failed", path);
+
+    app_prompt_t *prompt = &prompts[id];
+    size_t path_len = strlen(path);
+    if (path_len > 4 && strcasecmp(path + path_len - 4, ".mp3") == 0) {
+        prompt->data = file;
+        prompt->len = size;
+        prompt->is_mp3 = true;
+        return ESP_OK;
+    }
+    ret = prompt_parse_wav(file, size, prompt);
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "parse %s failed", path);
+    return ESP_OK;
+
+err:
+    if (file) {
+        heap_caps_free(file);
+    }
+    memset(&prompts[id], 0, sizeof(app_prompt_t));
+    return ret;
+}
+
+esp_err_t app_prompt_init(void)
+{
+    if (prompt_loaded) {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    size_t total = 0;
+    for (int i = 0; i < APP_PROMPT_MAX; i++) {
+        if (prompt_load(i) == ESP_OK) {
+            total += prompts[i].len;
+        }
+    }
+    ESP_LOGI(TAG, "prompts loaded, %zu bytes in %" PRIi64 " ms", total, (esp_timer_get_time() - start) / 1000);
+    prompt_loaded = true;
+    return ESP_OK;
+}
+
+const app_prompt_t *app_prompt_get(app_prompt_id_t id)
+{
+    if (id >= APP_PROMPT_MAX || prompts[id].data == NULL) {
+        return NULL;
+    }
+    return &prompts[id];
+}
+
+FILE *app_prompt_open(app_prompt_id_t id)
+{
+    const app_prompt_t *prompt = app_prompt_get(id);
+    if (prompt == NULL || !prompt->is_mp3) {
+        return NULL;
+    }
+    return fmemopen((void *)prompt->data, prompt->len, "rb");
+}
+
+esp_err_t app_prompt_play(app_prompt_id_t id)
+{
+    ESP_RETURN_ON_FALSE(prompt_loaded, ESP_ERR_INVALID_STATE, TAG, "prompt not initialized");
+    const app_prompt_t *prompt = app_prompt_get(id);
+    ESP_RETURN_ON_FALSE(prompt, ESP_ERR_NOT_FOUND, TAG, "prompt %d not loaded", id);
+
+    if (prompt->is_mp3) {
+        // MP3 交给播放器解码, 播放器在播放结束后关闭文件
+        FILE *fp = app_prompt_open(id);
+        ESP_RETURN_ON_FALSE(fp, ESP_ERR_NO_MEM, TAG, "open prompt %d failed", id);
+        if (audio_player_play(fp) != ESP_OK) {
+            fclose(fp);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    // PCM 直接从 PSRAM 交给混音器, 新的提示音替换正在播放的
+    return app_mixer_play_buffer(APP_MIXER_SOURCE_PROMPT, prompt->data, prompt->len);
+}
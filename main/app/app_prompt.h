@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_PROMPT_EN_WAKE = 0,     /*!< echo_en_wake.wav */
+    APP_PROMPT_EN_OK,           /*!< echo_en_ok.wav */
+    APP_PROMPT_EN_END,          /*!< echo_en_end.wav */
+    APP_PROMPT_CN_WAKE,         /*!< echo_cn_wake.wav */
+    APP_PROMPT_CN_OK,           /*!< echo_cn_ok.wav */
+    APP_PROMPT_CN_END,          /*!< echo_cn_end.wav */
+    APP_PROMPT_WAIT,            /*!< waitPlease.mp3 */
+    APP_PROMPT_TTS_FAILED,      /*!< tts_failed.mp3 */
+    APP_PROMPT_MAX,
+} app_prompt_id_t;
+
+typedef struct {
+    const uint8_t *data;        /*!< PCM samples of a WAV prompt, whole file of an MP3 prompt */
+    size_t len;
+    bool is_mp3;
+    uint32_t sample_rate;       /*!< WAV prompts only, always AUDIO_CODEC_SAMPLE_RATE */
+    uint16_t bits;              /*!< WAV prompts only */
+} app_prompt_t;
+
+/**
+ * @brief Load all prompts from SPIFFS into PSRAM.
+ *
+ * WAV prompts are kept as stereo PCM at the fixed codec rate, ready for
+ * the mixer, MP3 prompts are kept compressed. Call after SPIFFS is mounted. A
+ * prompt that fails to load is skipped, playing it later returns
+ * ESP_ERR_NOT_FOUND.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_prompt_init(void);
+
+/**
+ * @brief Get a preloaded prompt.
+ *
+ * @param id: Prompt id
+ *
+ * @return prompt, NULL if it is not loaded
+ */
+const app_prompt_t *app_prompt_get(app_prompt_id_t id);
+
+/**
+ * @brief Play a prompt without waiting for it to finish.
+ *
+ * WAV prompts are mixed over a reply in progress, which is ducked while
+ * they play, and a new prompt cuts off the one still playing. MP3 prompts
+ * are handed to the audio player.
+ *
+ * @param id: Prompt id
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Not initialized or mixer not started
+ *    - ESP_ERR_NOT_FOUND: Prompt not loaded
+ *    - ESP_FAIL: Player busy
+ */
+esp_err_t app_prompt_play(app_prompt_id_t id);
+
+/**
+ * @brief Open an MP3 prompt as a read-only FILE, e.g. to queue it behind other MP3 data.
+ *
+ * @param id: Prompt id
+ *
+ * @return FILE to fclose after use, NULL if the prompt is not a loaded MP3
+ */
+FILE *app_prompt_open(app_prompt_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
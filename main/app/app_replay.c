@@ -0,0 +1,189 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_audio.h"
+#include "app_replay.h"
+
+static const char *TAG = "app_replay";
+
+typedef struct {
+    uint32_t index;
+    uint32_t wake_frame;
+    uint32_t wake_ms;           /*!< Position in the file when the wake word was reported */
+    uint32_t end_frame;
+    uint32_t end_ms;
+    uint32_t recorded;
+    uint32_t uploaded;
+    bool open;                  /*!< Woken, not reported yet */
+} replay_turn_t;
+
+static FILE *replay_fp = NULL;
+static uint16_t replay_channels = 0;
+static uint32_t replay_data_left = 0;   /*!< Bytes of the data chunk not read yet */
+static uint64_t replay_samples = 0;     /*!< Frames handed out, silence included */
+static int64_t replay_start_us = 0;
+static replay_turn_t replay_turn = {0};
+static portMUX_TYPE replay_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t replay_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t replay_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+// 按块查找 fmt 和 data, 文件停在 data 块的开头
+static esp_err_t replay_parse_header(FILE *fp)
+{
+    uint8_t head[16];
+    ESP_RETURN_ON_FALSE(fread(head, 1, 12, fp) == 12 && memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "WAVE", 4) == 0,
+                        ESP_ERR_NOT_SUPPORTED, TAG, "not a wav file");
+    uint16_t format = 0, bits = 0;
+    uint32_t rate = 0;
+    while (fread(head, 1, 8, fp) == 8) {
+        uint32_t chunk_size = replay_le32(head + 4);
+        if (memcmp(head, "data", 4) == 0) {
+            ESP_RETURN_ON_FALSE(format == 1 && bits == 16 && rate == AUDIO_CODEC_SAMPLE_RATE
+                                && (replay_channels == 1 || replay_channels == 2),
+                                ESP_ERR_NOT_SUPPORTED, TAG, "unsupported wav, format=%d ch=%d rate=%" PRIu32 " bits=%d",
+                                format, replay_channels, rate, bits);
+            replay_data_left = chunk_size;
+            return ESP_OK;
+        }
+        if (memcmp(head, "fmt ", 4) == 0 && chunk_size >= 16) {
+            ESP_RETURN_ON_FALSE(fread(head, 1, 16, fp) == 16, ESP_ERR_INVALID_SIZE, TAG, "short fmt chunk");
+            format = replay_le16(head);
+            replay_channels = replay_le16(head + 2);
+            rate = replay_le32(head + 4);
+            bits = replay_le16(head + 14);
+            chunk_size -= 16;
+        }
+        fseek(fp, chunk_size + (chunk_size & 1), SEEK_CUR);
+    }
+    ESP_LOGE(TAG, "no data chunk");
+    return ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t app_replay_open(const char *path)
+{
+    ESP_RETURN_ON_FALSE(NULL == replay_fp, ESP_ERR_INVALID_STATE, TAG, "replay already open");
+    FILE *fp = fopen(path, "rb");
+    ESP_RETURN_ON_FALSE(fp, ESP_ERR_NOT_FOUND, TAG, "open %s failed", path);
+    esp_err_t ret = replay_parse_header(fp);
+    if (ESP_OK != ret) {
+        fclose(fp);
+        return ret;
+    }
+    replay_samples = 0;
+    replay_start_us = esp_timer_get_time();
+    memset(&replay_turn, 0, sizeof(replay_turn));
+    replay_fp = fp;
+    ESP_LOGI(TAG, "replay %s, %d ch, %" PRIu32 " ms", path, replay_channels,
+             (uint32_t)((uint64_t)replay_data_left * 1000 / (replay_channels * sizeof(int16_t) * AUDIO_CODEC_SAMPLE_RATE)));
+    return ESP_OK;
+}
+
+bool app_replay_active(void)
+{
+    return NULL != replay_fp;
+}
+
+esp_err_t app_replay_read(int16_t *buf, size_t frames)
+{
+    ESP_RETURN_ON_FALSE(replay_fp, ESP_ERR_INVALID_STATE, TAG, "no replay file");
+
+    size_t got = 0;
+    if (replay_data_left) {
+        size_t want = MIN(frames * replay_channels * sizeof(int16_t), replay_data_left);
+        got = fread(buf, 1, want, replay_fp) / (replay_channels * sizeof(int16_t));
+        replay_data_left = (got == 0) ? 0 : replay_data_left - got * replay_channels * sizeof(int16_t);
+        if (0 == replay_data_left) {
+            ESP_LOGI(TAG, "end of file after %" PRIu64 " ms, %" PRIu32 " turns, silence follows",
+                     (replay_samples + got) * 1000 / AUDIO_CODEC_SAMPLE_RATE, replay_turn.index);
+        }
+    }
+    if (replay_channels == 1) {
+        // 从后往前展开为双声道
+        for (size_t i = got; i-- > 0;) {
+            buf[i * 2 + 1] = buf[i];
+            buf[i * 2 + 0] = buf[i];
+        }
+    }
+    memset(buf + got * 2, 0, (frames - got) * 2 * sizeof(int16_t));
+    replay_samples += frames;
+
+    // 按采样率节拍送出, 与从 I2S 读取的时序一致
+    int64_t due_us = replay_start_us + (int64_t)(replay_samples * 1000000 / AUDIO_CODEC_SAMPLE_RATE);
+    int64_t wait_us = due_us - esp_timer_get_time();
+    if (wait_us > 0) {
+        vTaskDelay(MAX(1, pdMS_TO_TICKS(wait_us / 1000)));
+    }
+    return ESP_OK;
+}
+
+static void replay_report(const replay_turn_t *turn)
+{
+    ESP_LOGI(TAG, "turn %" PRIu32 ": wake frame %" PRIu32 " (%" PRIu32 " ms), end frame %" PRIu32 " (%" PRIu32 " ms), "
+             "recorded %" PRIu32 " B, uploaded %" PRIu32 " B",
+             turn->index, turn->wake_frame, turn->wake_ms, turn->end_frame, turn->end_ms, turn->recorded, turn->uploaded);
+}
+
+void app_replay_mark(app_replay_event_t event, uint32_t value)
+{
+    if (NULL == replay_fp) {
+        return;
+    }
+    replay_turn_t done = {0};
+    uint32_t pos_ms = replay_samples * 1000 / AUDIO_CODEC_SAMPLE_RATE;
+
+    portENTER_CRITICAL(&replay_lock);
+    replay_turn_t *turn = &replay_turn;
+    switch (event) {
+    case APP_REPLAY_WAKE:
+        // 上一轮没有上传时 (本地命令或无网络) 在这里输出
+        if (turn->open) {
+            done = *turn;
+        }
+        uint32_t index = turn->index + 1;
+        memset(turn, 0, sizeof(replay_turn_t));
+        turn->index = index;
+        turn->wake_frame = value;
+        turn->wake_ms = pos_ms;
+        turn->open = true;
+        break;
+    case APP_REPLAY_END:
+        turn->end_frame = value;
+        turn->end_ms = pos_ms;
+        break;
+    case APP_REPLAY_RECORDED:
+        turn->recorded = value;
+        break;
+    case APP_REPLAY_UPLOADED:
+        turn->uploaded = value;
+        if (turn->open) {
+            done = *turn;
+            turn->open = false;
+        }
+        break;
+    }
+    portEXIT_CRITICAL(&replay_lock);
+
+    if (done.open) {
+        replay_report(&done);
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_REPLAY_WAKE = 0,    /*!< Wake word, value is the AFE fetch frame */
+    APP_REPLAY_END,         /*!< End of speech or local command, value is the AFE fetch frame */
+    APP_REPLAY_RECORDED,    /*!< Recording stopped, value is the file size in bytes */
+    APP_REPLAY_UPLOADED,    /*!< Upload finished, value is the body size in bytes */
+} app_replay_event_t;
+
+/**
+ * @brief Open a WAV file to feed the SR path instead of the microphones.
+ *
+ * The file must be 16-bit PCM at AUDIO_CODEC_SAMPLE_RATE, mono or stereo.
+ * It is read in real time, then silence follows so the last turn can end.
+ *
+ * @param path: WAV file path
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_FOUND: File cannot be opened
+ *    - ESP_ERR_NOT_SUPPORTED: Unsupported WAV format
+ */
+esp_err_t app_replay_open(const char *path);
+
+/**
+ * @brief Check whether a replay file is open.
+ */
+bool app_replay_active(void);
+
+/**
+ * @brief Read the next frames in the layout of bsp_i2s_read, blocking until they are due.
+ *
+ * @param buf: Output, `frames` interleaved stereo samples
+ * @param frames: Number of frames
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: No replay file open
+ */
+esp_err_t app_replay_read(int16_t *buf, size_t frames);
+
+/**
+ * @brief Record a point of the current turn, one line is logged per turn.
+ *
+ * Does nothing when no replay file is open.
+ *
+ * @param event: What happened
+ * @param value: Frame index or byte count, see app_replay_event_t
+ */
+void app_replay_mark(app_replay_event_t event, uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/param.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_spsc.h"
+
+static const char *TAG = "app_spsc";
+
+// 读写位置为自由计数, 只有写端修改 head, 只有读端修改 tail
+struct app_spsc {
+    uint8_t *buf;
+    uint32_t mask;              /*!< capacity - 1 */
+    atomic_uint_fast32_t head;  /*!< Bytes written, release by the writer */
+    atomic_uint_fast32_t tail;  /*!< Bytes consumed, release by the reader */
+    app_spsc_stats_t stats;     /*!< Updated by the writer only */
+};
+
+app_spsc_handle_t app_spsc_create(size_t capacity, uint32_t caps)
+{
+    ESP_RETURN_ON_FALSE(capacity && (capacity & (capacity - 1)) == 0, NULL, TAG, "capacity %zu is not a power of two", capacity);
+
+    app_spsc_handle_t ring = heap_caps_calloc(1, sizeof(struct app_spsc), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(ring, NULL, TAG, "no memory for ring");
+    ring->buf = heap_caps_malloc(capacity, caps);
+    if (ring->buf == NULL) {
+        ESP_LOGE(TAG, "no memory for %zu bytes ring buffer", capacity);
+        heap_caps_free(ring);
+        return NULL;
+    }
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ring;
+}
+
+void app_spsc_delete(app_spsc_handle_t ring)
+{
+    if (ring) {
+        heap_caps_free(ring->buf);
+        heap_caps_free(ring);
+    }
+}
+
+bool app_spsc_write_reserve(app_spsc_handle_t ring, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (len > ring->mask + 1 - used) {
+        ring->stats.overruns++;
+        ring->stats.dropped += len;
+        return false;
+    }
+    ring->stats.writes++;
+    ring->stats.high_water = MAX(ring->stats.high_water, used + len);
+    return true;
+}
+
+size_t app_spsc_write_acquire(app_spsc_handle_t ring, uint8_t **ptr)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t pos = head & ring->mask;
+    *ptr = ring->buf + pos;
+    return MIN(ring->mask + 1 - used, ring->mask + 1 - pos);
+}
+
+void app_spsc_write_commit(app_spsc_handle_t ring, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+bool app_spsc_write(app_spsc_handle_t ring, const void *data, size_t len)
+{
+    if (!app_spsc_write_reserve(ring, len)) {
+        return false;
+    }
+    const uint8_t *src = data;
+    while (len) {
+        uint8_t *ptr;
+        size_t n = MIN(len, app_spsc_write_acquire(ring, &ptr));
+        memcpy(ptr, src, n);
+        app_spsc_write_commit(ring, n);
+        src += n;
+        len -= n;
+    }
+    return true;
+}
+
+uint32_t app_spsc_write_pos(app_spsc_handle_t ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+size_t app_spsc_read_acquire(app_spsc_handle_t ring, const uint8_t **ptr)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t used = atomic_load_explicit(&ring->head, memory_order_acquire) - tail;
+    uint32_t pos = tail & ring->mask;
+    *ptr = ring->buf + pos;
+    return MIN(used, ring->mask + 1 - pos);
+}
+
+void app_spsc_read_commit(app_spsc_handle_t ring, size_t len)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+size_t app_spsc_used(app_spsc_handle_t ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return (uint32_t)(atomic_load_explicit(&ring->head, memory_order_acquire) - tail);
+}
+
+void app_spsc_get_stats(app_spsc_handle_t ring, app_spsc_stats_t *stats)
+{
+    *stats = ring->stats;
+}
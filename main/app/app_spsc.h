@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Lock-free single-producer/single-consumer byte ring.
+ *
+ * One task writes and one task reads, on any core, without locks or blocking
+ * calls. Writers reserve a whole record first: if it does not fit, the record
+ * is dropped and counted as an overrun instead of waiting for the reader.
+ */
+typedef struct app_spsc *app_spsc_handle_t;
+
+typedef struct {
+    uint32_t writes;        /*!< Records accepted */
+    uint32_t overruns;      /*!< Records dropped because the ring was full */
+    uint32_t dropped;       /*!< Bytes dropped by overruns */
+    uint32_t high_water;    /*!< Highest fill level seen by the writer, in bytes */
+} app_spsc_stats_t;
+
+/**
+ * @brief Create a ring.
+ *
+ * @param capacity: Size in bytes, must be a power of two
+ * @param caps: heap_caps flags of the buffer, MALLOC_CAP_INTERNAL keeps it out of PSRAM
+ *
+ * @return ring handle, NULL on failure
+ */
+app_spsc_handle_t app_spsc_create(size_t capacity, uint32_t caps);
+
+/**
+ * @brief Delete a ring, neither side may use it any more.
+ *
+ * @param ring: Ring handle
+ */
+void app_spsc_delete(app_spsc_handle_t ring);
+
+/**
+ * @brief Writer side: check that a record of `len` bytes fits, count an overrun if not.
+ *
+ * @param ring: Ring handle
+ * @param len: Size of the record about to be written
+ *
+ * @return true if the record fits, write it with app_spsc_write_acquire/commit
+ */
+bool app_spsc_write_reserve(app_spsc_handle_t ring, size_t len);
+
+/**
+ * @brief Writer side: get the contiguous free region at the write position.
+ *
+ * @param ring: Ring handle
+ * @param ptr: Output, start of the region
+ *
+ * @return size of the region, it ends at the read position or the end of the buffer
+ */
+size_t app_spsc_write_acquire(app_spsc_handle_t ring, uint8_t **ptr);
+
+/**
+ * @brief Writer side: publish `len` bytes written into the acquired region.
+ *
+ * @param ring: Ring handle
+ * @param len: Number of bytes written
+ */
+void app_spsc_write_commit(app_spsc_handle_t ring, size_t len);
+
+/**
+ * @brief Writer side: copy a whole record into the ring, or drop it if it does not fit.
+ *
+ * @param ring: Ring handle
+ * @param data: Record
+ * @param len: Size of the record
+ *
+ * @return true if written, false if dropped as an overrun
+ */
+bool app_spsc_write(app_spsc_handle_t ring, const void *data, size_t len);
+
+/**
+ * @brief Get the write position, the total of bytes committed so far; callable from any task.
+ *
+ * Free-running and wraps at 2^32, compare positions by unsigned difference.
+ *
+ * @param ring: Ring handle
+ *
+ * @return write position
+ */
+uint32_t app_spsc_write_pos(app_spsc_handle_t ring);
+
+/**
+ * @brief Reader side: get the contiguous filled region at the read position.
+ *
+ * @param ring: Ring handle
+ * @param ptr: Output, start of the region
+ *
+ * @return size of the region, 0 if the ring is empty
+ */
+size_t app_spsc_read_acquire(app_spsc_handle_t ring, const uint8_t **ptr);
+
+/**
+ * @brief Reader side: release `len` bytes consumed from the acquired region.
+ *
+ * @param ring: Ring handle
+ * @param len: Number of bytes consumed
+ */
+void app_spsc_read_commit(app_spsc_handle_t ring, size_t len);
+
+/**
+ * @brief Get the number of bytes written and not yet consumed, callable from either side.
+ *
+ * @param ring: Ring handle
+ *
+ * @return fill level in bytes
+ */
+size_t app_spsc_used(app_spsc_handle_t ring);
+
+/**
+ * @brief Get the writer counters.
+ *
+ * @param ring: Ring handle
+ * @param stats: Output
+ */
+void app_spsc_get_stats(app_spsc_handle_t ring, app_spsc_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -28,19 +29,54 @@
 #include "bsp_board.h"
 #include "app_audio.h"
 #include "app_wifi.h"
+#include "app_dsp.h"
+#include "app_listen.h"
+#include "app_replay.h"
+#include "app_event.h"
+#include "app_telemetry.h"
 
 static const char *TAG = "app_sr";
 
 static esp_afe_sr_iface_t *afe_handle = NULL;
 static srmodel_list_t *models = NULL;
-static bool manul_detect_flag = false;
+static app_event_sub_handle_t manual_wake_sub = NULL;   /*!< Manual wake requests, read by the detect task */
 
 sr_data_t *g_sr_data = NULL;
 
 #define I2S_CHANNEL_NUM      2
 
-extern bool record_flag;
-extern uint32_t record_total_len;
+#define SR_MN_DURATION_MS    (3000)  /*!< Listen for a command this long after the wake word */
+
+typedef struct {
+    sr_cmd_t cmd;
+    sr_language_t lang;
+    const char *str;
+    const char *phoneme;    /*!< MultiNet5 English only, see tool/multinet_g2p.py in esp-sr */
+} sr_cmd_info_t;
+
+// 本地命令表, 同一命令可有多种说法; 命中时不再上传录音
+static const sr_cmd_info_t sr_cmd_info[] = {
+    {SR_CMD_STOP,    SR_LANG_EN, "stop",            "STnP"},
+    {SR_CMD_STOP,    SR_LANG_EN, "stop playing",    "STnP PLdgl"},
+    {SR_CMD_STOP,    SR_LANG_EN, "cancel",          "KaNScL"},
+    {SR_CMD_LOUDER,  SR_LANG_EN, "louder",          "LtDk"},
+    {SR_CMD_QUIETER, SR_LANG_EN, "quieter",         "KWicTk"},
+    {SR_CMD_REPEAT,  SR_LANG_EN, "repeat that",     "RgPmT jaT"},
+    {SR_CMD_REPEAT,  SR_LANG_EN, "say that again",  "Sd jaT cGfN"},
+    {SR_CMD_STOP,    SR_LANG_CN, "ting zhi",        NULL},
+    {SR_CMD_LOUDER,  SR_LANG_CN, "da sheng dian",   NULL},
+    {SR_CMD_QUIETER, SR_LANG_CN, "xiao sheng dian", NULL},
+    {SR_CMD_REPEAT,  SR_LANG_CN, "zai shuo yi bian", NULL},
+};
+
+static const app_endpoint_config_t endpoint_config = {
+    .sample_rate = AUDIO_CODEC_SAMPLE_RATE,
+    .min_ms = CONFIG_SR_ENDPOINT_MIN_MS,
+    .max_ms = CONFIG_SR_ENDPOINT_MAX_MS,
+    .length_percent = CONFIG_SR_ENDPOINT_LENGTH_PERCENT,
+    .low_snr_db = CONFIG_SR_ENDPOINT_LOW_SNR_DB,
+    .no_speech_ms = CONFIG_SR_ENDPOINT_NO_SPEECH_MS,
+};
 
 // 音频馈送任务
 static void audio_feed_task(void *arg)
@@ -56,23 +92,37 @@ static void audio_feed_task(void *arg)
     int16_t *audio_buffer = heap_caps_malloc(audio_chunksize * sizeof(int16_t) * feed_channel, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
     assert(audio_buffer);
     g_sr_data->afe_in_buffer = audio_buffer;
+#if CONFIG_SR_AEC
+    // 播放参考通道, 与采集的帧对齐后作为第三通道送入 AFE
+    int16_t *ref_buffer = heap_caps_malloc(audio_chunksize * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    assert(ref_buffer);
+#else
+    int16_t *ref_buffer = NULL;
+#endif
 
     while (true) {
         if (g_sr_data->event_group && xEventGroupGetBits(g_sr_data->event_group)) {
+            if (ref_buffer) {
+                heap_caps_free(ref_buffer);
+            }
             xEventGroupSetBits(g_sr_data->event_group, FEED_DELETED);
             vTaskDelete(NULL);
         }
 
-        // 从I2S总线读取音频数据
-        bsp_i2s_read((char *)audio_buffer, audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), &bytes_read, portMAX_DELAY);
-
-        // 通道调整
-        for (int  i = audio_chunksize - 1; i >= 0; i--) {
-            audio_buffer[i * 3 + 2] = 0;
-            audio_buffer[i * 3 + 1] = audio_buffer[i * 2 + 1];
-            audio_buffer[i * 3 + 0] = audio_buffer[i * 2 + 0];
+        if (app_replay_active()) {
+            // 回放 WAV 文件代替麦克风, 离线调整说话结束判定和录音
+            app_replay_read(audio_buffer, audio_chunksize);
+        } else {
+            // 从I2S总线读取音频数据
+            bsp_i2s_read((char *)audio_buffer, audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), &bytes_read, portMAX_DELAY);
         }
 
+        // 通道调整: 双声道原地展开为 AFE 的 3 通道格式, 第三通道为播放参考, 未开启 AEC 时填零
+#if CONFIG_SR_AEC
+        audio_playback_ref_read(ref_buffer, audio_chunksize);
+#endif
+        app_dsp_interleave_2to3(audio_buffer, ref_buffer, audio_buffer, audio_chunksize);
+
         // 检查WIFI是否已连接
         if (WIFI_STATUS_CONNECTED_OK == wifi_connected_already()) {
 
@@ -87,10 +137,12 @@ static void audio_feed_task(void *arg)
 static void audio_detect_task(void *arg)
 {
     ESP_LOGI(TAG, "Detection task");
-    static afe_vad_state_t local_state;
-    static uint8_t frame_keep = 0;
+    static app_listen_t listen;
+    app_listen_init(&listen, &endpoint_config);
+    uint32_t fetch_frames = 0;
 
-    bool detect_flag = false;
+    bool manual_wake = false;
+    app_event_t event;
     esp_afe_sr_data_t *afe_data = arg;
 
     while (true) {
@@ -104,18 +156,25 @@ static void audio_detect_task(void *arg)
             ESP_LOGW(TAG, "AFE Fetch Fail");
             continue;
         }
+        fetch_frames++;
+        while (app_event_receive(manual_wake_sub, &event)) {
+            manual_wake = true;
+        }
         if (res->wakeup_state == WAKENET_DETECTED) {
             ESP_LOGI(TAG, LOG_BOLD(LOG_COLOR_GREEN) "wakeword detected");
+            app_replay_mark(APP_REPLAY_WAKE, fetch_frames);
+            app_event_publish(APP_EVENT_WAKE, 1);
             sr_result_t result = {
                 .wakenet_mode = WAKENET_DETECTED,
                 .state = ESP_MN_STATE_DETECTING,
                 .command_id = 0,
             };
             xQueueSend(g_sr_data->result_que, &result, 0);
-        } else if (res->wakeup_state == WAKENET_CHANNEL_VERIFIED || manul_detect_flag) {
-            detect_flag = true;
-            if (manul_detect_flag) {
-                manul_detect_flag = false;
+        } else if (res->wakeup_state == WAKENET_CHANNEL_VERIFIED || manual_wake) {
+            if (manual_wake) {
+                manual_wake = false;
+                app_replay_mark(APP_REPLAY_WAKE, fetch_frames);
+                app_event_publish(APP_EVENT_WAKE, 0);
                 sr_result_t result = {
                     .wakenet_mode = WAKENET_DETECTED,
                     .state = ESP_MN_STATE_DETECTING,
@@ -123,37 +182,116 @@ static void audio_detect_task(void *arg)
                 };
                 xQueueSend(g_sr_data->result_que, &result, 0);
             }
-            frame_keep = 0;
+            if (g_sr_data->model_data) {
+                g_sr_data->multinet->clean(g_sr_data->model_data);
+            }
+            app_listen_start(&listen, NULL != g_sr_data->model_data);
             g_sr_data->afe_handle->disable_wakenet(afe_data);
             ESP_LOGI(TAG, LOG_BOLD(LOG_COLOR_GREEN) "AFE_FETCH_CHANNEL_VERIFIED, channel index: %d\n", res->trigger_channel_id);
         }
 
-        if (true == detect_flag) {
+        // 录音按帧记录 VAD 结果, 上传前裁掉首尾静音
+        audio_record_vad_update(res->data_size / sizeof(int16_t), AFE_VAD_SPEECH == res->vad_state);
 
-            if (local_state != res->vad_state) {
-                local_state = res->vad_state;
-                frame_keep = 0;
-            } else {
-                frame_keep++;
+        if (!listen.active) {
+            continue;
+        }
+        app_listen_mn_t mn = APP_LISTEN_MN_NONE;
+        esp_mn_results_t *mn_result = NULL;
+        if (listen.command_window) {
+            esp_mn_state_t mn_state = g_sr_data->multinet->detect(g_sr_data->model_data, res->data);
+            if (ESP_MN_STATE_DETECTED == mn_state) {
+                mn_result = g_sr_data->multinet->get_results(g_sr_data->model_data);
+                mn = APP_LISTEN_MN_DETECTED;
+            } else if (ESP_MN_STATE_TIMEOUT == mn_state) {
+                mn = APP_LISTEN_MN_TIMEOUT;
             }
+        }
 
-            if ((100 == frame_keep) && (AFE_VAD_SILENCE == res->vad_state)) {
-                sr_result_t result = {
-                    .wakenet_mode = WAKENET_NO_DETECT,
-                    .state = ESP_MN_STATE_TIMEOUT,
-                    .command_id = 0,
-                };
-                xQueueSend(g_sr_data->result_que, &result, 0);
-                g_sr_data->afe_handle->enable_wakenet(afe_data);
-                detect_flag = false;
-                continue;
-            }
+        app_endpoint_t *endpoint = &listen.endpoint;
+        app_listen_result_t listen_ret = app_listen_update(&listen, mn, AFE_VAD_SPEECH == res->vad_state,
+                                                           res->data, res->data_size / sizeof(int16_t));
+        if (APP_LISTEN_CONTINUE == listen_ret) {
+            continue;
+        }
+        sr_result_t result = {
+            .wakenet_mode = WAKENET_NO_DETECT,
+            .state = ESP_MN_STATE_TIMEOUT,
+            .command_id = 0,
+        };
+        if (APP_LISTEN_COMMAND == listen_ret) {
+            ESP_LOGI(TAG, "local command %d (%s), prob %.2f at frame %" PRIu32, mn_result->command_id[0],
+                     mn_result->string, mn_result->prob[0], endpoint->frames);
+            result.state = ESP_MN_STATE_DETECTED;
+            result.command_id = mn_result->command_id[0];
+        } else {
+            ESP_LOGI(TAG, "endpoint %s at frame %" PRIu32 ", speech %" PRIu32 " ms, silence %" PRIu32 "/%" PRIu32 " ms, snr %d dB%s",
+                     (APP_LISTEN_NO_SPEECH == listen_ret) ? "no speech" : "end of speech", endpoint->frames,
+                     endpoint->speech_ms, endpoint->silence_ms, endpoint->hangover_ms,
+                     endpoint->noise_valid ? (int)(endpoint->speech_db - endpoint->noise_db) : 0,
+                     listen.end_deferred ? ", held for the command window" : "");
         }
+        app_replay_mark(APP_REPLAY_END, fetch_frames);
+        xQueueSend(g_sr_data->result_que, &result, 0);
+        g_sr_data->afe_handle->enable_wakenet(afe_data);
     }
     /* Task never returns */
     vTaskDelete(NULL);
 }
 
+#if CONFIG_SR_LOCAL_COMMANDS
+// 加载当前语言的 MultiNet 模型和命令表, 没有对应模型时所有语音都交给云端
+static void app_sr_load_commands(void)
+{
+    char *mn_name = esp_srmodel_filter(models, ESP_MN_PREFIX, (SR_LANG_EN == g_sr_data->lang) ? ESP_MN_ENGLISH : ESP_MN_CHINESE);
+    if (NULL == mn_name) {
+        ESP_LOGW(TAG, "no multinet model for %s, local commands disabled", SR_LANG_EN == g_sr_data->lang ? "EN" : "CN");
+        return;
+    }
+    esp_mn_iface_t *multinet = esp_mn_handle_from_name(mn_name);
+    model_iface_data_t *model_data = multinet->create(mn_name, SR_MN_DURATION_MS);
+    if (NULL == model_data) {
+        ESP_LOGE(TAG, "create multinet %s failed", mn_name);
+        return;
+    }
+    int mn_chunksize = multinet->get_samp_chunksize(model_data);
+    int afe_chunksize = g_sr_data->afe_handle->get_fetch_chunksize(g_sr_data->afe_data);
+    if (mn_chunksize != afe_chunksize) {
+        ESP_LOGE(TAG, "multinet chunk %d != afe chunk %d, local commands disabled", mn_chunksize, afe_chunksize);
+        multinet->destroy(model_data);
+        return;
+    }
+
+    // MultiNet5 英文模型只接受音素, 其他模型直接使用文本
+    bool use_phoneme = (SR_LANG_EN == g_sr_data->lang) && (NULL != strstr(mn_name, "mn5"));
+    esp_mn_commands_alloc(multinet, model_data);
+    esp_mn_commands_clear();
+    g_sr_data->cmd_num = 0;
+    for (int i = 0; i < sizeof(sr_cmd_info) / sizeof(sr_cmd_info[0]); i++) {
+        const sr_cmd_info_t *info = &sr_cmd_info[i];
+        if (info->lang != g_sr_data->lang) {
+            continue;
+        }
+        const char *phrase = use_phoneme ? info->phoneme : info->str;
+        if (phrase && ESP_OK == esp_mn_commands_add(info->cmd, (char *)phrase)) {
+            g_sr_data->cmd_num++;
+        } else {
+            ESP_LOGW(TAG, "skip command \"%s\"", info->str);
+        }
+    }
+    esp_mn_error_t *err_id = esp_mn_commands_update();
+    if (err_id) {
+        for (int i = 0; i < err_id->num; i++) {
+            ESP_LOGE(TAG, "invalid command: %d %s", err_id->phrases[i]->command_id, err_id->phrases[i]->string);
+        }
+    }
+
+    g_sr_data->multinet = multinet;
+    g_sr_data->model_data = model_data;
+    ESP_LOGI(TAG, "load multinet:%s, %d commands", mn_name, g_sr_data->cmd_num);
+}
+#endif
+
 // 设置语言
 esp_err_t app_sr_set_language(sr_language_t new_lang)
 {
@@ -168,10 +306,15 @@ esp_err_t app_sr_set_language(sr_language_t new_lang)
     ESP_LOGI(TAG, "Set language %s", SR_LANG_EN == g_sr_data->lang ? "EN" : "CN");
     if (g_sr_data->model_data) {
         g_sr_data->multinet->destroy(g_sr_data->model_data);
+        g_sr_data->model_data = NULL;
     }
     char *wn_name = esp_srmodel_filter(models, ESP_WN_PREFIX, "");
     ESP_LOGI(TAG, "load wakenet:%s", wn_name);
     g_sr_data->afe_handle->set_wakenet(g_sr_data->afe_data, wn_name);
+
+#if CONFIG_SR_LOCAL_COMMANDS
+    app_sr_load_commands();
+#endif
     return ESP_OK;
 }
 
@@ -190,13 +333,23 @@ esp_err_t app_sr_start(bool record_en)
     g_sr_data->event_group = xEventGroupCreate();
     ESP_GOTO_ON_FALSE(NULL != g_sr_data->event_group, ESP_ERR_NO_MEM, err, TAG, "Failed create event_group");
 
+    if (manual_wake_sub == NULL) {
+        manual_wake_sub = app_event_subscribe(APP_EVENT_BIT(APP_EVENT_MANUAL_WAKE), 4);
+        ESP_GOTO_ON_FALSE(NULL != manual_wake_sub, ESP_ERR_NO_MEM, err, TAG, "Failed subscribe manual wake");
+    }
+
     BaseType_t ret_val;
     models = esp_srmodel_init("model");
     afe_handle = (esp_afe_sr_iface_t *)&ESP_AFE_SR_HANDLE;
     afe_config_t afe_config = AFE_CONFIG_DEFAULT();
 
     afe_config.wakenet_model_name = esp_srmodel_filter(models, ESP_WN_PREFIX, NULL);
+#if CONFIG_SR_AEC
+    // 播放时也能唤醒打断: 第三通道为播放参考
+    afe_config.aec_init = true;
+#else
     afe_config.aec_init = false;
+#endif
 
     esp_afe_sr_data_t *afe_data = afe_handle->create_from_config(&afe_config);
     g_sr_data->afe_handle = afe_handle;
@@ -206,6 +359,11 @@ esp_err_t app_sr_start(bool record_en)
     ret = app_sr_set_language(SR_LANG_EN);
     ESP_GOTO_ON_FALSE(ESP_OK == ret, ESP_FAIL, err, TAG,  "Failed to set language");
 
+#if CONFIG_SR_REPLAY
+    // 打开失败时仍使用麦克风
+    ESP_ERROR_CHECK_WITHOUT_ABORT(app_replay_open(CONFIG_SR_REPLAY_FILE));
+#endif
+
     ret_val = xTaskCreatePinnedToCore(&audio_feed_task, "Feed Task", 8 * 1024, (void *)afe_data, 5, &g_sr_data->feed_task, 0);
     ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG,  "Failed create audio feed task");
 
@@ -214,6 +372,9 @@ esp_err_t app_sr_start(bool record_en)
 
     ret_val = xTaskCreatePinnedToCore(&sr_handler_task, "SR Handler Task", 10 * 1024, NULL, 5, &g_sr_data->handle_task, 0);
     ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG,  "Failed create audio handler task");
+    app_telemetry_add_task("Feed Task", g_sr_data->feed_task);
+    app_telemetry_add_task("Detect Task", g_sr_data->detect_task);
+    app_telemetry_add_task("SR Handler Task", g_sr_data->handle_task);
 
     audio_record_init();
 
@@ -278,6 +439,6 @@ esp_err_t app_sr_get_result(sr_result_t *result, TickType_t xTicksToWait)
 esp_err_t app_sr_start_once(void)
 {
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, ESP_ERR_INVALID_STATE, TAG, "SR is not running");
-    manul_detect_flag = true;
+    app_event_publish(APP_EVENT_MANUAL_WAKE, 0);
     return ESP_OK;
 }
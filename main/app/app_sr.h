@@ -46,6 +46,17 @@ typedef enum {
     SR_LANG_MAX,
 } sr_language_t;
 
+/**
+ * @brief Commands handled on the device, reported as sr_result_t::command_id.
+ */
+typedef enum {
+    SR_CMD_STOP = 0,    /*!< Stop the reply */
+    SR_CMD_LOUDER,      /*!< Volume up */
+    SR_CMD_QUIETER,     /*!< Volume down */
+    SR_CMD_REPEAT,      /*!< Play the last reply again */
+    SR_CMD_MAX,
+} sr_cmd_t;
+
 
 typedef struct {
     sr_language_t lang;
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "app_sse.h"
+
+static const char *TAG = "app_sse";
+
+struct app_sse_parser {
+    app_sse_event_cb_t cb;
+    void *user_ctx;
+    app_sse_dispatch_t dispatch;
+    size_t max_size;
+    char *line;         /*!< Current, not yet terminated line */
+    size_t line_len;
+    bool line_overflow; /*!< Line is too long, skip until the next '\n' */
+    char *event;        /*!< Joined `data:` payload of the current event */
+    size_t event_len;
+    bool event_has_data;
+    bool event_overflow;
+};
+
+// 派发当前事件
+static void sse_dispatch(app_sse_parser_handle_t parser)
+{
+    if (parser->event_has_data && !parser->event_overflow) {
+        parser->event[parser->event_len] = '\0';
+        parser->cb(parser->event, parser->event_len, parser->user_ctx);
+    } else if (parser->event_overflow) {
+        ESP_LOGW(TAG, "event larger than %zu bytes dropped", parser->max_size);
+    }
+    parser->event_len = 0;
+    parser->event_has_data = false;
+    parser->event_overflow = false;
+}
+
+// 处理一行完整的数据
+static void sse_process_line(app_sse_parser_handle_t parser)
+{
+    char *line = parser->line;
+    size_t len = parser->line_len;
+
+    if (len > 0 && line[len - 1] == '\r') {
+        len--;
+    }
+
+    // 空行表示一个事件结束
+    if (len == 0) {
+        sse_dispatch(parser);
+        return;
+    }
+
+    // ':' 开头为注释行, 只关心 data 字段
+    if (len < 5 || memcmp(line, "data:", 5) != 0) {
+        return;
+    }
+    line += 5;
+    len -= 5;
+    if (len > 0 && line[0] == ' ') {
+        line++;
+        len--;
+    }
+
+    size_t need = len + (parser->event_has_data ? 1 : 0);
+    if (parser->event_len + need >= parser->max_size) {
+        parser->event_overflow = true;
+        parser->event_has_data = true;
+        return;
+    }
+    if (parser->event_has_data) {
+        parser->event[parser->event_len++] = '\n';
+    }
+    memcpy(parser->event + parser->event_len, line, len);
+    parser->event_len += len;
+    parser->event_has_data = true;
+
+    // 服务器连续发送多行 data: 而不空行分隔时, 每行立即派发, 不等到流结束
+    if (parser->dispatch == APP_SSE_DISPATCH_LINE) {
+        sse_dispatch(parser);
+    }
+}
+
+// 追加数据到当前行
+static void sse_line_append(app_sse_parser_handle_t parser, const char *data, size_t len)
+{
+    if (parser->line_overflow) {
+        return;
+    }
+    if (parser->line_len + len >= parser->max_size) {
+        ESP_LOGW(TAG, "line longer than %zu bytes, skipped", parser->max_size);
+        parser->line_overflow = true;
+        return;
+    }
+    memcpy(parser->line + parser->line_len, data, len);
+    parser->line_len += len;
+}
+
+app_sse_parser_handle_t app_sse_parser_create(size_t max_event_size, app_sse_dispatch_t dispatch,
+                                              app_sse_event_cb_t cb, void *user_ctx)
+{
+    if (cb == NULL || max_event_size == 0) {
+        return NULL;
+    }
+
+    app_sse_parser_handle_t parser = heap_caps_calloc(1, sizeof(struct app_sse_parser), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (parser == NULL) {
+        return NULL;
+    }
+
+    // 行缓冲和事件缓冲共用一块内存
+    char *buf = heap_caps_malloc(max_event_size * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buf == NULL) {
+        heap_caps_free(parser);
+        return NULL;
+    }
+
+    parser->cb = cb;
+    parser->user_ctx = user_ctx;
+    parser->dispatch = dispatch;
+    parser->max_size = max_event_size;
+    parser->line = buf;
+    parser->event = buf + max_event_size;
+    return parser;
+}
+
+esp_err_t app_sse_parser_feed(app_sse_parser_handle_t parser, const char *data, size_t len)
+{
+    if (parser == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (len > 0) {
+        const char *nl = memchr(data, '\n', len);
+        size_t seg = nl ? (size_t)(nl - data) : len;
+
+        sse_line_append(parser, data, seg);
+        if (nl == NULL) {
+            break;
+        }
+
+        if (!parser->line_overflow) {
+            sse_process_line(parser);
+        }
+        parser->line_len = 0;
+        parser->line_overflow = false;
+
+        data += seg + 1;
+        len -= seg + 1;
+    }
+    return ESP_OK;
+}
+
+void app_sse_parser_finish(app_sse_parser_handle_t parser)
+{
+    if (parser == NULL) {
+        return;
+    }
+    // 流结束时最后一行可能没有换行符
+    if (parser->line_len > 0 && !parser->line_overflow) {
+        sse_process_line(parser);
+    }
+    sse_dispatch(parser);
+    app_sse_parser_reset(parser);
+}
+
+void app_sse_parser_reset(app_sse_parser_handle_t parser)
+{
+    if (parser == NULL) {
+        return;
+    }
+    parser->line_len = 0;
+    parser->line_overflow = false;
+    parser->event_len = 0;
+    parser->event_has_data = false;
+    parser->event_overflow = false;
+}
+
+void app_sse_parser_delete(app_sse_parser_handle_t parser)
+{
+    if (parser == NULL) {
+        return;
+    }
+    heap_caps_free(parser->line);
+    heap_caps_free(parser);
+}
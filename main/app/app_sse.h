@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_SSE_DISPATCH_EVENT = 0,     /*!< At the blank line ending an event, `data:` lines joined with '\n' */
+    APP_SSE_DISPATCH_LINE,          /*!< Every `data:` line on its own as soon as it ends, for servers that
+                                         send one JSON value per line without blank lines in between */
+} app_sse_dispatch_t;
+
+/**
+ * @brief Called once for every complete server-sent event, or every `data:` line with APP_SSE_DISPATCH_LINE.
+ *
+ * @param data: Payload, NUL terminated
+ * @param len: Length of the payload, excluding the terminator
+ * @param user_ctx: User context given to app_sse_parser_create
+ */
+typedef void (*app_sse_event_cb_t)(const char *data, size_t len, void *user_ctx);
+
+typedef struct app_sse_parser *app_sse_parser_handle_t;
+
+/**
+ * @brief Create a line-framed SSE parser.
+ *
+ * @param max_event_size: Largest event payload that can be delivered, longer events are dropped
+ * @param dispatch: When a payload is delivered
+ * @param cb: Event callback
+ * @param user_ctx: Passed to the callback unchanged
+ *
+ * @return parser handle, NULL if out of memory
+ */
+app_sse_parser_handle_t app_sse_parser_create(size_t max_event_size, app_sse_dispatch_t dispatch,
+                                              app_sse_event_cb_t cb, void *user_ctx);
+
+/**
+ * @brief Feed a chunk of the response body, events are dispatched as soon as they are complete.
+ *
+ * @param parser: Parser handle
+ * @param data: Received bytes, need not be aligned to line boundaries
+ * @param len: Number of bytes
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid parser
+ */
+esp_err_t app_sse_parser_feed(app_sse_parser_handle_t parser, const char *data, size_t len);
+
+/**
+ * @brief Flush the pending event at the end of the stream, then reset the parser.
+ *
+ * @param parser: Parser handle
+ */
+void app_sse_parser_finish(app_sse_parser_handle_t parser);
+
+/**
+ * @brief Drop any partial line or event without dispatching it.
+ *
+ * @param parser: Parser handle
+ */
+void app_sse_parser_reset(app_sse_parser_handle_t parser);
+
+/**
+ * @brief Free the parser.
+ *
+ * @param parser: Parser handle
+ */
+void app_sse_parser_delete(app_sse_parser_handle_t parser);
+
+#ifdef __cplusplus
+}
+#endif
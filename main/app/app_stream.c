@@ -0,0 +1,322 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "app_stream.h"
+#include "app_telemetry.h"
+
+static const char *TAG = "app_stream";
+
+#define STREAM_DATA_BIT         BIT0
+#define STREAM_SPACE_BIT        BIT1
+#define STREAM_REWIND_SIZE      (4096)  /*!< Bytes kept behind the reader for seeking back */
+#define STREAM_READ_WAIT_MS     (100)
+
+struct app_stream {
+    uint8_t *buf;
+    size_t capacity;
+    size_t rewind;
+    size_t base;        /*!< Oldest position still held in the ring */
+    size_t rd;          /*!< Reader position */
+    size_t wr;          /*!< Writer position, total bytes written */
+    bool eof;
+    bool failed;
+    bool reader_open;
+    bool reader_closed;
+    app_stream_release_cb_t release_cb;   /*!< Takes the buffer of a complete linear stream */
+    void *release_ctx;
+    int refs;
+    SemaphoreHandle_t lock;
+    EventGroupHandle_t events;
+};
+
+// 释放一个引用, 引用归零时释放流
+static void stream_unref(app_stream_handle_t stream)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    int refs = --stream->refs;
+    xSemaphoreGive(stream->lock);
+
+    if (refs == 0) {
+        vSemaphoreDelete(stream->lock);
+        vEventGroupDelete(stream->events);
+        // 两端都已关闭, 完整的数据整块转交, 不再拷贝
+        if (stream->release_cb && stream->buf && stream->eof && !stream->failed && stream->wr == stream->capacity) {
+            stream->release_cb(stream->buf, stream->wr, stream->release_ctx);
+        } else {
+            heap_caps_free(stream->buf);
+        }
+        heap_caps_free(stream);
+    }
+}
+
+// 读指针前移后回收旧数据
+static void stream_advance_base(app_stream_handle_t stream)
+{
+    if (stream->rd > stream->base + stream->rewind) {
+        stream->base = stream->rd - stream->rewind;
+        xEventGroupSetBits(stream->events, STREAM_SPACE_BIT);
+    }
+}
+
+static int stream_read(void *cookie, char *buf, int size)
+{
+    app_stream_handle_t stream = (app_stream_handle_t)cookie;
+    if (size <= 0) {
+        return 0;
+    }
+
+    while (1) {
+        xSemaphoreTake(stream->lock, portMAX_DELAY);
+        size_t avail = stream->wr - stream->rd;
+        if (avail > 0) {
+            size_t n = MIN(avail, (size_t)size);
+            size_t off = stream->rd % stream->capacity;
+            size_t first = MIN(n, stream->capacity - off);
+            memcpy(buf, stream->buf + off, first);
+            memcpy(buf + first, stream->buf, n - first);
+            stream->rd += n;
+            stream_advance_base(stream);
+            xSemaphoreGive(stream->lock);
+            return n;
+        }
+        if (stream->eof) {
+            xSemaphoreGive(stream->lock);
+            return 0;
+        }
+        xEventGroupClearBits(stream->events, STREAM_DATA_BIT);
+        xSemaphoreGive(stream->lock);
+
+        xEventGroupWaitBits(stream->events, STREAM_DATA_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(STREAM_READ_WAIT_MS));
+    }
+}
+
+static fpos_t stream_seek(void *cookie, fpos_t offset, int whence)
+{
+    app_stream_handle_t stream = (app_stream_handle_t)cookie;
+    fpos_t target;
+
+    while (1) {
+        xSemaphoreTake(stream->lock, portMAX_DELAY);
+        switch (whence) {
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = (fpos_t)stream->rd + offset;
+            break;
+        case SEEK_END:
+            if (!stream->eof) {
+                // 总长度未知
+                xSemaphoreGive(stream->lock);
+                errno = ESPIPE;
+                return -1;
+            }
+            target = (fpos_t)stream->wr + offset;
+            break;
+        default:
+            xSemaphoreGive(stream->lock);
+            errno = EINVAL;
+            return -1;
+        }
+
+        if (target < (fpos_t)stream->base || (target > (fpos_t)stream->wr && stream->eof)) {
+            xSemaphoreGive(stream->lock);
+            errno = EINVAL;
+            return -1;
+        }
+        if (target <= (fpos_t)stream->wr) {
+            stream->rd = target;
+            stream_advance_base(stream);
+            xSemaphoreGive(stream->lock);
+            return target;
+        }
+
+        // 向前跳过尚未下载的数据, 等待写入
+        xEventGroupClearBits(stream->events, STREAM_DATA_BIT);
+        xSemaphoreGive(stream->lock);
+        xEventGroupWaitBits(stream->events, STREAM_DATA_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(STREAM_READ_WAIT_MS));
+    }
+}
+
+static int stream_close(void *cookie)
+{
+    app_stream_handle_t stream = (app_stream_handle_t)cookie;
+
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    stream->reader_closed = true;
+    xEventGroupSetBits(stream->events, STREAM_SPACE_BIT);
+    xSemaphoreGive(stream->lock);
+
+    stream_unref(stream);
+    return 0;
+}
+
+app_stream_handle_t app_stream_create(size_t capacity)
+{
+    app_stream_handle_t stream = heap_caps_calloc(1, sizeof(struct app_stream), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (stream == NULL) {
+        app_telemetry_oom(APP_TELEMETRY_OOM_STREAM);
+        return NULL;
+    }
+
+    stream->lock = xSemaphoreCreateMutex();
+    stream->events = xEventGroupCreate();
+    if (stream->lock == NULL || stream->events == NULL) {
+        ESP_LOGE(TAG, "no memory for stream");
+        app_telemetry_oom(APP_TELEMETRY_OOM_STREAM);
+        if (stream->lock) {
+            vSemaphoreDelete(stream->lock);
+        }
+        if (stream->events) {
+            vEventGroupDelete(stream->events);
+        }
+        heap_caps_free(stream);
+        return NULL;
+    }
+
+    stream->capacity = capacity;
+    stream->rewind = MIN(STREAM_REWIND_SIZE, capacity / 2);
+    stream->refs = 1;
+    return stream;
+}
+
+FILE *app_stream_open_reader(app_stream_handle_t stream)
+{
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    if (stream->reader_open) {
+        xSemaphoreGive(stream->lock);
+        return NULL;
+    }
+    stream->reader_open = true;
+    stream->refs++;
+    xSemaphoreGive(stream->lock);
+
+    FILE *fp = funopen(stream, stream_read, NULL, stream_seek, stream_close);
+    if (fp == NULL) {
+        xSemaphoreTake(stream->lock, portMAX_DELAY);
+        stream->reader_closed = true;
+        xSemaphoreGive(stream->lock);
+        stream_unref(stream);
+        return NULL;
+    }
+    // 由流自身缓冲, 关闭 stdio 缓冲避免再拷贝一次
+    setvbuf(fp, NULL, _IONBF, 0);
+    return fp;
+}
+
+esp_err_t app_stream_set_linear(app_stream_handle_t stream, size_t size, app_stream_release_cb_t release_cb, void *ctx)
+{
+    if (stream == NULL || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // 缓冲区尚未分配, 读取端最多在等待数据
+    if (stream->buf != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    // 写入总量不超过 size 时不会回绕, 缓冲区即为完整的数据
+    stream->capacity = size;
+    stream->rewind = MIN(STREAM_REWIND_SIZE, size / 2);
+    stream->release_cb = release_cb;
+    stream->release_ctx = ctx;
+    xSemaphoreGive(stream->lock);
+    return ESP_OK;
+}
+
+esp_err_t app_stream_write_acquire(app_stream_handle_t stream, uint8_t **ptr, size_t *len, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    // 只有写入方访问 buf 指针, 首次写入时再分配缓冲区
+    if (stream->buf == NULL) {
+        stream->buf = heap_caps_malloc(stream->capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (stream->buf == NULL) {
+            ESP_LOGE(TAG, "no memory for %zu bytes stream", stream->capacity);
+            app_telemetry_oom(APP_TELEMETRY_OOM_STREAM);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    while (1) {
+        xSemaphoreTake(stream->lock, portMAX_DELAY);
+        if (stream->reader_closed) {
+            xSemaphoreGive(stream->lock);
+            return ESP_ERR_INVALID_STATE;
+        }
+        size_t space = stream->capacity - (stream->wr - stream->base);
+        if (space > 0) {
+            size_t off = stream->wr % stream->capacity;
+            *ptr = stream->buf + off;
+            *len = MIN(space, stream->capacity - off);
+            xSemaphoreGive(stream->lock);
+            return ESP_OK;
+        }
+        xEventGroupClearBits(stream->events, STREAM_SPACE_BIT);
+        xSemaphoreGive(stream->lock);
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        xEventGroupWaitBits(stream->events, STREAM_SPACE_BIT, pdFALSE, pdTRUE, timeout - elapsed);
+    }
+}
+
+void app_stream_write_commit(app_stream_handle_t stream, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    stream->wr += len;
+    xEventGroupSetBits(stream->events, STREAM_DATA_BIT);
+    xSemaphoreGive(stream->lock);
+}
+
+esp_err_t app_stream_write(app_stream_handle_t stream, const void *data, size_t len, TickType_t timeout)
+{
+    const uint8_t *src = (const uint8_t *)data;
+    while (len > 0) {
+        uint8_t *ptr = NULL;
+        size_t space = 0;
+        esp_err_t ret = app_stream_write_acquire(stream, &ptr, &space, timeout);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        size_t n = MIN(space, len);
+        memcpy(ptr, src, n);
+        app_stream_write_commit(stream, n);
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+void app_stream_finish(app_stream_handle_t stream, bool success)
+{
+    if (stream == NULL) {
+        return;
+    }
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    stream->eof = true;
+    stream->failed = !success;
+    xEventGroupSetBits(stream->events, STREAM_DATA_BIT);
+    xSemaphoreGive(stream->lock);
+
+    stream_unref(stream);
+}
@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bounded single-writer/single-reader byte stream backed by a PSRAM ring buffer.
+ *
+ * The writer (a download) fills the ring while the reader drains it through a
+ * regular `FILE *`, so a decoder can start before the last byte has arrived.
+ * The first bytes stay rewindable until the reader has moved past them, which
+ * lets format probing code seek back to the start.
+ */
+typedef struct app_stream *app_stream_handle_t;
+
+/**
+ * @brief Called once both sides of a complete linear stream are closed.
+ *
+ * @param buf: Whole stream data, allocated with heap_caps_malloc, ownership passes to the callback
+ * @param len: Size of the data
+ * @param ctx: User context
+ */
+typedef void (*app_stream_release_cb_t)(uint8_t *buf, size_t len, void *ctx);
+
+/**
+ * @brief Create a stream, the caller holds the writer side.
+ *
+ * The ring buffer is allocated on the first write, so streams queued ahead
+ * of their download only cost a small control block.
+ *
+ * @param capacity: Size of the ring buffer in bytes
+ *
+ * @return stream handle, NULL if out of memory
+ */
+app_stream_handle_t app_stream_create(size_t capacity);
+
+/**
+ * @brief Open the reader side as a read-only FILE, can be called once per stream.
+ *
+ * Closing the FILE releases the reader side; pending and later writes fail.
+ *
+ * @param stream: Stream handle
+ *
+ * @return FILE pointer, NULL on failure
+ */
+FILE *app_stream_open_reader(app_stream_handle_t stream);
+
+/**
+ * @brief Size the ring to the whole stream, so that it ends up holding all of the data.
+ *
+ * When the writer has finished successfully with exactly `size` bytes and
+ * the reader is closed, the buffer is handed to `release_cb` instead of
+ * being freed, so the data can be kept without another copy. Must be
+ * called by the writer before the first write.
+ *
+ * @param stream: Stream handle
+ * @param size: Total size of the data
+ * @param release_cb: Takes the buffer, NULL to free it
+ * @param ctx: User context of `release_cb`
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - ESP_ERR_INVALID_STATE: Data was already written
+ */
+esp_err_t app_stream_set_linear(app_stream_handle_t stream, size_t size, app_stream_release_cb_t release_cb, void *ctx);
+
+/**
+ * @brief Get a contiguous writable region of the ring, waiting for space if needed.
+ *
+ * @param stream: Stream handle
+ * @param ptr: Output, start of the writable region
+ * @param len: Output, size of the writable region
+ * @param timeout: Max block time
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_TIMEOUT: No space became available in time
+ *    - ESP_ERR_INVALID_STATE: The reader has been closed
+ *    - ESP_ERR_NO_MEM: The ring buffer could not be allocated
+ */
+esp_err_t app_stream_write_acquire(app_stream_handle_t stream, uint8_t **ptr, size_t *len, TickType_t timeout);
+
+/**
+ * @brief Publish `len` bytes written into the region returned by app_stream_write_acquire.
+ *
+ * @param stream: Stream handle
+ * @param len: Number of bytes written
+ */
+void app_stream_write_commit(app_stream_handle_t stream, size_t len);
+
+/**
+ * @brief Copy data into the stream, waiting for space as needed.
+ *
+ * @param stream: Stream handle
+ * @param data: Bytes to write
+ * @param len: Number of bytes
+ * @param timeout: Max block time for each wait on space
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - Others: Fail, see app_stream_write_acquire
+ */
+esp_err_t app_stream_write(app_stream_handle_t stream, const void *data, size_t len, TickType_t timeout);
+
+/**
+ * @brief Mark the end of data and release the writer side.
+ *
+ * @param stream: Stream handle
+ * @param success: false if the download failed, the reader then sees an early EOF
+ */
+void app_stream_finish(app_stream_handle_t stream, bool success);
+
+#ifdef __cplusplus
+}
+#endif
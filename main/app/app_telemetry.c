@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "app_telemetry.h"
+
+static const char *TAG = "app_telemetry";
+
+static const uint32_t telemetry_heap_caps[APP_TELEMETRY_HEAP_MAX] = {
+    [APP_TELEMETRY_HEAP_INTERNAL] = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    [APP_TELEMETRY_HEAP_SPIRAM]   = MALLOC_CAP_SPIRAM,
+    [APP_TELEMETRY_HEAP_DMA]      = MALLOC_CAP_DMA,
+};
+
+static const char *telemetry_heap_name[APP_TELEMETRY_HEAP_MAX] = {
+    [APP_TELEMETRY_HEAP_INTERNAL] = "internal",
+    [APP_TELEMETRY_HEAP_SPIRAM]   = "spiram",
+    [APP_TELEMETRY_HEAP_DMA]      = "dma",
+};
+
+static const char *telemetry_oom_name[APP_TELEMETRY_OOM_MAX] = {
+    [APP_TELEMETRY_OOM_STREAM]    = "stream",
+    [APP_TELEMETRY_OOM_TTS_LINK]  = "tts_link",
+    [APP_TELEMETRY_OOM_TTS_CACHE] = "tts_cache",
+    [APP_TELEMETRY_OOM_UI_TEXT]   = "ui_text",
+    [APP_TELEMETRY_OOM_TASK]      = "task",
+};
+
+#define TELEMETRY_TASK_MAX      (16)
+
+typedef struct {
+    const char *name;
+    TaskHandle_t handle;
+} telemetry_task_t;
+
+// 语音对话流水线上的任务, 创建时登记句柄, 不按名字查找
+static telemetry_task_t telemetry_tasks[TELEMETRY_TASK_MAX];
+static int telemetry_task_count = 0;
+static portMUX_TYPE telemetry_task_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static atomic_uint_fast32_t telemetry_oom_count[APP_TELEMETRY_OOM_MAX];
+static app_telemetry_stage_cb_t telemetry_stage_cb = NULL;
+
+void app_telemetry_register_stage_cb(app_telemetry_stage_cb_t cb)
+{
+    telemetry_stage_cb = cb;
+}
+
+void app_telemetry_add_task(const char *name, TaskHandle_t task)
+{
+    if (task == NULL) {
+        return;
+    }
+    bool added = false;
+    portENTER_CRITICAL(&telemetry_task_lock);
+    if (telemetry_task_count < TELEMETRY_TASK_MAX) {
+        telemetry_tasks[telemetry_task_count].name = name;
+        telemetry_tasks[telemetry_task_count].handle = task;
+        telemetry_task_count++;
+        added = true;
+    }
+    portEXIT_CRITICAL(&telemetry_task_lock);
+    if (!added) {
+        ESP_LOGW(TAG, "too many tasks, %s not tracked", name);
+    }
+}
+
+void app_telemetry_oom(app_telemetry_oom_t site)
+{
+    if (site < APP_TELEMETRY_OOM_MAX) {
+        uint32_t count = atomic_fetch_add(&telemetry_oom_count[site], 1) + 1;
+        ESP_LOGW(TAG, "out of memory at %s, %" PRIu32 " times", telemetry_oom_name[site], count);
+    }
+}
+
+void app_telemetry_sample(app_telemetry_sample_t *sample)
+{
+    sample->stage = telemetry_stage_cb ? telemetry_stage_cb() : "unknown";
+    for (int i = 0; i < APP_TELEMETRY_HEAP_MAX; i++) {
+        sample->heap[i].free = heap_caps_get_free_size(telemetry_heap_caps[i]);
+        sample->heap[i].largest = heap_caps_get_largest_free_block(telemetry_heap_caps[i]);
+        sample->heap[i].min_free = heap_caps_get_minimum_free_size(telemetry_heap_caps[i]);
+    }
+    for (int i = 0; i < APP_TELEMETRY_OOM_MAX; i++) {
+        sample->oom[i] = atomic_load(&telemetry_oom_count[i]);
+    }
+}
+
+// 已登记的任务数, 任务只增不删, 之前的条目不会再变
+static int telemetry_task_num(void)
+{
+    portENTER_CRITICAL(&telemetry_task_lock);
+    int count = telemetry_task_count;
+    portEXIT_CRITICAL(&telemetry_task_lock);
+    return count;
+}
+
+// 栈剩余的最小值, 单位字节
+static int telemetry_stack_free(int index)
+{
+    return uxTaskGetStackHighWaterMark(telemetry_tasks[index].handle) * sizeof(StackType_t);
+}
+
+void app_telemetry_log(void)
+{
+    app_telemetry_sample_t sample;
+    app_telemetry_sample(&sample);
+    for (int i = 0; i < APP_TELEMETRY_HEAP_MAX; i++) {
+        ESP_LOGI(TAG, "[%s] %s heap free %" PRIu32 ", largest %" PRIu32 ", min %" PRIu32, sample.stage, telemetry_heap_name[i],
+                 sample.heap[i].free, sample.heap[i].largest, sample.heap[i].min_free);
+    }
+    int task_num = telemetry_task_num();
+    for (int i = 0; i < task_num; i++) {
+        ESP_LOGI(TAG, "[%s] %s stack free min %d", sample.stage, telemetry_tasks[i].name, telemetry_stack_free(i));
+    }
+    for (int i = 0; i < APP_TELEMETRY_OOM_MAX; i++) {
+        if (sample.oom[i]) {
+            ESP_LOGW(TAG, "[%s] oom %s: %" PRIu32, sample.stage, telemetry_oom_name[i], sample.oom[i]);
+        }
+    }
+}
+
+cJSON *app_telemetry_to_json(void)
+{
+    app_telemetry_sample_t sample;
+    app_telemetry_sample(&sample);
+
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return NULL;
+    }
+    cJSON_AddStringToObject(root, "stage", sample.stage);
+    cJSON *heap = cJSON_AddObjectToObject(root, "heap");
+    for (int i = 0; heap && i < APP_TELEMETRY_HEAP_MAX; i++) {
+        cJSON *item = cJSON_AddObjectToObject(heap, telemetry_heap_name[i]);
+        if (item) {
+            cJSON_AddNumberToObject(item, "free", sample.heap[i].free);
+            cJSON_AddNumberToObject(item, "largest", sample.heap[i].largest);
+            cJSON_AddNumberToObject(item, "min", sample.heap[i].min_free);
+        }
+    }
+    cJSON *stack = cJSON_AddObjectToObject(root, "stack");
+    int task_num = telemetry_task_num();
+    for (int i = 0; stack && i < task_num; i++) {
+        cJSON_AddNumberToObject(stack, telemetry_tasks[i].name, telemetry_stack_free(i));
+    }
+    cJSON *oom = cJSON_AddObjectToObject(root, "oom");
+    for (int i = 0; oom && i < APP_TELEMETRY_OOM_MAX; i++) {
+        cJSON_AddNumberToObject(oom, telemetry_oom_name[i], sample.oom[i]);
+    }
+    return root;
+}
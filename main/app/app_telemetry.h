@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_TELEMETRY_HEAP_INTERNAL = 0,
+    APP_TELEMETRY_HEAP_SPIRAM,
+    APP_TELEMETRY_HEAP_DMA,
+    APP_TELEMETRY_HEAP_MAX,
+} app_telemetry_heap_t;
+
+typedef enum {
+    APP_TELEMETRY_OOM_STREAM = 0,   /*!< TTS stream control block or buffer */
+    APP_TELEMETRY_OOM_TTS_LINK,     /*!< Speech segment link */
+    APP_TELEMETRY_OOM_TTS_CACHE,    /*!< TTS cache entry, the segment is not cached */
+    APP_TELEMETRY_OOM_UI_TEXT,      /*!< Decoded reply text, shown undecoded */
+    APP_TELEMETRY_OOM_TASK,         /*!< Pipeline worker creation */
+    APP_TELEMETRY_OOM_MAX,
+} app_telemetry_oom_t;
+
+typedef struct {
+    uint32_t free;              /*!< Free bytes */
+    uint32_t largest;           /*!< Largest free block */
+    uint32_t min_free;          /*!< Lowest free bytes since boot */
+} app_telemetry_heap_info_t;
+
+typedef struct {
+    const char *stage;                                      /*!< Turn stage when sampled */
+    app_telemetry_heap_info_t heap[APP_TELEMETRY_HEAP_MAX];
+    uint32_t oom[APP_TELEMETRY_OOM_MAX];                    /*!< Allocation failures handled without abort */
+} app_telemetry_sample_t;
+
+/**
+ * @brief Returns the name of the current turn stage.
+ */
+typedef const char *(*app_telemetry_stage_cb_t)(void);
+
+/**
+ * @brief Register the callback that names the current turn stage, used to tag samples.
+ *
+ * @param cb: Callback, NULL tags samples as "unknown"
+ */
+void app_telemetry_register_stage_cb(app_telemetry_stage_cb_t cb);
+
+/**
+ * @brief Track the stack high-water mark of a pipeline task, called once after it is created.
+ *
+ * @param name: Name to report, must stay valid; tasks sharing a name are reported separately
+ * @param task: Task handle, NULL is ignored
+ */
+void app_telemetry_add_task(const char *name, TaskHandle_t task);
+
+/**
+ * @brief Count an allocation failure that was handled by degrading instead of aborting.
+ *
+ * @param site: Where it failed
+ */
+void app_telemetry_oom(app_telemetry_oom_t site);
+
+/**
+ * @brief Sample the heaps and the OOM counters.
+ *
+ * @param sample: Output
+ */
+void app_telemetry_sample(app_telemetry_sample_t *sample);
+
+/**
+ * @brief Sample and log heaps, task stack high-water marks and OOM counters.
+ */
+void app_telemetry_log(void);
+
+/**
+ * @brief Sample into a JSON object, including the stack high-water mark of each pipeline task.
+ *
+ * @return object to be freed with cJSON_Delete, NULL if out of memory
+ */
+cJSON *app_telemetry_to_json(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,377 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/queue.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "bsp_storage.h"
+#include "app_tts_cache.h"
+#include "app_telemetry.h"
+
+static const char *TAG = "app_tts_cache";
+
+#define TTS_CACHE_PSRAM_SIZE    (CONFIG_TTS_CACHE_PSRAM_SIZE)
+#define TTS_CACHE_SD_MOUNT      "/sdcard"
+#define TTS_CACHE_SD_DIR        TTS_CACHE_SD_MOUNT "/tts"
+#define TTS_CACHE_SD_MAX_FILES  (4)
+#define TTS_CACHE_PATH_SIZE     (32)
+
+typedef struct cache_entry {
+    TAILQ_ENTRY(cache_entry) next;
+    uint32_t key;
+    uint8_t *data;
+    size_t len;
+    int refs;           /*!< One for the LRU list plus one per open reader */
+} cache_entry_t;
+
+typedef struct {
+    cache_entry_t *entry;
+    size_t pos;
+} cache_reader_t;
+
+static TAILQ_HEAD(cache_entry_head, cache_entry) cache_lru = TAILQ_HEAD_INITIALIZER(cache_lru);    /*!< Most recently used first */
+static size_t cache_used = 0;
+static SemaphoreHandle_t cache_lock = NULL;
+static app_tts_cache_stats_t cache_stats = {0};
+
+#if CONFIG_TTS_CACHE_SDCARD
+typedef struct {
+    uint32_t key;
+    uint32_t seq;       /*!< Last use, the lowest is evicted first */
+} sd_entry_t;
+
+static sd_entry_t *sd_index = NULL;
+static size_t sd_count = 0;
+static uint32_t sd_seq = 0;
+static SemaphoreHandle_t sd_lock = NULL;
+#endif
+
+// 释放一个引用, 引用归零时释放数据, 调用前需持有锁
+static void cache_entry_unref(cache_entry_t *entry)
+{
+    if (--entry->refs == 0) {
+        heap_caps_free(entry->data);
+        heap_caps_free(entry);
+    }
+}
+
+// 从 LRU 链表移除, 正在播放的条目在读取端关闭后释放, 调用前需持有锁
+static void cache_evict(cache_entry_t *entry)
+{
+    TAILQ_REMOVE(&cache_lru, entry, next);
+    cache_used -= entry->len;
+    cache_stats.evictions++;
+    cache_entry_unref(entry);
+}
+
+static cache_entry_t *cache_find(uint32_t key)
+{
+    cache_entry_t *entry;
+    TAILQ_FOREACH(entry, &cache_lru, next) {
+        if (entry->key == key) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static int cache_read(void *cookie, char *buf, int size)
+{
+    cache_reader_t *reader = (cache_reader_t *)cookie;
+    size_t n = MIN((size_t)MAX(size, 0), reader->entry->len - reader->pos);
+    memcpy(buf, reader->entry->data + reader->pos, n);
+    reader->pos += n;
+    return n;
+}
+
+static fpos_t cache_seek(void *cookie, fpos_t offset, int whence)
+{
+    cache_reader_t *reader = (cache_reader_t *)cookie;
+    fpos_t target;
+
+    switch (whence) {
+    case SEEK_SET:
+        target = offset;
+        break;
+    case SEEK_CUR:
+        target = (fpos_t)reader->pos + offset;
+        break;
+    case SEEK_END:
+        target = (fpos_t)reader->entry->len + offset;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    if (target < 0 || target > (fpos_t)reader->entry->len) {
+        errno = EINVAL;
+        return -1;
+    }
+    reader->pos = target;
+    return target;
+}
+
+static int cache_close(void *cookie)
+{
+    cache_reader_t *reader = (cache_reader_t *)cookie;
+
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    cache_entry_unref(reader->entry);
+    xSemaphoreGive(cache_lock);
+    free(reader);
+    return 0;
+}
+
+#if CONFIG_TTS_CACHE_SDCARD
+static void sd_path(uint32_t key, char *path)
+{
+    snprintf(path, TTS_CACHE_PATH_SIZE, TTS_CACHE_SD_DIR "/%08" PRIx32 ".mp3", key);
+}
+
+static sd_entry_t *sd_find(uint32_t key)
+{
+    for (size_t i = 0; i < sd_count; i++) {
+        if (sd_index[i].key == key) {
+            return &sd_index[i];
+        }
+    }
+    return NULL;
+}
+
+// 删除最久未使用的文件, 调用前需持有锁
+static void sd_evict_oldest(void)
+{
+    size_t oldest = 0;
+    for (size_t i = 1; i < sd_count; i++) {
+        if (sd_index[i].seq < sd_index[oldest].seq) {
+            oldest = i;
+        }
+    }
+    char path[TTS_CACHE_PATH_SIZE];
+    sd_path(sd_index[oldest].key, path);
+    unlink(path);
+    sd_index[oldest] = sd_index[--sd_count];
+    cache_stats.evictions++;
+}
+
+// 挂载 SD 卡并载入已有的缓存文件
+static esp_err_t sd_init(void)
+{
+    ESP_RETURN_ON_ERROR(bsp_sdcard_init(TTS_CACHE_SD_MOUNT, TTS_CACHE_SD_MAX_FILES), TAG, "mount sdcard failed");
+    mkdir(TTS_CACHE_SD_DIR, 0775);
+
+    sd_index = heap_caps_calloc(CONFIG_TTS_CACHE_SDCARD_FILES, sizeof(sd_entry_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    sd_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(sd_index && sd_lock, ESP_ERR_NO_MEM, TAG, "no memory for sdcard index");
+
+    DIR *dir = opendir(TTS_CACHE_SD_DIR);
+    ESP_RETURN_ON_FALSE(dir, ESP_FAIL, TAG, "open %s failed", TTS_CACHE_SD_DIR);
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        char *end = NULL;
+        uint32_t key = strtoul(ent->d_name, &end, 16);
+        if (end != ent->d_name + 8 || strcasecmp(end, ".mp3") != 0) {
+            continue;
+        }
+        if (sd_count == CONFIG_TTS_CACHE_SDCARD_FILES) {
+            sd_evict_oldest();
+        }
+        sd_index[sd_count++] = (sd_entry_t) {
+            .key = key, .seq = 0,
+        };
+    }
+    closedir(dir);
+    ESP_LOGI(TAG, "sdcard tier ready, %zu files", sd_count);
+    return ESP_OK;
+}
+
+static FILE *sd_open(uint32_t key)
+{
+    if (sd_index == NULL) {
+        return NULL;
+    }
+    xSemaphoreTake(sd_lock, portMAX_DELAY);
+    sd_entry_t *entry = sd_find(key);
+    if (entry) {
+        entry->seq = ++sd_seq;
+    }
+    xSemaphoreGive(sd_lock);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    char path[TTS_CACHE_PATH_SIZE];
+    sd_path(key, path);
+    return fopen(path, "r");
+}
+
+static void sd_insert(uint32_t key, const uint8_t *data, size_t len)
+{
+    if (sd_index == NULL) {
+        return;
+    }
+    xSemaphoreTake(sd_lock, portMAX_DELAY);
+    if (sd_find(key)) {
+        xSemaphoreGive(sd_lock);
+        return;
+    }
+    if (sd_count == CONFIG_TTS_CACHE_SDCARD_FILES) {
+        sd_evict_oldest();
+    }
+
+    char path[TTS_CACHE_PATH_SIZE];
+    sd_path(key, path);
+    FILE *fp = fopen(path, "w");
+    bool ok = fp && fwrite(data, 1, len, fp) == len;
+    if (fp) {
+        ok = (fclose(fp) == 0) && ok;
+    }
+    if (ok) {
+        sd_index[sd_count++] = (sd_entry_t) {
+            .key = key, .seq = ++sd_seq,
+        };
+    } else {
+        ESP_LOGW(TAG, "write %s failed", path);
+        unlink(path);
+    }
+    xSemaphoreGive(sd_lock);
+}
+#endif
+
+esp_err_t app_tts_cache_init(void)
+{
+    if (cache_lock) {
+        return ESP_OK;
+    }
+    cache_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(cache_lock, ESP_ERR_NO_MEM, TAG, "create lock failed");
+
+#if CONFIG_TTS_CACHE_SDCARD
+    if (sd_init() != ESP_OK) {
+        // 没有 SD 卡时只使用 PSRAM 缓存
+        ESP_LOGW(TAG, "sdcard tier disabled");
+        heap_caps_free(sd_index);
+        sd_index = NULL;
+    }
+#endif
+    return ESP_OK;
+}
+
+uint32_t app_tts_cache_key(const char *str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+FILE *app_tts_cache_open(uint32_t key)
+{
+    ESP_RETURN_ON_FALSE(cache_lock, NULL, TAG, "cache not initialized");
+
+    cache_reader_t *reader = calloc(1, sizeof(cache_reader_t));
+    ESP_RETURN_ON_FALSE(reader, NULL, TAG, "no memory for reader");
+
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    cache_entry_t *entry = cache_find(key);
+    if (entry) {
+        TAILQ_REMOVE(&cache_lru, entry, next);
+        TAILQ_INSERT_HEAD(&cache_lru, entry, next);
+        entry->refs++;
+        cache_stats.hits++;
+    }
+    xSemaphoreGive(cache_lock);
+
+    if (entry) {
+        reader->entry = entry;
+        FILE *fp = funopen(reader, cache_read, NULL, cache_seek, cache_close);
+        if (fp == NULL) {
+            cache_close(reader);
+        }
+        return fp;
+    }
+    free(reader);
+
+    FILE *fp = NULL;
+#if CONFIG_TTS_CACHE_SDCARD
+    fp = sd_open(key);
+#endif
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    if (fp) {
+        cache_stats.hits++;
+        cache_stats.sd_hits++;
+    } else {
+        cache_stats.misses++;
+    }
+    xSemaphoreGive(cache_lock);
+    return fp;
+}
+
+void app_tts_cache_insert(uint32_t key, uint8_t *data, size_t len)
+{
+    if (cache_lock == NULL || data == NULL) {
+        heap_caps_free(data);
+        return;
+    }
+
+#if CONFIG_TTS_CACHE_SDCARD
+    sd_insert(key, data, len);
+#endif
+
+    if (len > TTS_CACHE_PSRAM_SIZE) {
+        heap_caps_free(data);
+        return;
+    }
+
+    cache_entry_t *entry = heap_caps_calloc(1, sizeof(cache_entry_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (entry == NULL) {
+        app_telemetry_oom(APP_TELEMETRY_OOM_TTS_CACHE);
+        heap_caps_free(data);
+        return;
+    }
+    entry->key = key;
+    entry->data = data;
+    entry->len = len;
+    entry->refs = 1;
+
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    if (cache_find(key)) {
+        // 并发下载了同一段语音, 保留已有的条目
+        xSemaphoreGive(cache_lock);
+        heap_caps_free(data);
+        heap_caps_free(entry);
+        return;
+    }
+    while (cache_used + len > TTS_CACHE_PSRAM_SIZE) {
+        cache_evict(TAILQ_LAST(&cache_lru, cache_entry_head));
+    }
+    TAILQ_INSERT_HEAD(&cache_lru, entry, next);
+    cache_used += len;
+    xSemaphoreGive(cache_lock);
+    ESP_LOGD(TAG, "cached %08" PRIx32 ", %zu bytes, %zu used", key, len, cache_used);
+}
+
+void app_tts_cache_get_stats(app_tts_cache_stats_t *stats)
+{
+    xSemaphoreTake(cache_lock, portMAX_DELAY);
+    *stats = cache_stats;
+    xSemaphoreGive(cache_lock);
+}
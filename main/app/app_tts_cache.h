@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t hits;          /*!< Lookups served from PSRAM or SD card */
+    uint32_t sd_hits;       /*!< Part of `hits` served from the SD card */
+    uint32_t misses;        /*!< Lookups that needed a download */
+    uint32_t evictions;     /*!< Entries dropped from either tier to make room */
+} app_tts_cache_stats_t;
+
+/**
+ * @brief Init the TTS audio cache, mounting the SD card when the SD tier is enabled.
+ *
+ * @return
+ *    - ESP_OK: Success, the SD tier may still be disabled if no card is present
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_tts_cache_init(void);
+
+/**
+ * @brief Cache key of a URL or reply text.
+ *
+ * @param str: Bytes to hash
+ * @param len: Number of bytes
+ *
+ * @return 32-bit FNV-1a hash
+ */
+uint32_t app_tts_cache_key(const char *str, size_t len);
+
+/**
+ * @brief Open a cached MP3 for reading.
+ *
+ * The FILE can be passed to the player like a downloaded stream. A PSRAM
+ * entry stays valid until the FILE is closed, even if it is evicted meanwhile.
+ *
+ * @param key: Cache key
+ *
+ * @return FILE pointer, NULL on a miss
+ */
+FILE *app_tts_cache_open(uint32_t key);
+
+/**
+ * @brief Add a completely downloaded MP3 to the cache.
+ *
+ * @param key: Cache key
+ * @param data: MP3 data allocated with heap_caps_malloc, ownership passes to the cache
+ * @param len: Size of the data
+ */
+void app_tts_cache_insert(uint32_t key, uint8_t *data, size_t len);
+
+/**
+ * @brief Get the cache counters.
+ *
+ * @param stats: Output
+ */
+void app_tts_cache_get_stats(app_tts_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,205 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "app_turn.h"
+
+static const char *TAG = "app_turn";
+
+#define TURN_TRANSFER_MAX       (8)     /*!< Chat request plus the TTS prefetch tasks */
+#define TURN_POLL_MS            (100)   /*!< Socket read timeout, how soon a blocked read notices the cancel */
+
+typedef struct {
+    esp_http_client_handle_t client;
+    app_turn_id_t turn;
+} turn_transfer_t;
+
+static volatile app_turn_id_t turn_current = 0;
+static turn_transfer_t turn_transfers[TURN_TRANSFER_MAX];
+static SemaphoreHandle_t turn_lock = NULL;
+static app_turn_cancel_cb_t turn_cancel_cb = NULL;
+static void *turn_cancel_ctx = NULL;
+static app_turn_id_t turn_draining = 0;         /*!< Cancelled turn with transfers still returning */
+static int turn_draining_count = 0;
+static int64_t turn_cancel_time = 0;
+static app_turn_stats_t turn_stats = {0};
+static app_arena_handle_t turn_arena = NULL;
+
+esp_err_t app_turn_init(app_turn_cancel_cb_t cancel_cb, void *ctx)
+{
+    if (turn_lock == NULL) {
+        turn_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(turn_lock, ESP_ERR_NO_MEM, TAG, "create lock failed");
+    }
+    if (turn_arena == NULL) {
+        // 一轮对话的临时缓冲区都在这一块中分配, 不再在 PSRAM 中留下碎片
+        turn_arena = app_arena_create(CONFIG_TURN_ARENA_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_RETURN_ON_FALSE(turn_arena, ESP_ERR_NO_MEM, TAG, "create arena failed");
+    }
+    turn_cancel_cb = cancel_cb;
+    turn_cancel_ctx = ctx;
+    return ESP_OK;
+}
+
+app_turn_id_t app_turn_begin(void)
+{
+    xSemaphoreTake(turn_lock, portMAX_DELAY);
+    app_turn_id_t old = turn_current;
+    turn_current = old + 1;
+    turn_stats.turns++;
+
+    // 上一轮仍在进行的传输由各自的任务在下一次读超时时发现取消, 自己关闭连接;
+    // 这里不碰这些连接, 它们的 TLS 上下文可能正被读写
+    int aborted = 0;
+    for (int i = 0; i < TURN_TRANSFER_MAX; i++) {
+        turn_transfer_t *transfer = &turn_transfers[i];
+        if (transfer->client && transfer->turn != turn_current) {
+            aborted++;
+        }
+    }
+    if (aborted) {
+        turn_draining = old;
+        turn_draining_count = aborted;
+        turn_cancel_time = esp_timer_get_time();
+        turn_stats.cancelled++;
+        turn_stats.aborted += aborted;
+    }
+    xSemaphoreGive(turn_lock);
+
+    // 上一轮的缓冲区全部释放后整体回收
+    app_arena_reset(turn_arena);
+    if (turn_cancel_cb) {
+        turn_cancel_cb(old, turn_cancel_ctx);
+    }
+    ESP_LOGI(TAG, "turn %" PRIu32 " begin, %d transfers of turn %" PRIu32 " aborted", old + 1, aborted, old);
+    return old + 1;
+}
+
+app_turn_id_t app_turn_current(void)
+{
+    return turn_current;
+}
+
+bool app_turn_is_current(app_turn_id_t turn)
+{
+    return turn == turn_current;
+}
+
+bool app_turn_cancelled(app_turn_id_t turn)
+{
+    return !app_turn_is_current(turn);
+}
+
+esp_err_t app_turn_attach(app_turn_id_t turn, esp_http_client_handle_t client)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    xSemaphoreTake(turn_lock, portMAX_DELAY);
+    if (app_turn_cancelled(turn)) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        for (int i = 0; i < TURN_TRANSFER_MAX; i++) {
+            if (turn_transfers[i].client == NULL) {
+                turn_transfers[i].client = client;
+                turn_transfers[i].turn = turn;
+                ret = ESP_OK;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(turn_lock);
+    if (ESP_ERR_NO_MEM == ret) {
+        ESP_LOGW(TAG, "no free transfer slot, turn %" PRIu32 " transfer cannot be aborted", turn);
+    }
+    return ret;
+}
+
+void app_turn_detach(esp_http_client_handle_t client)
+{
+    xSemaphoreTake(turn_lock, portMAX_DELAY);
+    for (int i = 0; i < TURN_TRANSFER_MAX; i++) {
+        turn_transfer_t *transfer = &turn_transfers[i];
+        if (transfer->client != client) {
+            continue;
+        }
+        // 被取消的一轮最后一个传输返回时, 记录取消耗时
+        if (turn_draining_count && transfer->turn == turn_draining && --turn_draining_count == 0) {
+            uint32_t drain_us = esp_timer_get_time() - turn_cancel_time;
+            turn_stats.drain_max_us = MAX(turn_stats.drain_max_us, drain_us);
+            ESP_LOGI(TAG, "turn %" PRIu32 " drained in %" PRIu32 " us", turn_draining, drain_us);
+        }
+        transfer->client = NULL;
+        break;
+    }
+    xSemaphoreGive(turn_lock);
+}
+
+int app_turn_http_read(app_turn_id_t turn, esp_http_client_handle_t client, char *buf, int len, uint32_t timeout_ms)
+{
+    esp_http_client_set_timeout_ms(client, TURN_POLL_MS);
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (1) {
+        int64_t start = esp_timer_get_time();
+        int ret = esp_http_client_read(client, buf, len);
+        if (ret > 0 || (ret < 0 && ret != -ESP_ERR_HTTP_EAGAIN)) {
+            return ret;
+        }
+        // 读完, 或者没等满超时就返回 0: 对端已关闭
+        if (ret == 0 && (esp_http_client_is_complete_data_received(client) ||
+                         esp_timer_get_time() - start < TURN_POLL_MS * 1000 / 2)) {
+            return 0;
+        }
+        if (app_turn_cancelled(turn)) {
+            return -ESP_ERR_INVALID_STATE;
+        }
+        if (esp_timer_get_time() >= deadline) {
+            return -ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+void *app_turn_alloc(size_t size)
+{
+    if (turn_arena == NULL) {
+        return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    return app_arena_alloc(turn_arena, size);
+}
+
+char *app_turn_strndup(const char *str, size_t n)
+{
+    if (turn_arena == NULL) {
+        return strndup(str, n);
+    }
+    return app_arena_strndup(turn_arena, str, n);
+}
+
+void app_turn_free(void *ptr)
+{
+    if (turn_arena == NULL) {
+        free(ptr);
+        return;
+    }
+    app_arena_free(turn_arena, ptr);
+}
+
+void app_turn_get_stats(app_turn_stats_t *stats)
+{
+    xSemaphoreTake(turn_lock, portMAX_DELAY);
+    *stats = turn_stats;
+    xSemaphoreGive(turn_lock);
+    if (turn_arena) {
+        app_arena_get_stats(turn_arena, &stats->arena);
+    }
+}
@@ -0,0 +1,164 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "app_arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Id of a conversation turn, the token every piece of work of that turn carries.
+ *
+ * A turn is cancelled as soon as a newer one begins. Work holding an older
+ * id stops at its next check and its results are dropped.
+ */
+typedef uint32_t app_turn_id_t;
+
+typedef void (*app_turn_cancel_cb_t)(app_turn_id_t turn, void *ctx);
+
+typedef struct {
+    uint32_t turns;             /*!< Turns begun */
+    uint32_t cancelled;         /*!< Turns cancelled with transfers in flight */
+    uint32_t aborted;           /*!< HTTP transfers in flight when their turn was cancelled */
+    uint32_t drain_max_us;      /*!< Longest time from cancel until the last transfer of the turn returned */
+    app_arena_stats_t arena;    /*!< Turn arena */
+} app_turn_stats_t;
+
+/**
+ * @brief Init the turn tracker.
+ *
+ * @param cancel_cb: Called when a turn is cancelled, to drain queues and stop playback, may be NULL
+ * @param ctx: User context of `cancel_cb`
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_turn_init(app_turn_cancel_cb_t cancel_cb, void *ctx);
+
+/**
+ * @brief Begin a new turn, cancelling the current one.
+ *
+ * Never waits and never touches the clients of the cancelled turn: their
+ * tasks notice the cancel within one app_turn_http_read poll and close the
+ * connections themselves. The cancel callback runs in the calling task.
+ *
+ * @return id of the new turn
+ */
+app_turn_id_t app_turn_begin(void);
+
+/**
+ * @brief Get the current turn.
+ */
+app_turn_id_t app_turn_current(void);
+
+/**
+ * @brief Check that work tagged with `turn` still belongs to the conversation.
+ *
+ * @param turn: Turn id taken when the work was queued
+ *
+ * @return true if `turn` is the current turn
+ */
+bool app_turn_is_current(app_turn_id_t turn);
+
+/**
+ * @brief Check a cancellation token.
+ *
+ * @param turn: Turn id
+ *
+ * @return true if `turn` is no longer the current turn
+ */
+bool app_turn_cancelled(app_turn_id_t turn);
+
+/**
+ * @brief Register an HTTP transfer of a turn, to time how long a cancelled turn takes to drain.
+ *
+ * @param turn: Turn id
+ * @param client: Client about to open the request
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Turn already cancelled, do not start the transfer
+ *    - ESP_ERR_NO_MEM: Too many transfers, the transfer runs without abort
+ */
+esp_err_t app_turn_attach(app_turn_id_t turn, esp_http_client_handle_t client);
+
+/**
+ * @brief Unregister an HTTP transfer, before releasing its client.
+ *
+ * @param client: Client passed to app_turn_attach
+ */
+void app_turn_detach(esp_http_client_handle_t client);
+
+/**
+ * @brief Read the response body of a transfer, returning early once the turn is cancelled.
+ *
+ * Polls with a short socket timeout instead of blocking for the whole
+ * `timeout_ms`, so no other task ever has to close the connection under
+ * the reader. Changes the client timeout; after a cancel or a timeout the
+ * connection must not be reused.
+ *
+ * @param turn: Turn id of the transfer
+ * @param client: Client with the response headers fetched
+ * @param buf: Buffer
+ * @param len: Buffer size
+ * @param timeout_ms: Longest wait for data
+ *
+ * @return
+ *    - > 0: Bytes read
+ *    - 0: End of the response or connection closed, check esp_http_client_is_complete_data_received
+ *    - -ESP_ERR_INVALID_STATE: Turn cancelled
+ *    - -ESP_ERR_TIMEOUT: No data within `timeout_ms`
+ *    - < 0: Other read error
+ */
+int app_turn_http_read(app_turn_id_t turn, esp_http_client_handle_t client, char *buf, int len, uint32_t timeout_ms);
+
+/**
+ * @brief Allocate a buffer that lives at most until the turn is over, from the turn arena.
+ *
+ * The arena is rewound when a new turn begins, once every buffer of the
+ * older turns has been freed with app_turn_free.
+ *
+ * @param size: Size in bytes
+ *
+ * @return buffer in PSRAM, NULL if out of memory
+ */
+void *app_turn_alloc(size_t size);
+
+/**
+ * @brief Copy at most `n` characters of a string into the turn arena.
+ *
+ * @param str: String
+ * @param n: Maximum length
+ *
+ * @return NUL terminated copy, free with app_turn_free
+ */
+char *app_turn_strndup(const char *str, size_t n);
+
+/**
+ * @brief Free a buffer from app_turn_alloc or app_turn_strndup, NULL is ignored.
+ *
+ * @param ptr: Buffer
+ */
+void app_turn_free(void *ptr);
+
+/**
+ * @brief Get the turn counters.
+ *
+ * @param stats: Output
+ */
+void app_turn_get_stats(app_turn_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,9 @@
 
 #include "app_ui_ctrl.h"
 #include "app_wifi.h"
+#include "app_turn.h"
+#include "app_telemetry.h"
+#include "app_event.h"
 #include "bsp/esp-bsp.h"
 
 #include "ui_helpers.h"
@@ -19,17 +22,20 @@
 #define WIFI_CHECK_TIMER_INTERVAL_S     (1)
 #define REPLY_SCROLL_TIMER_INTERVAL_MS  (1000)
 #define REPLY_SCROLL_SPEED              (1)
+#define REPLY_AUDIO_EVENT_DEPTH         (16)
 
 static char *TAG = "ui_ctrl";
 
 static ui_ctrl_panel_t current_panel = UI_CTRL_PANEL_SLEEP;
 static lv_timer_t *scroll_timer_handle = NULL;
-static bool reply_audio_start = false;
+static app_event_sub_handle_t reply_audio_sub = NULL;
+static bool reply_audio_start = false;      /*!< Updated from reply_audio_sub in the LVGL task only */
 static bool reply_audio_end = false;
 static bool reply_content_get = false;
 static uint16_t content_height = 0;
 
 static void reply_content_scroll_timer_handler();
+static void reply_audio_event_update(void);
 static void wifi_check_timer_handler(lv_timer_t *timer);
 
 // 初始化UI控制
@@ -39,6 +45,8 @@ void ui_ctrl_init(void)
 
     ui_init();
 
+    reply_audio_sub = app_event_subscribe(APP_EVENT_BIT(APP_EVENT_REPLY_AUDIO_START) | APP_EVENT_BIT(APP_EVENT_REPLY_AUDIO_END),
+                                          REPLY_AUDIO_EVENT_DEPTH);
     scroll_timer_handle = lv_timer_create(reply_content_scroll_timer_handler, REPLY_SCROLL_TIMER_INTERVAL_MS / REPLY_SCROLL_SPEED, NULL);
     lv_timer_pause(scroll_timer_handle);
 
@@ -92,7 +100,8 @@ static void show_panel_timer_handler(struct _lv_timer_t *t)
         hide_panel[2] = ui_PanelReply;
         lv_obj_clear_flag(ui_LabelListenSpeak, LV_OBJ_FLAG_HIDDEN);
         lv_label_set_text(ui_LabelListenSpeak, "Listening ...");
-        // Reset flags and timer of reply
+        // Reset flags and timer of reply, events of the last reply are discarded
+        reply_audio_event_update();
         reply_content_get = false;
         reply_audio_start = false;
         reply_audio_end = false;
@@ -159,33 +168,34 @@ static void reply_content_show_text(const char *text)
         return;
     }
 
-    char *decode = heap_caps_malloc((strlen(text) + 1), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    assert(decode);
-
-    int j = 0;
-    for (int i = 0; i < strlen(text);) {
-        if ((*(text + i) == '\\') && ((i + 1) < strlen(text)) && (*(text + i + 1) == 'n')) {
-            *(decode + j++) = '\n';
-            i += 2;
-        } else {
-            *(decode + j++) = *(text + i);
-            i += 1;
+    // 标签会复制文本, 解码结果只是临时缓冲区
+    char *decode = app_turn_alloc(strlen(text) + 1);
+    if (decode) {
+        int j = 0;
+        for (int i = 0; i < strlen(text);) {
+            if ((*(text + i) == '\\') && ((i + 1) < strlen(text)) && (*(text + i + 1) == 'n')) {
+                *(decode + j++) = '\n';
+                i += 2;
+            } else {
+                *(decode + j++) = *(text + i);
+                i += 1;
+            }
         }
+        *(decode + j) = '\0';
+        ESP_LOGI(TAG, "decode:[%d, %d] %s\r\n", j, strlen(decode), decode);
+    } else {
+        // 内存不足时直接显示未解码的文本
+        app_telemetry_oom(APP_TELEMETRY_OOM_UI_TEXT);
     }
-    *(decode + j) = '\0';
 
-    ESP_LOGI(TAG, "decode:[%d, %d] %s\r\n", j, strlen(decode), decode);
-
-    lv_label_set_text(ui_LabelReplyContent, decode);
+    lv_label_set_text(ui_LabelReplyContent, decode ? decode : text);
     content_height = lv_obj_get_self_height(ui_LabelReplyContent);
     lv_obj_scroll_to_y(ui_ContainerReplyContent, 0, LV_ANIM_OFF);
     reply_content_get = true;
     lv_timer_resume(scroll_timer_handle);
     ESP_LOGI(TAG, "reply scroll timer start");
 
-    if (decode) {
-        free(decode);
-    }
+    app_turn_free(decode);
 }
 
 // 更新标签文本
@@ -277,22 +287,18 @@ void ui_sleep_show_animation(void)
     bsp_display_unlock();
 }
 
-// 设置回复音频开始标志
-void ui_ctrl_reply_set_audio_start_flag(bool result)
-{
-    reply_audio_start = result;
-}
-
-// 获取回复音频开始标志
-bool ui_ctrl_reply_get_audio_start_flag(void)
-{
-    return reply_audio_start;
-}
-
-// 设置回复音频结束标志
-void ui_ctrl_reply_set_audio_end_flag(bool result)
+// 取出播放任务发布的回复音频事件, 标志只在 LVGL 任务中读写
+static void reply_audio_event_update(void)
 {
-    reply_audio_end = result;
+    app_event_t event;
+    while (reply_audio_sub && app_event_receive(reply_audio_sub, &event)) {
+        if (APP_EVENT_REPLY_AUDIO_START == event.type) {
+            reply_audio_start = true;
+            reply_audio_end = false;
+        } else if (reply_audio_start) {
+            reply_audio_end = true;
+        }
+    }
 }
 
 // 回复内容滚动定时器处理函数
@@ -301,6 +307,7 @@ static void reply_content_scroll_timer_handler()
     lv_coord_t offset = 0;
     const lv_font_t *font = NULL;
 
+    reply_audio_event_update();
     if (reply_content_get && reply_audio_start) {
         font = lv_obj_get_style_text_font(ui_LabelReplyContent, 0);
         offset = lv_obj_get_scroll_y(ui_ContainerReplyContent);
@@ -33,12 +33,6 @@ void ui_ctrl_label_show_text(ui_ctrl_label_t label, const char *text);
 
 void ui_sleep_show_animation(void);
 
-void ui_ctrl_reply_set_audio_start_flag(bool result);
-
-bool ui_ctrl_reply_get_audio_start_flag(void);
-
-void ui_ctrl_reply_set_audio_end_flag(bool result);
-
 void ui_ctrl_guide_jump(void);
 
 #ifdef __cplusplus
@@ -5,6 +5,7 @@
  */
 
 #include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -19,6 +20,8 @@
 #include "lwip/sys.h"
 
 #include "app_wifi.h"
+#include "app_event.h"
+#include "app_telemetry.h"
 #include "esp_timer.h"
 
 #define EXAMPLE_ESP_MAXIMUM_RETRY CONFIG_ESP_MAXIMUM_RETRY
@@ -32,11 +35,10 @@ static EventGroupHandle_t s_wifi_event_group;
 #define PASSWORD_SIZE 64
 
 static const char *TAG = "wifi station";
-static int s_retry_num = 0;
+static atomic_int s_retry_num = 0;     // 事件循环, 网络任务和重连定时器都会修改
 static bool s_reconnect = true;
 static bool s_connectting = false;
 static esp_timer_handle_t s_recon_timer = NULL;
-static bool wifi_connected = false;
 static QueueHandle_t wifi_event_queue = NULL;
 static char s_wifi_ssid[SSID_SIZE];
 static char s_wifi_password[PASSWORD_SIZE];
@@ -48,26 +50,29 @@ static scan_info_t scan_info_result = {
 
 static void (*__wifi_event)(net_event_t) = NULL;
 
-// 检查WiFi是否已连接
+// 检查WiFi是否已连接, 状态由事件总线保存, 任何任务都可以读取
 WiFi_Connect_Status wifi_connected_already(void)
+{
+    return (WiFi_Connect_Status)app_event_value(APP_EVENT_WIFI);
+}
+
+// 发布连接状态, 未连接时按重试次数区分连接中和连接失败
+static void wifi_status_publish(bool connected)
 {
     WiFi_Connect_Status status;
-    if (true == wifi_connected)
+    if (connected)
     {
         status = WIFI_STATUS_CONNECTED_OK;
     }
+    else if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY)
+    {
+        status = WIFI_STATUS_CONNECTING;
+    }
     else
     {
-        if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY)
-        {
-            status = WIFI_STATUS_CONNECTING;
-        }
-        else
-        {
-            status = WIFI_STATUS_CONNECTED_FAILED;
-        }
+        status = WIFI_STATUS_CONNECTED_FAILED;
     }
-    return status;
+    app_event_publish(APP_EVENT_WIFI, status);
 }
 
 // 发送网络事件
@@ -194,6 +199,7 @@ static esp_err_t poweron_connect()
 static void recon_timer_callback(void *arg)
 {
     s_retry_num = 0;
+    wifi_status_publish(false);
     esp_wifi_connect();
     ESP_LOGI(TAG, "reconnect wifi");
 }
@@ -229,7 +235,7 @@ static void event_handler(void *arg, esp_event_base_t event_base,
         }
         xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        wifi_connected = false;
+        wifi_status_publish(false);
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
@@ -240,7 +246,7 @@ static void event_handler(void *arg, esp_event_base_t event_base,
             ESP_ERROR_CHECK(esp_timer_stop(s_recon_timer));
 
         s_retry_num = 0;
-        wifi_connected = true;
+        wifi_status_publish(true);
         s_connectting = false;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         send_network_event(NET_EVENT_CONNECTED);
@@ -260,8 +266,8 @@ static void network_task(void *args)
             {
             case NET_EVENT_RECONNECT:
                 ESP_LOGI(TAG, "NET_EVENT_RECONNECT");
-                wifi_connected = false;
                 s_retry_num = 0;
+                wifi_status_publish(false);
                 wifi_reconnect_sta();
                 break;
 
@@ -272,8 +278,8 @@ static void network_task(void *args)
 
             case NET_EVENT_POWERON:
                 ESP_LOGI(TAG, "NET_EVENT_POWERON_SCAN");
-                wifi_connected = false;
                 s_retry_num = 0;
+                wifi_status_publish(false);
                 poweron_connect();
                 break;
 
@@ -375,6 +381,8 @@ void app_network_start(void (*wifi_event)(net_event_t))
     };
     ESP_ERROR_CHECK(esp_timer_create(&recon_timer_args, &s_recon_timer));
 
-    ret_val = xTaskCreatePinnedToCore(network_task, "NetWork Task", 5 * 1024, NULL, 1, NULL, 0);
+    TaskHandle_t network = NULL;
+    ret_val = xTaskCreatePinnedToCore(network_task, "NetWork Task", 5 * 1024, NULL, 1, &network, 0);
     ESP_ERROR_CHECK_WITHOUT_ABORT((pdPASS == ret_val) ? ESP_OK : ESP_FAIL);
+    app_telemetry_add_task("NetWork Task", network);
 }
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_worker.h"
+#include "app_telemetry.h"
+
+static const char *TAG = "app_worker";
+
+#define WORKER_MAX      (12)
+
+typedef struct {
+    const char *name;
+    TaskHandle_t handle;
+    uint32_t stack_size;
+} worker_t;
+
+static worker_t workers[WORKER_MAX];
+static app_worker_stats_t worker_stats = {0};
+
+static esp_err_t worker_create(const app_worker_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(worker_stats.count < WORKER_MAX, ESP_ERR_NO_MEM, TAG, "too many workers, %s not started", config->name);
+    // 名字超长时 FreeRTOS 会截断, 部分版本直接断言
+    ESP_RETURN_ON_FALSE(strlen(config->name) < configMAX_TASK_NAME_LEN, ESP_ERR_INVALID_ARG, TAG, "task name %s too long", config->name);
+
+    // 任务控制块必须在内部 RAM, 栈按配置放置
+    StaticTask_t *tcb = heap_caps_calloc(1, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    StackType_t *stack = heap_caps_malloc(config->stack_size, config->stack_caps);
+    if (tcb == NULL || stack == NULL) {
+        heap_caps_free(tcb);
+        heap_caps_free(stack);
+        ESP_LOGE(TAG, "no memory for %s, %" PRIu32 " bytes stack", config->name, config->stack_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(config->fn, config->name, config->stack_size, config->arg,
+                                                        config->priority, stack, tcb, config->core);
+    worker_t *worker = &workers[worker_stats.count++];
+    worker->name = config->name;
+    worker->handle = handle;
+    worker->stack_size = config->stack_size;
+    app_telemetry_add_task(config->name, handle);
+    if (config->stack_caps & MALLOC_CAP_SPIRAM) {
+        worker_stats.stack_spiram += config->stack_size;
+    } else {
+        worker_stats.stack_internal += config->stack_size;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_worker_start(const app_worker_config_t *config, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        ESP_RETURN_ON_ERROR(worker_create(&config[i]), TAG, "start workers failed");
+    }
+    ESP_LOGI(TAG, "%" PRIu32 " workers, stacks %" PRIu32 " bytes internal, %" PRIu32 " bytes psram",
+             worker_stats.count, worker_stats.stack_internal, worker_stats.stack_spiram);
+    return ESP_OK;
+}
+
+void app_worker_get_stats(app_worker_stats_t *stats)
+{
+    *stats = worker_stats;
+}
+
+void app_worker_log(void)
+{
+    ESP_LOGI(TAG, "%" PRIu32 " workers, stacks %" PRIu32 " bytes internal, %" PRIu32 " bytes psram",
+             worker_stats.count, worker_stats.stack_internal, worker_stats.stack_spiram);
+    for (int i = 0; i < worker_stats.count; i++) {
+        uint32_t unused = uxTaskGetStackHighWaterMark(workers[i].handle) * sizeof(StackType_t);
+        ESP_LOGI(TAG, "  %s: stack used %" PRIu32 "/%" PRIu32, workers[i].name,
+                 workers[i].stack_size - unused, workers[i].stack_size);
+    }
+}
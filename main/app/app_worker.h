@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *name;
+    TaskFunction_t fn;
+    void *arg;
+    uint32_t stack_size;        /*!< Stack size in bytes */
+    UBaseType_t priority;
+    BaseType_t core;            /*!< Core to pin to, tskNO_AFFINITY to let the scheduler choose */
+    uint32_t stack_caps;        /*!< heap_caps flags of the stack, PSRAM only for tasks that never touch flash */
+} app_worker_config_t;
+
+typedef struct {
+    uint32_t count;             /*!< Workers running */
+    uint32_t stack_internal;    /*!< Stack bytes in internal RAM */
+    uint32_t stack_spiram;      /*!< Stack bytes in PSRAM */
+} app_worker_stats_t;
+
+/**
+ * @brief Start the workers of a table, once at boot.
+ *
+ * Stack and task control block of each worker are allocated once with
+ * xTaskCreateStatic and never freed; workers wait on their queues for
+ * work instead of being created per request.
+ *
+ * @param config: Worker table
+ * @param count: Number of entries
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Out of memory or too many workers, the workers before it are running
+ */
+esp_err_t app_worker_start(const app_worker_config_t *config, size_t count);
+
+/**
+ * @brief Get the worker counters.
+ *
+ * @param stats: Output
+ */
+void app_worker_get_stats(app_worker_stats_t *stats);
+
+/**
+ * @brief Log the worker count and the stack use of every worker.
+ */
+void app_worker_log(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,9 @@
  * SPDX-License-Identifier: CC0-1.0
  */
 #include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -22,26 +25,49 @@
 #include "app_wifi.h"
 #include "app_uart.h"
 #include "app_ui_ctrl.h"
+#include "app_sse.h"
+#include "app_stream.h"
+#include "app_multipart.h"
+#include "app_http_pool.h"
+#include "app_tts_cache.h"
+#include "app_prompt.h"
+#include "app_mixer.h"
+#include "app_turn.h"
+#include "app_replay.h"
+#include "app_telemetry.h"
+#include "app_worker.h"
+#include "app_event.h"
 
 
 #include "esp_peripherals.h"
 #include "board.h"
 
 #define AUDIO_PLAY_FINAL_BIT BIT0
-static size_t _http_data_len = 0;
+#define TTS_STREAM_BUFFER_SIZE  (CONFIG_TTS_STREAM_BUFFER_SIZE)
+#define TTS_STREAM_TIMEOUT_MS   (60000)
+#define TTS_PREFETCH_DEPTH      (CONFIG_TTS_PREFETCH_DEPTH)
+#if CONFIG_PIPELINE_STACK_PSRAM
+#define NET_WORKER_STACK_CAPS   (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#else
+#define NET_WORKER_STACK_CAPS   (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+#define TTS_CACHE_ENTRY_MAX_SIZE    (CONFIG_TTS_CACHE_ENTRY_MAX_SIZE)
+#define TTS_LINEAR_PSRAM_RESERVE    (1024 * 1024)   /*!< PSRAM left free when a whole segment is larger than the ring */
 
 static char *TAG = "app_main";
 
 static QueueHandle_t mp3_data_queue = NULL;
+static volatile bool mp3_play_holding = false;  /*!< Play task took a segment off the queue and has not started it yet */
+
+static void chat_reply_audio_end_check(void);
 static EventGroupHandle_t audio_play_event_group = NULL;
-static SemaphoreHandle_t audio_semaphore;
-static char *player_data = NULL;
 
 typedef enum
 {
     WIFI_CONNECT_CMD = 0,
     WIFI_STATE_CMD,
     CHATGPT_RESPONSE_CMD,
+    TELEMETRY_CMD,
 } uart_cmd_t;
 
 typedef struct
@@ -55,77 +81,10 @@ typedef struct
 
 typedef struct
 {
-    char *mp3_data;
-    size_t mp3_len;
+    FILE *fp;               /*!< MP3 source, either a download stream or a local file */
+    app_turn_id_t turn;     /*!< Turn the segment belongs to, dropped once that turn is cancelled */
 } mp3_data_t;
 
-// HTTP事件处理函数
-esp_err_t _http_event_handler(esp_http_client_event_t *evt)
-{
-    static char *data = NULL;   // 用于存储接收到的数据
-    static int data_len = 0;    // 数据长度
-
-    switch (evt->event_id)
-    {
-    case HTTP_EVENT_ERROR:
-        ESP_LOGD(TAG, "HTTP_EVENT_ERROR");  // 处理HTTP错误事件
-        break;
-    case HTTP_EVENT_ON_CONNECTED:
-        ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");   // 处理HTTP连接成功事件
-        break;
-    case HTTP_EVENT_HEADER_SENT:
-        ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");    // 处理HTTP头部发送事件
-        break;
-    case HTTP_EVENT_ON_HEADER:
-        ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);    // 处理HTTP头部接收事件
-        break;
-    case HTTP_EVENT_ON_DATA:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA (%d +)%d", data_len, evt->data_len);  // 处理HTTP数据接收事件
-        ESP_LOGI(TAG, "Raw Response: data length: (%d +)%d: %.*s", data_len, evt->data_len, evt->data_len, (char *)evt->data);  // 打印接收到的原始数据
-
-        // 重新分配内存以存储接收到的数据
-        data = heap_caps_realloc(data, data_len + evt->data_len + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (data == NULL)
-        {
-            ESP_LOGE(TAG, "data realloc failed");   // 内存重新分配失败
-            free(data);     // 释放内存
-            data = NULL;
-            assert(0);      // 断言失败
-
-            break;
-        }
-        // 将接收到的数据复制到data中
-        memcpy(data + data_len, (char *)evt->data, evt->data_len);
-        data_len += evt->data_len;      // 更新数据长度
-        data[data_len] = '\0';          // 添加字符串结束符
-        // printf("%s\r\n", data);      // 打印接收到的数据
-        break;
-
-    case HTTP_EVENT_ON_FINISH:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH");      // 处理HTTP请求完成事件
-        esp_http_client_set_user_data(evt->client, data);   // 将接收到的数据设置为用户数据
-        _http_data_len = data_len;      // 更新全局数据长度
-        break;
-
-    case HTTP_EVENT_DISCONNECTED:
-        ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");   // 处理HTTP断开连接事件
-        printf("---%d---\r\n", data_len);       // 打印数据长度
-        if (data != NULL)
-        {
-            free(data);     // 释放内存
-            data = NULL;
-            data_len = 0;   // 重置数据长度
-        }
-
-        break;
-
-    case HTTP_EVENT_REDIRECT:
-        ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");   // 处理HTTP重定向事件
-        break;
-    }
-    return ESP_OK;
-}
-
 // 检查文件是否为MP3文件
 static bool app_is_mp3(FILE *fp)
 {
@@ -196,54 +155,118 @@ int mp3_data_queue_send(mp3_data_t data)
 // MP3播放任务
 static void app_mp3_play_task(void *args)
 {
-    FILE *fp = NULL;
     mp3_data_t mp3_data;
     while (1)
     {
-        // 从队列中接收MP3数据
-        if (xQueueReceive(mp3_data_queue, &mp3_data, portMAX_DELAY) == pdPASS)
+        // 从队列中接收MP3数据; 先标记再取出, 判断回复是否播完时这一段不会被漏掉
+        if (xQueuePeek(mp3_data_queue, &mp3_data, portMAX_DELAY) == pdPASS)
         {
+            mp3_play_holding = true;
+            if (xQueueReceive(mp3_data_queue, &mp3_data, 0) != pdPASS)
+            {
+                // 取消时的清空抢先取走了这一段
+                mp3_play_holding = false;
+                continue;
+            }
             // 等待音频播放完成事件
             xEventGroupWaitBits(audio_play_event_group, AUDIO_PLAY_FINAL_BIT, 0, 1, portMAX_DELAY);
-            player_data = (char *)heap_caps_calloc(mp3_data.mp3_len, sizeof(char), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (player_data == NULL)
+            if (app_turn_cancelled(mp3_data.turn))
             {
-                ESP_LOGE(TAG, "no memory to mp3 player");
-                assert(0);
+                // 等待期间回复被打断
+                fclose(mp3_data.fp);
+                mp3_play_holding = false;
+                continue;
             }
-            memset(player_data, 0, mp3_data.mp3_len); // 将 player_data 置为 0
-            memcpy(player_data, mp3_data.mp3_data, mp3_data.mp3_len);   // 复制MP3数据到 player_data
-            fp = fmemopen(player_data, mp3_data.mp3_len, "rb"); // 打开内存中的MP3数据作为文件
-            if (fp)
+            // 下载流会阻塞在这里直到收到文件头, 无需等待下载完成
+            if (!app_is_mp3(mp3_data.fp))
             {
-                if (app_is_mp3(fp))
-                {
-                    ESP_LOGI(TAG, "it is mp3 data \n");
-                    esp_err_t status = audio_player_play(fp);   // 播放MP3数据
-                    if (status != ESP_OK)
-                    {
-                        ESP_LOGE(TAG, "tts mp3 play error \n");
-                    }
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "no mp3 data \n");
-                    break;
-                }
+                ESP_LOGE(TAG, "no mp3 data");
+                fclose(mp3_data.fp);
+                mp3_play_holding = false;
+                chat_reply_audio_end_check();
+                continue;
             }
+
+            ESP_LOGI(TAG, "it is mp3 data");
             xEventGroupClearBits(audio_play_event_group, AUDIO_PLAY_FINAL_BIT); // 清除音频播放完成事件位
+            mp3_play_holding = false;
+            // 播放器在播放结束后关闭文件
+            esp_err_t status = audio_player_play(mp3_data.fp);
+            if (status != ESP_OK)
+            {
+                ESP_LOGE(TAG, "tts mp3 play error");
+                fclose(mp3_data.fp);
+                xEventGroupSetBits(audio_play_event_group, AUDIO_PLAY_FINAL_BIT);
+                chat_reply_audio_end_check();
+            }
+            else
+            {
+                app_event_publish(APP_EVENT_REPLY_AUDIO_START, 0);
+            }
         }
     }
     vTaskDelete(NULL);
 }
 
-#define MAX_HTTP_OUTPUT_BUFFER 8192
-static int response_len = 0;
-static char response_buffer[MAX_HTTP_OUTPUT_BUFFER] = {0};
-
 #define POST_URL "http://productID.llm.aiha.cloud/dsse/llm_allInOne/deviceID"
 //使用前需将 productID 和 deviceID 替换为实际的值
 
+#define SSE_MAX_EVENT_SIZE      (4096)
+#define RECORD_UPLOAD_FORMAT    CONFIG_RECORD_UPLOAD_FORMAT
+#define RECORD_STREAM_WAIT_MS   (100)
+#define CHAT_READ_TIMEOUT_MS    (5000)
+#define REPLY_TEXT_MAX_SIZE     (4096)
+#define TTS_URL_QUEUE_LEN       (20)
+#define CHAT_VOLUME_STEP        (10)
+
+// 一次对话的回复内容
+typedef struct
+{
+    char *text;
+    size_t text_len;
+    size_t url_count;
+    app_turn_id_t turn;
+} chat_reply_t;
+
+// 一个待下载的语音段; url 为 NULL 时是播放完的整段, 由下载任务存入缓存
+typedef struct
+{
+    char *url;
+    uint32_t key;               /*!< TTS cache key */
+    app_stream_handle_t stream; /*!< Writer side, the reader is already queued for playback */
+    app_turn_id_t turn;
+    uint8_t *cache_data;        /*!< Whole segment handed to the cache, owned by the job */
+    size_t cache_len;
+} tts_job_t;
+
+// 一次对话请求, 交给对话任务执行
+typedef struct
+{
+    uint8_t *audio;             /*!< Recording, NULL when streaming */
+    int len;
+    bool streaming;             /*!< Upload while recording */
+    app_turn_id_t turn;         /*!< Turn that recorded the audio */
+} chat_job_t;
+
+// 一轮对话的状态, 用于判断唤醒时是否需要打断
+typedef enum
+{
+    CHAT_STATE_IDLE = 0,
+    CHAT_STATE_THINKING,    /*!< Request sent, waiting for the first segment */
+    CHAT_STATE_SPEAKING,    /*!< Reply segments queued or playing */
+} chat_state_t;
+
+static const char *chat_state_name[] = {"idle", "thinking", "speaking"};
+
+static chat_reply_t chat_reply = {0};
+static volatile chat_state_t chat_state = CHAT_STATE_IDLE;
+static portMUX_TYPE chat_state_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool chat_request_active = false;
+static uint32_t chat_last_keys[TTS_URL_QUEUE_LEN];    /*!< TTS cache keys of the last reply, for repeat */
+static size_t chat_last_key_count = 0;
+static app_sse_parser_handle_t sse_parser = NULL;
+static QueueHandle_t tts_url_queue = NULL;
+static QueueHandle_t chat_job_queue = NULL;
 
 // HTTP事件处理函数
 esp_err_t http_event_handler(esp_http_client_event_t *evt)
@@ -263,26 +286,12 @@ esp_err_t http_event_handler(esp_http_client_event_t *evt)
         ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
         break;
     case HTTP_EVENT_ON_DATA:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-        if (esp_http_client_is_chunked_response(evt->client))
-        {
-            // 将数据追加到响应缓冲区
-            if (response_len + evt->data_len < MAX_HTTP_OUTPUT_BUFFER)
-            {
-                memcpy(response_buffer + response_len, evt->data, evt->data_len);
-                response_len += evt->data_len;
-            }
-            else
-            {
-                ESP_LOGW(TAG, "Response buffer overflow");
-            }
-        }
+        ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+        // 边接收边解析, 每个完整的 data: 事件都会立即回调
+        app_sse_parser_feed(sse_parser, evt->data, evt->data_len);
         break;
     case HTTP_EVENT_ON_FINISH:
         ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH");
-        response_buffer[response_len] = 0;  // 添加字符串结束符
-        ESP_LOGI(TAG, "HTTP Response: %s", response_buffer);    // 打印HTTP响应
-        response_len = 0; // 重置响应长度
         break;
     case HTTP_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
@@ -294,257 +303,723 @@ esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-// MP3 URL信息结构体
-typedef struct
+// 发送请求并读取响应头, 复用的连接已被服务器关闭时重连一次
+static esp_err_t audio_request_open(esp_http_client_handle_t client, bool reused, int64_t *content_length)
+{
+    for (int attempt = 0; ; attempt++)
+    {
+        esp_err_t err = esp_http_client_open(client, 0);
+        if (err == ESP_OK)
+        {
+            *content_length = esp_http_client_fetch_headers(client);
+            if (*content_length >= 0)
+            {
+                return ESP_OK;
+            }
+            err = ESP_FAIL;
+        }
+        if (!reused || attempt > 0)
+        {
+            return err;
+        }
+        app_http_pool_reconnect(client);
+    }
+}
+
+// 完整下载且已播放完的语音段, 在播放任务中调用; 写缓存可能要写 SD 卡, 交给下载任务去做
+static void audio_stream_release_cb(uint8_t *buf, size_t len, void *ctx)
 {
-    char *url_mp3;
-    void *tts_data;
-    size_t output_len;
-} mp3_url_info_t;
+    tts_job_t job = {
+        .key = (uint32_t)(uintptr_t)ctx,
+        .cache_data = buf,
+        .cache_len = len,
+    };
+    if (xQueueSendToFront(tts_url_queue, &job, 0) != pdPASS)
+    {
+        heap_caps_free(buf);
+    }
+}
 
-// 发送音频请求
-void audio_request(mp3_url_info_t *result)
+// 整段下载省去一次拷贝, 但缓冲区按整段分配: 不超过环形缓冲区时不多占内存, 更大的段要求 PSRAM 有余量
+static bool audio_stream_use_linear(int64_t content_length)
 {
+    if (content_length <= 0 || content_length > TTS_CACHE_ENTRY_MAX_SIZE)
+    {
+        return false;
+    }
+    if (content_length <= TTS_STREAM_BUFFER_SIZE)
+    {
+        return true;
+    }
+    return heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) >= content_length + TTS_LINEAR_PSRAM_RESERVE;
+}
+
+// 下载TTS音频到流中, 播放任务已按顺序持有该流的读取端, 边下载边播放
+static esp_err_t audio_request(const char *url, uint32_t key, app_stream_handle_t stream, app_turn_id_t turn, size_t *received)
+{
+    esp_err_t ret = ESP_OK;
+    *received = 0;
+
     esp_http_client_config_t config = {
-        .url = result->url_mp3,
+        .url = url,
         .method = HTTP_METHOD_GET,
-        .event_handler = _http_event_handler,
-        .buffer_size = 128000,
-        .timeout_ms = 60000,
+        .timeout_ms = TTS_STREAM_TIMEOUT_MS,
         .crt_bundle_attach = esp_crt_bundle_attach,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    bool reused = false;
+    esp_http_client_handle_t client = app_http_pool_acquire(&config, &reused);
+    ESP_RETURN_ON_FALSE(client, ESP_FAIL, TAG, "speech client init failed");
+    ret = app_turn_attach(turn, client);
+    ESP_GOTO_ON_FALSE(ESP_ERR_INVALID_STATE != ret, ret, cleanup, TAG, "turn %" PRIu32 " cancelled", turn);
+    ret = ESP_OK;
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK)
+    int64_t content_length = -1;
+    ESP_GOTO_ON_ERROR(audio_request_open(client, reused, &content_length), cleanup, TAG, "speech GET request failed");
+
+    int status_code = esp_http_client_get_status_code(client);
+    ESP_GOTO_ON_FALSE(status_code == 200, ESP_ERR_INVALID_RESPONSE, cleanup, TAG,
+                      "speech GET Status = %d, content_length = %lld", status_code, content_length);
+    ESP_LOGI(TAG, "speech GET Status = %d, content_length = %lld", status_code, content_length);
+
+    // 长度已知且不太大时整段下载到一块缓冲区, 播放结束后这块缓冲区直接加入缓存
+    if (audio_stream_use_linear(content_length))
     {
-        ESP_LOGW(TAG, "speech POST request failed: %s\n", esp_err_to_name(err));
+        app_stream_set_linear(stream, content_length, audio_stream_release_cb, (void *)(uintptr_t)key);
     }
-    else
+
+    // 直接读入环形缓冲区, 缓冲区满时等待播放器消费
+    while (1)
     {
-        int status_code = esp_http_client_get_status_code(client);
-        int64_t content_length = esp_http_client_get_content_length(client);
-        if (status_code == 200)
-        {
-            ESP_LOGI(TAG, "speech POST Status = %d, content_length = %lld",
-                     status_code,
-                     content_length);
-            void *user_data = NULL;
-            esp_http_client_get_user_data(client, &user_data);
-            result->tts_data = heap_caps_calloc(sizeof(char), _http_data_len + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (result->tts_data == NULL)
-            {
-                ESP_LOGE(TAG, "Failed to allocate tts data");
-                assert(0);
-            }
+        ESP_GOTO_ON_FALSE(!app_turn_cancelled(turn), ESP_ERR_INVALID_STATE, cleanup, TAG, "turn %" PRIu32 " cancelled", turn);
+        // 已收完时不再申请写入空间: 整段缓冲区此时已写满, 要等这一段开始播放才有空间
+        if ((content_length > 0 && *received >= content_length) || esp_http_client_is_complete_data_received(client))
+        {
+            break;
+        }
+        uint8_t *ptr = NULL;
+        size_t space = 0;
+        ESP_GOTO_ON_ERROR(app_stream_write_acquire(stream, &ptr, &space, pdMS_TO_TICKS(TTS_STREAM_TIMEOUT_MS)),
+                          cleanup, TAG, "tts stream closed by player");
 
-            memcpy(result->tts_data, user_data, _http_data_len);
-            result->output_len = _http_data_len;
-            printf("===%d===\r\n", _http_data_len);
-            printf("===%d===\r\n", result->output_len);
+        int len = app_turn_http_read(turn, client, (char *)ptr, space, TTS_STREAM_TIMEOUT_MS);
+        ESP_GOTO_ON_FALSE(len != -ESP_ERR_INVALID_STATE, ESP_ERR_INVALID_STATE, cleanup, TAG, "turn %" PRIu32 " cancelled", turn);
+        ESP_GOTO_ON_FALSE(len >= 0, ESP_FAIL, cleanup, TAG, "speech read failed: %d", len);
+        if (len == 0)
+        {
+            break;
         }
-        else
+        app_stream_write_commit(stream, len);
+        *received += len;
+    }
+
+    if (!esp_http_client_is_complete_data_received(client))
+    {
+        ESP_LOGW(TAG, "speech data incomplete: %zu/%lld", *received, content_length);
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGI(TAG, "speech downloaded %zu bytes", *received);
+
+cleanup:
+    app_turn_detach(client);
+    // 完整读完的响应才能在同一连接上继续发送请求
+    app_http_pool_release(client, ret == ESP_OK);
+    return ret;
+}
+
+// 下载一段语音, 在开始播放前失败时用提示音填充该段, 保证播放顺序不变
+static void audio_play_mp3(tts_job_t *job)
+{
+    size_t received = 0;
+    esp_err_t err = audio_request(job->url, job->key, job->stream, job->turn, &received);
+
+    if (err != ESP_OK && received == 0 && !app_turn_cancelled(job->turn))
+    {
+        ESP_LOGW(TAG, "tts download failed: %s", esp_err_to_name(err));
+        const app_prompt_t *prompt = app_prompt_get(APP_PROMPT_TTS_FAILED);
+        if (prompt)
         {
-            ESP_LOGW(TAG, "speech POST Status = %d, content_length = %lld",
-                     status_code,
-                     content_length);
+            app_stream_write(job->stream, prompt->data, prompt->len, pdMS_TO_TICKS(TTS_STREAM_TIMEOUT_MS));
         }
     }
-    esp_http_client_cleanup(client);
+    app_stream_finish(job->stream, err == ESP_OK);
 }
 
-// 播放MP3音频
-void audio_play_mp3(char *url_mp3)
+// 语音段的缓存键: 默认按链接, 也可按同一事件中的回复文本
+static uint32_t chat_tts_cache_key(const char *link, const char *text, size_t index)
 {
-    esp_err_t ret = ESP_OK;
-    FILE *fp = NULL;
-    mp3_url_info_t *result = (mp3_url_info_t *)malloc(sizeof(mp3_url_info_t));
-    if (result == NULL)
+#if CONFIG_TTS_CACHE_KEY_TEXT
+    if (text && text[0] != '\0')
     {
-        ESP_LOGE(TAG, "Failed to allocate memory for result");
-        return;
+        // 同一段文本拆成多个链接时按序号区分
+        return app_tts_cache_key(text, strlen(text)) + index;
     }
-    result->url_mp3 = url_mp3;
+#endif
+    return app_tts_cache_key(link, strlen(link));
+}
 
-    if (xSemaphoreTake(audio_semaphore, portMAX_DELAY) == pdTRUE)
+// 记录本轮回复的语音段, 再说一遍时从缓存播放
+static void chat_remember_key(uint32_t key)
+{
+    if (chat_last_key_count < TTS_URL_QUEUE_LEN)
     {
-        audio_request(result);
+        chat_last_keys[chat_last_key_count++] = key;
+    }
+}
 
-        if (result->tts_data == NULL)
+// 从 url 字段中提取 MP3 链接, 命中缓存的直接交给播放任务, 其余交给下载任务
+static size_t chat_dispatch_mp3_links(const char *urls, const char *text, app_turn_id_t turn)
+{
+    size_t count = 0;
+    const char *ptr;
+    const char *start = urls;
+    while ((ptr = strstr(start, "https://")) != NULL)
+    {
+        const char *end = strstr(ptr, ".mp3");
+        if (end == NULL)
         {
-            ret = ESP_ERR_INVALID_RESPONSE;
-            fp = fopen("/spiffs/tts_failed.mp3", "r");
-            if (fp)
+            break;
+        }
+        // +4是因为".mp3"长度为4
+        char *mp3_link = app_turn_strndup(ptr, end - ptr + 4);
+        if (mp3_link == NULL)
+        {
+            ESP_LOGE(TAG, "no memory for mp3 link");
+            app_telemetry_oom(APP_TELEMETRY_OOM_TTS_LINK);
+            break;
+        }
+        ESP_LOGI(TAG, "mp3 link: %s", mp3_link);
+        start = end + 4; // 移动起始位置，继续查找下一个
+
+        uint32_t key = chat_tts_cache_key(mp3_link, text, count);
+        mp3_data_t cached = {
+            .fp = app_tts_cache_open(key),
+            .turn = turn,
+        };
+        if (cached.fp)
+        {
+            ESP_LOGI(TAG, "tts cache hit %08" PRIx32, key);
+            if (!mp3_data_queue_send(cached))
             {
-                audio_player_play(fp);
-                fclose(fp);
+                fclose(cached.fp);
             }
-            free(result);
-            xSemaphoreGive(audio_semaphore);
-            return;
+            else
+            {
+                chat_remember_key(key);
+                count++;
+            }
+            app_turn_free(mp3_link);
+            continue;
         }
+
+        // 按链接顺序把读取端交给播放任务, 下载任务随后并发填充
+        tts_job_t job = {
+            .url = mp3_link,
+            .key = key,
+            .stream = app_stream_create(TTS_STREAM_BUFFER_SIZE),
+            .turn = turn,
+        };
         mp3_data_t data = {
-            .mp3_data = result->tts_data,
-            .mp3_len = result->output_len,
+            .fp = app_stream_open_reader(job.stream),
+            .turn = turn,
         };
-        ESP_LOGW(TAG, "audio_play_mp3: %d", data.mp3_len);
-        mp3_data_queue_send(data);
-        free(result);
-        xSemaphoreGive(audio_semaphore);
-    }
-    else
-    {
-        ESP_LOGE(TAG, "Failed to take semaphore");
-        free(result);
+        if (data.fp == NULL || !mp3_data_queue_send(data))
+        {
+            ESP_LOGE(TAG, "queue tts segment failed, drop %s", mp3_link);
+            if (data.fp)
+            {
+                fclose(data.fp);
+            }
+            app_stream_finish(job.stream, false);
+            app_turn_free(mp3_link);
+            continue;
+        }
+        if (xQueueSend(tts_url_queue, &job, pdMS_TO_TICKS(1000)) != pdPASS)
+        {
+            // 读取端已在播放队列中, 结束流让播放任务跳过这一段
+            ESP_LOGE(TAG, "tts url queue full, drop %s", mp3_link);
+            app_stream_finish(job.stream, false);
+            app_turn_free(mp3_link);
+            continue;
+        }
+        chat_remember_key(key);
+        count++;
     }
+    return count;
 }
 
-// 处理HTTP响应
-void handle_http_response(char *response)
+// 处理回复中的一个 JSON 对象, 文本立即显示, 语音链接立即开始下载
+static void chat_reply_handle(chat_reply_t *reply, cJSON *json)
 {
-    // ESP_LOGI(TAG, "HTTP Response: %s", response); // 打印完整的响应内容
-    char *data_start = response;
-    char text_content[4096] = {0};
-    char url_content[2048] = {0};
-    size_t text_len = 0;
-    size_t url_len = 0;
-    while ((data_start = strstr(data_start, "data:")) != NULL)
+    cJSON *content = cJSON_GetObjectItem(json, "content");
+    cJSON *url = cJSON_GetObjectItem(json, "url");
+
+    if (content && cJSON_IsString(content) && content->valuestring[0] != '\0')
     {
-        data_start += 5;
-        char *data_end = strstr(data_start, "\n");
-        if (data_end == NULL)
+        bool first = (reply->text_len == 0);
+        // 拼接文本内容
+        int n = snprintf(reply->text + reply->text_len, REPLY_TEXT_MAX_SIZE - reply->text_len, "%s", content->valuestring);
+        if (n > 0)
         {
-            data_end = data_start + strlen(data_start);
+            reply->text_len = MIN(reply->text_len + n, REPLY_TEXT_MAX_SIZE - 1);
         }
-        else
+        ESP_LOGI(TAG, "Response Text: %s", reply->text);
+        ui_ctrl_label_show_text(UI_CTRL_LABEL_REPLY_CONTENT, reply->text);
+        if (first)
         {
-            *data_end = '\0';
+            app_event_publish(APP_EVENT_REPLY_TEXT, reply->text_len);
+            ui_ctrl_show_panel(UI_CTRL_PANEL_REPLY, 0);
         }
+    }
 
-        //解析数据
-        cJSON *json = cJSON_Parse(data_start);
-        if (json == NULL)
+    if (url && cJSON_IsString(url) && url->valuestring[0] != '\0')
+    {
+        ESP_LOGI(TAG, "Response mp3_url: %s", url->valuestring);
+        const char *text = (content && cJSON_IsString(content)) ? content->valuestring : NULL;
+        if (reply->url_count == 0)
         {
-            ESP_LOGE(TAG, "json parse error: %s", cJSON_GetErrorPtr());
-            ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 10000);
-            return;
+            // 新回复的第一个语音段, 替换上一轮记录的语音段
+            chat_last_key_count = 0;
+        }
+        size_t count = chat_dispatch_mp3_links(url->valuestring, text, reply->turn);
+        reply->url_count += count;
+        if (count)
+        {
+            chat_state = CHAT_STATE_SPEAKING;
         }
+    }
+}
 
-        cJSON *content = cJSON_GetObjectItem(json, "content");
-        cJSON *url = cJSON_GetObjectItem(json, "url");
+// 处理一个 SSE 事件; 多行 data: 拼接后可能含有多个 JSON 对象, 逐个处理
+static void chat_sse_event_cb(const char *data, size_t len, void *user_ctx)
+{
+    chat_reply_t *reply = (chat_reply_t *)user_ctx;
+    const char *end = data + len;
 
-        if (content && cJSON_IsString(content) && content->valuestring[0] != '\0')
+    while (data < end)
+    {
+        if (app_turn_cancelled(reply->turn))
         {
-            // 拼接文本内容
-            text_len += snprintf(text_content + text_len, sizeof(text_content) - text_len, "%s", content->valuestring);
+            // 已被打断, 剩余的事件不再显示和播放
+            return;
         }
-
-        if (url && cJSON_IsString(url) && url->valuestring[0] != '\0')
+        const char *parse_end = NULL;
+        cJSON *json = cJSON_ParseWithLengthOpts(data, end - data, &parse_end, false);
+        if (json == NULL)
         {
-            // 播放音频
-            // ESP_LOGI(TAG, "Playing audio from URL: %s", url->valuestring);
-            url_len += snprintf(url_content + url_len, sizeof(url_content) - url_len, "%s", url->valuestring);
+            ESP_LOGW(TAG, "json parse error: %.*s", (int)(end - data), data);
+            return;
         }
+        chat_reply_handle(reply, json);
         cJSON_Delete(json);
 
-        if (data_end != data_start + strlen(data_start))
+        data = parse_end;
+        while (data < end && isspace((unsigned char)*data))
         {
-            *data_end = '\n'; // 恢复 '\n'
+            data++;
         }
-        data_start = data_end + 1;
-        // 打印所有文本内容
-        // ESP_LOGI(TAG, "Response Text: %s", text_content);
     }
-    // 打印文本内容
-    if (text_len > 0 && url_len > 0)
+}
+
+// TTS 下载任务, 多个任务并发预取后续语音段, 播放顺序由播放队列保证
+static void app_tts_fetch_task(void *args)
+{
+    tts_job_t job;
+    while (1)
     {
-        ESP_LOGI(TAG, "Response Text: %s", text_content);
-        ESP_LOGI(TAG, "Response mp3_url: %s", url_content);
-        ui_ctrl_label_show_text(UI_CTRL_LABEL_REPLY_CONTENT, text_content);
-        ui_ctrl_show_panel(UI_CTRL_PANEL_REPLY, 0);
-        char *ptr;
-        char *start = url_content;
-        while ((ptr = strstr(start, "https://")) != NULL)
+        if (xQueueReceive(tts_url_queue, &job, portMAX_DELAY) == pdPASS)
         {
-            char *end = strstr(ptr, ".mp3");
-            if (end != NULL)
+            if (job.cache_data)
+            {
+                // 已经完整播放过的语音段, 与所属的一轮是否被打断无关
+                app_tts_cache_insert(job.key, job.cache_data, job.cache_len);
+                continue;
+            }
+            if (app_turn_cancelled(job.turn))
             {
-                // 计算子字符串长度并提取出来
-                int len = end - ptr + 4; // +4是因为".mp3"长度为4
-                char mp3_link[len + 1];
-                strncpy(mp3_link, ptr, len);
-                mp3_link[len] = '\0';
-                ESP_LOGI(TAG, "mp3 link: %s\n", mp3_link);
-                audio_play_mp3(mp3_link);
-                vTaskDelay(300 / portTICK_PERIOD_MS);
-                start = end + 4; // 移动起始位置，继续查找下一个
+                app_stream_finish(job.stream, false);
             }
             else
             {
-                break;
+                audio_play_mp3(&job);
             }
+            app_turn_free(job.url);
         }
     }
+    vTaskDelete(NULL);
 }
 
-// 启动OpenAI请求
-esp_err_t start_openai(uint8_t *audio, int audio_len)
+// 读取回复, 数据经 HTTP_EVENT_ON_DATA 送入 SSE 解析器
+static esp_err_t chat_read_response(esp_http_client_handle_t client, app_turn_id_t turn)
+{
+    char buf[512];
+    int len;
+    do
+    {
+        len = app_turn_http_read(turn, client, buf, sizeof(buf), CHAT_READ_TIMEOUT_MS);
+    } while (len > 0 && !app_turn_cancelled(turn));
+
+    if (len == -ESP_ERR_INVALID_STATE || app_turn_cancelled(turn))
+    {
+        // 被打断, 剩余的回复不再读取, 连接由本任务关闭, 不能复用
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_sse_parser_finish(sse_parser);
+    return (len < 0) ? ESP_FAIL : ESP_OK;
+}
+
+// 边录音边上传: 以 chunked 编码发送文件分段, 录音结束后再发送其余字段
+static esp_err_t chat_write_stream(app_multipart_writer_t *writer, const app_multipart_part_t *parts, size_t count,
+                                   app_turn_id_t turn)
+{
+    ESP_RETURN_ON_ERROR(app_multipart_open(writer, NULL, 0), TAG, "open request failed");
+    ESP_RETURN_ON_ERROR(app_multipart_write_part_head(writer, &parts[0], true), TAG, "part %s", parts[0].name);
+
+    size_t offset = 0;
+    bool done = false;
+    while (!done)
+    {
+        // 识别为本地命令或被打断, 录音不再上传
+        ESP_RETURN_ON_FALSE(!app_turn_cancelled(turn), ESP_ERR_INVALID_STATE, TAG, "upload cancelled");
+        const uint8_t *data = NULL;
+        size_t len = 0;
+        ESP_RETURN_ON_ERROR(audio_record_stream_get(offset, &data, &len, &done, pdMS_TO_TICKS(RECORD_STREAM_WAIT_MS)),
+                            TAG, "record stream");
+        ESP_RETURN_ON_ERROR(app_multipart_write(writer, data, len), TAG, "part %s", parts[0].name);
+        offset += len;
+    }
+    ESP_LOGI(TAG, "record streamed, %zu bytes", offset);
+
+    for (size_t i = 1; i < count; i++)
+    {
+        ESP_RETURN_ON_ERROR(app_multipart_write_part_head(writer, &parts[i], false), TAG, "part %s", parts[i].name);
+        ESP_RETURN_ON_ERROR(app_multipart_write(writer, parts[i].data, parts[i].len), TAG, "part %s", parts[i].name);
+    }
+    return app_multipart_write_close(writer);
+}
+
+// 上传录音并读取响应头, 复用的连接已被服务器关闭时重连后重新上传一次
+static esp_err_t chat_send_request(app_multipart_writer_t *writer, const app_multipart_part_t *parts, size_t count, bool reused,
+                                   app_turn_id_t turn)
+{
+    for (int attempt = 0; ; attempt++)
+    {
+        esp_err_t err;
+        if (writer->chunked)
+        {
+            // 录音仍保存在缓冲区中, 重试时从头发送
+            err = chat_write_stream(writer, parts, count, turn);
+        }
+        else
+        {
+            err = app_multipart_open(writer, parts, count);
+            if (err == ESP_OK)
+            {
+                err = app_multipart_write_parts(writer, parts, count);
+            }
+        }
+        if (err == ESP_OK && esp_http_client_fetch_headers(writer->client) < 0)
+        {
+            err = ESP_FAIL;
+        }
+        if (err == ESP_OK || !reused || attempt > 0 || app_turn_cancelled(turn))
+        {
+            return err;
+        }
+        app_http_pool_reconnect(writer->client);
+    }
+}
+
+// 发送一轮对话请求, streaming 为 true 时录音边录边传, audio 不使用
+static esp_err_t chat_request(uint8_t *audio, int audio_len, bool streaming, app_turn_id_t turn)
 {
-    // 创建MP3播放任务
-    xTaskCreate(app_mp3_play_task, "app_mp3_play_task", 8192, NULL, 3, NULL);
-    ui_ctrl_show_panel(UI_CTRL_PANEL_GET, 0);
+    esp_err_t ret = ESP_OK;
+
+    if (!streaming)
+    {
+        ui_ctrl_show_panel(UI_CTRL_PANEL_GET, 0);
+    }
     esp_http_client_config_t config = {
         .url = POST_URL,
         .event_handler = http_event_handler,
         .method = HTTP_METHOD_POST,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_http_client_set_header(client, "Content-Type", "multipart/form-data; boundary=----WebKitFormBoundary7MA4YWxkTrZu0gW");
+    bool reused = false;
+    esp_http_client_handle_t client = app_http_pool_acquire(&config, &reused);
+    ESP_RETURN_ON_FALSE(client, ESP_FAIL, TAG, "http client init failed");
 
-    char *post_data = malloc(audio_len + 512);
-    memset(post_data, 0, audio_len + 512);
+    // 录音数据原地发送, 不再拷贝到发送缓冲区
+    const app_multipart_part_t parts[] = {
+        { .name = "file", .filename = "test.mp3", .content_type = "audio/wav", .data = audio, .len = audio_len },
+        { .name = "format", .data = RECORD_UPLOAD_FORMAT, .len = strlen(RECORD_UPLOAD_FORMAT) },
+        { .name = "convertMp3", .data = "true", .len = strlen("true") },
+    };
+    app_multipart_writer_t writer = {
+        .client = client,
+        .chunked = streaming,
+    };
 
-    memcpy(post_data, "------WebKitFormBoundary7MA4YWxkTrZu0gW\r\nContent-Disposition: form-data; name=\"file\"; filename=\"test.mp3\"\r\nContent-Type: audio/wav\r\n\r\n", 134);
-    memcpy(post_data + 134, audio, audio_len);
-    memcpy(post_data + 134 + audio_len, "\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW\r\nContent-Disposition: form-data; name=\"format\"\r\n\r\nwav\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW\r\nContent-Disposition: form-data; name=\"convertMp3\"\r\n\r\ntrue\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW--\r\n", 240);
+    chat_request_active = true;
+    chat_state = CHAT_STATE_THINKING;
 
-    ESP_LOGI(TAG, "Post data:\n%s", post_data);
+    // 清空上一轮的回复
+    chat_reply.text_len = 0;
+    chat_reply.text[0] = '\0';
+    chat_reply.url_count = 0;
+    chat_reply.turn = turn;
+    app_sse_parser_reset(sse_parser);
 
-    // 设置POST字段
-    esp_http_client_set_post_field(client, post_data, 374 + audio_len);
+    ret = app_turn_attach(turn, client);
+    ESP_GOTO_ON_FALSE(ESP_ERR_INVALID_STATE != ret, ret, err, TAG, "turn %" PRIu32 " cancelled", turn);
+    ret = ESP_OK;
+    ESP_GOTO_ON_ERROR(chat_send_request(&writer, parts, sizeof(parts) / sizeof(parts[0]), reused, turn), err, TAG, "upload failed");
+    app_replay_mark(APP_REPLAY_UPLOADED, writer.sent);
+    app_event_publish(APP_EVENT_UPLOADED, writer.sent);
+    if (streaming)
+    {
+        ui_ctrl_show_panel(UI_CTRL_PANEL_GET, 0);
+    }
+
+    ESP_LOGI(TAG, "HTTP POST Status = %d",
+             esp_http_client_get_status_code(client));
+    ESP_GOTO_ON_ERROR(chat_read_response(client, turn), err, TAG, "read response failed");
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK)
+    // 回复内容已在接收过程中处理, 这里只处理空回复
+    if (chat_reply.text_len == 0 && chat_reply.url_count == 0)
     {
-        ESP_LOGI(TAG, "HTTP POST Status = %d",
-                 esp_http_client_get_status_code(client));
+        ESP_LOGW(TAG, "empty reply");
+        ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 2000);
+    }
 
-        // 处理响应数据
-        handle_http_response(response_buffer);
+err:
+    chat_request_active = false;
+    if (app_turn_cancelled(turn))
+    {
+        // 状态和界面已属于新的一轮
+        ESP_LOGI(TAG, "turn %" PRIu32 " interrupted", turn);
     }
-    else
+    else if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(ret));
         ui_ctrl_label_show_text(UI_CTRL_LABEL_LISTEN_SPEAK, "tts respone error");
         ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 2000);
     }
+    if (!app_turn_cancelled(turn) && chat_state == CHAT_STATE_THINKING)
+    {
+        chat_state = CHAT_STATE_IDLE;
+    }
+    else if (!app_turn_cancelled(turn))
+    {
+        // 最后一段可能在回复读完之前就已播完
+        chat_reply_audio_end_check();
+    }
+
+    // 连接留在缓存中, 下一轮对话直接复用
+    app_turn_detach(client);
+    app_http_pool_release(client, ret == ESP_OK);
+
+    app_http_pool_stats_t stats;
+    app_http_pool_get_stats(&stats);
+    ESP_LOGI(TAG, "http pool hits %lu, misses %lu, evictions %lu, reconnects %lu",
+             stats.hits, stats.misses, stats.evictions, stats.reconnects);
+    app_tts_cache_stats_t cache_stats;
+    app_tts_cache_get_stats(&cache_stats);
+    ESP_LOGI(TAG, "tts cache hits %lu (sdcard %lu), misses %lu, evictions %lu",
+             cache_stats.hits, cache_stats.sd_hits, cache_stats.misses, cache_stats.evictions);
+    app_turn_stats_t turn_stats;
+    app_turn_get_stats(&turn_stats);
+    ESP_LOGI(TAG, "turns %lu, cancelled %lu, transfers aborted %lu, drain max %lu us",
+             turn_stats.turns, turn_stats.cancelled, turn_stats.aborted, turn_stats.drain_max_us);
+    ESP_LOGI(TAG, "turn arena %lu/%lu bytes, high water %lu, live %lu, resets %lu (deferred %lu), heap fallbacks %lu",
+             turn_stats.arena.used, turn_stats.arena.size, turn_stats.arena.high_water, turn_stats.arena.live,
+             turn_stats.arena.resets, turn_stats.arena.deferred, turn_stats.arena.fallbacks);
+    app_telemetry_log();
+    app_worker_log();
+    app_event_log();
+    return ret;
+}
+
+// 对话请求任务, 请求由 SR 处理任务排队, 不再阻塞唤醒和录音
+static void app_chat_task(void *args)
+{
+    chat_job_t job;
+    while (1)
+    {
+        if (xQueueReceive(chat_job_queue, &job, portMAX_DELAY) == pdPASS)
+        {
+            // 排队期间又被唤醒或识别为本地命令, 这次录音已属于旧的一轮
+            if (!app_turn_is_current(job.turn))
+            {
+                ESP_LOGW(TAG, "drop chat request of turn %" PRIu32 ", turn %" PRIu32 " is current", job.turn, app_turn_current());
+                continue;
+            }
+            chat_request(job.audio, job.len, job.streaming, job.turn);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+static esp_err_t chat_job_send(uint8_t *audio, int audio_len, bool streaming)
+{
+    chat_job_t job = {
+        .audio = audio,
+        .len = audio_len,
+        .streaming = streaming,
+        .turn = app_turn_current(),
+    };
+    ESP_RETURN_ON_FALSE(chat_job_queue, ESP_ERR_INVALID_STATE, TAG, "chat task not started");
+    ESP_RETURN_ON_FALSE(xQueueSend(chat_job_queue, &job, 0) == pdPASS, ESP_FAIL, TAG, "chat request queue full");
+    return ESP_OK;
+}
+
+// 启动OpenAI请求
+esp_err_t start_openai(uint8_t *audio, int audio_len)
+{
+    return chat_job_send(audio, audio_len, false);
+}
+
+// 唤醒后立即开始请求, 录音数据随说话上传
+void start_openai_stream(void)
+{
+    chat_job_send(NULL, 0, true);
+}
+
+// 遥测采样时标记当前所处的阶段
+static const char *chat_stage_name(void)
+{
+    return chat_state_name[chat_state];
+}
+
+// 一轮对话被取消: 传输已被中止, 丢弃未播放的语音段并停止播放
+static void chat_turn_cancel_cb(app_turn_id_t turn, void *ctx)
+{
+    // 最后一段已出队时状态可能已回到空闲, 以播放器状态为准
+    if (chat_state == CHAT_STATE_IDLE && audio_player_get_state() != AUDIO_PLAYER_STATE_PLAYING)
+    {
+        return;
+    }
+    ESP_LOGI(TAG, "turn %" PRIu32 " cancelled while %s", turn, chat_state_name[chat_state]);
+    // 先回到空闲, 停止播放触发的完成回调不再通知回复结束
+    chat_state = CHAT_STATE_IDLE;
+
+    // 未开始下载的语音段, 读取端已在播放队列中
+    tts_job_t job;
+    while (xQueueReceive(tts_url_queue, &job, 0) == pdPASS)
+    {
+        if (job.cache_data)
+        {
+            heap_caps_free(job.cache_data);
+            continue;
+        }
+        app_stream_finish(job.stream, false);
+        app_turn_free(job.url);
+    }
+    // 关闭读取端, 正在进行的下载随之结束
+    mp3_data_t data;
+    while (xQueueReceive(mp3_data_queue, &data, 0) == pdPASS)
+    {
+        fclose(data.fp);
+    }
+    audio_player_stop();
+    // 已解码未播放的部分在混音器中, 一并丢弃
+    app_mixer_flush(APP_MIXER_SOURCE_TTS);
+}
+
+// 唤醒即开始新的一轮, 打断正在进行的回复
+static void chat_barge_in(void)
+{
+    app_turn_begin();
+}
+
+// 从缓存重新播放上一轮回复, 不发起网络请求
+static void chat_repeat_last_reply(void)
+{
+    app_turn_id_t turn = app_turn_current();
+    size_t queued = 0;
+    // 先进入播放状态, 第一段马上播完时也能通知回复结束
+    chat_state = CHAT_STATE_SPEAKING;
+    for (size_t i = 0; i < chat_last_key_count; i++)
+    {
+        mp3_data_t data = {
+            .fp = app_tts_cache_open(chat_last_keys[i]),
+            .turn = turn,
+        };
+        if (data.fp && mp3_data_queue_send(data))
+        {
+            queued++;
+        }
+        else if (data.fp)
+        {
+            fclose(data.fp);
+        }
+    }
+    ESP_LOGI(TAG, "repeat last reply, %zu/%zu segments cached", queued, chat_last_key_count);
+    if (queued)
+    {
+        ui_ctrl_show_panel(UI_CTRL_PANEL_REPLY, 0);
+    }
+    else
+    {
+        chat_state = CHAT_STATE_IDLE;
+        ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 0);
+    }
+}
 
-    // Cleanup
-    // free(audio);
-    free(post_data);
-    esp_http_client_cleanup(client);
+// 本地语音命令, 在 SR 处理任务中执行
+static void chat_local_command(int command_id)
+{
+    // 边录边传时请求已经开始, 开始新的一轮将其取消
+    app_turn_begin();
+    switch (command_id)
+    {
+    case SR_CMD_LOUDER:
+        audio_volume_adjust(CHAT_VOLUME_STEP);
+        ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 0);
+        break;
+    case SR_CMD_QUIETER:
+        audio_volume_adjust(-CHAT_VOLUME_STEP);
+        ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 0);
+        break;
+    case SR_CMD_REPEAT:
+        chat_repeat_last_reply();
+        break;
+    case SR_CMD_STOP:
+    default:
+        ui_ctrl_show_panel(UI_CTRL_PANEL_SLEEP, 0);
+        break;
+    }
+}
+
+// 回复已全部下发, 没有待播放的语音段且播放器空闲时本轮回复结束; 每轮只通知一次
+// 由播放完成回调和对话任务分别在各自的条件改变之后调用, 后调用的一方负责结束
+static void chat_reply_audio_end_check(void)
+{
+    if (chat_request_active || mp3_play_holding || uxQueueMessagesWaiting(mp3_data_queue) > 0 ||
+        !(xEventGroupGetBits(audio_play_event_group) & AUDIO_PLAY_FINAL_BIT))
+    {
+        return;
+    }
+    portENTER_CRITICAL(&chat_state_lock);
+    bool ended = (chat_state == CHAT_STATE_SPEAKING);
+    if (ended)
+    {
+        chat_state = CHAT_STATE_IDLE;
+    }
+    portEXIT_CRITICAL(&chat_state_lock);
+    if (ended)
+    {
+        ESP_LOGI(TAG, "reply audio end");
+        app_event_publish(APP_EVENT_REPLY_AUDIO_END, 0);
+    }
 }
-// 音频播放完成回调
+
+// 音频播放完成回调, 每个语音段一次
 static void audio_play_finish_cb(void)
 {
-    ESP_LOGI(TAG, "replay audio end");
+    ESP_LOGI(TAG, "reply segment end");
 
     // 设置音频播放完成事件位
     xEventGroupSetBits(audio_play_event_group, AUDIO_PLAY_FINAL_BIT);
-    if (ui_ctrl_reply_get_audio_start_flag())
-    {
-        ui_ctrl_reply_set_audio_end_flag(true);
-    }
+    chat_reply_audio_end_check();
 }
 
 // uart 任务
@@ -601,6 +1076,27 @@ static void app_uart_task(void *parm)
                     case CHATGPT_RESPONSE_CMD:
                         ESP_LOGI(TAG, "recive cmd WIFI_STATE_CMD");
                         break;
+                    // 查询内存, 任务栈使用情况和各阶段延迟
+                    case TELEMETRY_CMD:
+                        ESP_LOGI(TAG, "recive cmd TELEMETRY_CMD");
+                        cJSON *telemetry = app_telemetry_to_json();
+                        if (telemetry)
+                        {
+                            cJSON_AddNumberToObject(telemetry, "cmd", TELEMETRY_CMD);
+                            cJSON *latency = app_event_to_json();
+                            if (latency)
+                            {
+                                cJSON_AddItemToObject(telemetry, "latency", latency);
+                            }
+                            char *telemetry_data = cJSON_PrintUnformatted(telemetry);
+                            if (telemetry_data)
+                            {
+                                app_uart_send(telemetry_data, strlen(telemetry_data));
+                                free(telemetry_data);
+                            }
+                            cJSON_Delete(telemetry);
+                        }
+                        break;
 
                     default:
                         break;
@@ -661,10 +1157,6 @@ void app_main()
     }
     ESP_ERROR_CHECK(ret);
 
-    //创建一个互斥信号量，用于控制音频播放的同步
-    audio_semaphore = xSemaphoreCreateMutex();
-    xSemaphoreGive(audio_semaphore);
-
     //初始化SPIFFS 文件系统、I2C 接口、显示屏、板载硬件、网络和 UI 控制
     bsp_spiffs_mount();
     bsp_i2c_init();
@@ -674,16 +1166,24 @@ void app_main()
     bsp_display_backlight_on();
     ui_ctrl_init();
 
+    //预加载提示音, 唤醒和确认提示音异步播放
+    ESP_ERROR_CHECK_WITHOUT_ABORT(app_prompt_init());
+
+    //唤醒后开始新的一轮对话, 取消上一轮时清理播放队列
+    ESP_ERROR_CHECK(app_turn_init(chat_turn_cancel_cb, NULL));
+
     //启动语音识别功能
     ESP_LOGI(TAG, "speech recognition start");
     app_sr_start(false);
 
     //注册一个回调函数，当音频播放完成时会调用该函数
     audio_register_play_finish_cb(audio_play_finish_cb);
+    app_telemetry_register_stage_cb(chat_stage_name);
+    audio_register_barge_in_cb(chat_barge_in);
+    audio_register_command_cb(chat_local_command);
 
-    //初始化 UART 并创建一个任务来处理 UART 通信
+    //初始化 UART, 处理任务随其他工作任务一起创建
     app_uart_init();
-    xTaskCreate(app_uart_task, "app_uart_task", 8192, NULL, 3, NULL);
 
     //创建一个事件组，用于音频播放的同步控制
     audio_play_event_group = xEventGroupCreate();
@@ -692,4 +1192,45 @@ void app_main()
     //创建一个队列，用于存储 MP3 数据
     mp3_data_queue = xQueueCreate(20, sizeof(mp3_data_t));
     ESP_ERROR_CHECK_WITHOUT_ABORT((mp3_data_queue) ? ESP_OK : ESP_FAIL);
+
+    //初始化 HTTP 连接缓存, 对话和语音下载复用长连接
+    ESP_ERROR_CHECK_WITHOUT_ABORT(app_http_pool_init());
+
+    //初始化 TTS 音频缓存, 重复的回复不再下载
+    ESP_ERROR_CHECK_WITHOUT_ABORT(app_tts_cache_init());
+
+    //创建 SSE 解析器和回复缓冲区, 回复边接收边处理
+    chat_reply.text = heap_caps_calloc(1, REPLY_TEXT_MAX_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_ERROR_CHECK_WITHOUT_ABORT((chat_reply.text) ? ESP_OK : ESP_FAIL);
+    // 服务器每行 data: 是一个完整的 JSON 对象, 按行派发
+    sse_parser = app_sse_parser_create(SSE_MAX_EVENT_SIZE, APP_SSE_DISPATCH_LINE, chat_sse_event_cb, &chat_reply);
+    ESP_ERROR_CHECK_WITHOUT_ABORT((sse_parser) ? ESP_OK : ESP_FAIL);
+
+    //创建队列, 用于下载回复中的 MP3 链接和排队对话请求
+    tts_url_queue = xQueueCreate(TTS_URL_QUEUE_LEN, sizeof(tts_job_t));
+    ESP_ERROR_CHECK_WITHOUT_ABORT((tts_url_queue) ? ESP_OK : ESP_FAIL);
+    chat_job_queue = xQueueCreate(2, sizeof(chat_job_t));
+    ESP_ERROR_CHECK_WITHOUT_ABORT((chat_job_queue) ? ESP_OK : ESP_FAIL);
+
+    //创建固定的工作任务, 之后不再按请求创建任务; 访问 flash 的任务栈必须在内部 RAM
+    //任务名不超过 CONFIG_FREERTOS_MAX_TASK_NAME_LEN - 1 个字符, 每个下载任务单独命名以便统计
+    static const char *fetch_worker_names[] = { "app_fetch_task0", "app_fetch_task1", "app_fetch_task2", "app_fetch_task3" };
+    _Static_assert(TTS_PREFETCH_DEPTH <= sizeof(fetch_worker_names) / sizeof(fetch_worker_names[0]), "name every fetch worker");
+    const app_worker_config_t workers[] = {
+        { "app_uart_task", app_uart_task, NULL, 8192, 3, tskNO_AFFINITY, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+        { "app_play_task", app_mp3_play_task, NULL, 8192, 3, tskNO_AFFINITY, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+        { "app_chat_task", app_chat_task, NULL, 8192, 4, tskNO_AFFINITY, NET_WORKER_STACK_CAPS },
+    };
+    esp_err_t worker_ret = app_worker_start(workers, sizeof(workers) / sizeof(workers[0]));
+    for (int i = 0; i < TTS_PREFETCH_DEPTH && ESP_OK == worker_ret; i++)
+    {
+        const app_worker_config_t fetch_worker = {
+            fetch_worker_names[i], app_tts_fetch_task, NULL, 8192, 3, tskNO_AFFINITY, NET_WORKER_STACK_CAPS
+        };
+        worker_ret = app_worker_start(&fetch_worker, 1);
+    }
+    if (ESP_OK != worker_ret)
+    {
+        app_telemetry_oom(APP_TELEMETRY_OOM_TASK);
+    }
 }
@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+// 生成回放测试用的录音和标注: 语音用带音节包络的谐波合成, 背景为白噪声, 结果是确定的
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define FIXTURE_RATE        (16000)
+#define FIXTURE_SEG_MAX     (16)
+
+typedef struct {
+    uint32_t start_ms;
+    uint32_t end_ms;
+    float gain;                 /*!< Level relative to normal speech, 0 for 1.0 */
+} fixture_seg_t;
+
+typedef struct {
+    const char *name;
+    uint32_t duration_ms;
+    fixture_seg_t speech[FIXTURE_SEG_MAX];  /*!< Wake words and utterances */
+    const char *labels;                     /*!< Written as is to <name>.labels */
+} fixture_scene_t;
+
+static const fixture_scene_t fixture_scenes[] = {
+    {
+        // 一轮正常对话, 一个本地命令, 一轮回复被下一次唤醒打断, 唤醒后不说话,
+        // 最后一个命令在说完 800 ms 后才被识别, 晚于说话结束判定;
+        // 命令窗口打开时说话结束要等到窗口关闭, 下一次唤醒留在窗口之后;
+        // 唤醒标注在唤醒词结束后 100 ms, 与 WakeNet 的触发时刻相近
+        .name = "turns",
+        .duration_ms = 25000,
+        .speech = {
+            { 1000, 1500 }, { 1800, 2400 }, { 2550, 3000 }, { 3150, 3600 },
+            { 7000, 7500 }, { 7700, 8100 },
+            { 10000, 10500 }, { 10700, 12200 },
+            { 14300, 14800 },
+            { 20500, 21000 }, { 21200, 21600 },
+        },
+        .labels =
+            "wake 1600\n"
+            "wake 7600\n"
+            "command 8200 0\n"
+            "wake 10600\n"
+            "wake 14900\n"
+            "wake 21100\n"
+            "command 22400 1\n"
+            "expect 1 end_of_speech\n"
+            "expect 2 command 0\n"
+            "expect 3 end_of_speech cancelled\n"
+            "expect 4 no_speech\n"
+            "expect 5 command 1\n",
+    },
+    {
+        // 说话结束判定的语料: 短命令, 中等长度, 带停顿的长句, 超长句, 低信噪比, 再一句短的;
+        // 每轮的回复在下一次唤醒之前放完
+        .name = "tails",
+        .duration_ms = 45000,
+        .speech = {
+            { 1000, 1500 }, { 1900, 2300 },
+            { 7000, 7500 }, { 7900, 9100 },
+            { 13000, 13500 }, { 13900, 14900 }, { 15200, 16200 }, { 16500, 17300 },
+            { 21000, 21500 }, { 21900, 27900 },
+            { 32000, 32500 }, { 32900, 34400, 0.04f },
+            { 39000, 39500 }, { 39900, 40500 },
+        },
+        .labels =
+            "wake 1600\n"
+            "wake 7600\n"
+            "wake 13600\n"
+            "wake 21600\n"
+            "wake 32600\n"
+            "wake 39600\n"
+            "expect 1 end_of_speech\n"
+            "expect 2 end_of_speech\n"
+            "expect 3 end_of_speech\n"
+            "expect 4 end_of_speech\n"
+            "expect 5 end_of_speech\n"
+            "expect 6 end_of_speech\n",
+    },
+};
+
+static uint32_t fixture_rand = 0x12345678;
+
+static float fixture_noise(void)
+{
+    fixture_rand = fixture_rand * 1664525u + 1013904223u;
+    return (float)(int32_t)fixture_rand / 2147483648.0f;
+}
+
+// 基频 140 Hz 的前几次谐波, 4 Hz 音节包络, 首尾 20 ms 渐变
+static float fixture_speech(uint32_t n, const fixture_seg_t *seg)
+{
+    float t = (float)n / FIXTURE_RATE;
+    float start = seg->start_ms / 1000.0f;
+    float end = seg->end_ms / 1000.0f;
+    float fade = fminf(fminf(t - start, end - t) / 0.02f, 1.0f);
+    float env = 0.65f - 0.35f * cosf(2.0f * (float)M_PI * 4.0f * (t - start));
+    float f0 = 140.0f * (1.0f + 0.03f * sinf(2.0f * (float)M_PI * 3.0f * t));
+    float v = 0;
+    for (int h = 1; h <= 6; h++) {
+        v += sinf(2.0f * (float)M_PI * f0 * h * t) / h;
+    }
+    return v * env * fade * 4000.0f * (seg->gain > 0 ? seg->gain : 1.0f);
+}
+
+static void fixture_write_le(FILE *fp, uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        fputc((value >> (8 * i)) & 0xff, fp);
+    }
+}
+
+static int fixture_write(const char *dir, const fixture_scene_t *scene)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.wav", dir, scene->name);
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    uint32_t samples = (uint64_t)scene->duration_ms * FIXTURE_RATE / 1000;
+    fwrite("RIFF", 1, 4, fp);
+    fixture_write_le(fp, 36 + samples * 2, 4);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    fixture_write_le(fp, 16, 4);
+    fixture_write_le(fp, 1, 2);
+    fixture_write_le(fp, 1, 2);
+    fixture_write_le(fp, FIXTURE_RATE, 4);
+    fixture_write_le(fp, FIXTURE_RATE * 2, 4);
+    fixture_write_le(fp, 2, 2);
+    fixture_write_le(fp, 16, 2);
+    fwrite("data", 1, 4, fp);
+    fixture_write_le(fp, samples * 2, 4);
+
+    for (uint32_t n = 0; n < samples; n++) {
+        uint32_t ms = (uint64_t)n * 1000 / FIXTURE_RATE;
+        float v = fixture_noise() * 30.0f;
+        for (int i = 0; i < FIXTURE_SEG_MAX && scene->speech[i].end_ms; i++) {
+            if (ms >= scene->speech[i].start_ms && ms < scene->speech[i].end_ms) {
+                v += fixture_speech(n, &scene->speech[i]);
+            }
+        }
+        fixture_write_le(fp, (uint16_t)(int16_t)lrintf(fmaxf(fminf(v, 32767.0f), -32768.0f)), 2);
+    }
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "%s/%s.labels", dir, scene->name);
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    fputs(scene->labels, fp);
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <output dir>\n", argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(fixture_scenes) / sizeof(fixture_scenes[0]); i++) {
+        if (fixture_write(argv[1], &fixture_scenes[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+// 主机测试不生成 JSON, 创建总是失败, 调用方按内存不足处理
+#pragma once
+
+typedef struct cJSON cJSON;
+
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
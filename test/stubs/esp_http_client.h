@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+// 主机测试用的 HTTP 客户端: 不联网, 记录请求头和写入的请求体供测试检查
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define HOST_HTTP_HEADER_MAX    (8)
+
+#define ESP_ERR_HTTP_BASE       (0x7000)
+#define ESP_ERR_HTTP_EAGAIN     (ESP_ERR_HTTP_BASE + 7)     /*!< Read timed out, no data yet */
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef struct {
+    char *key;
+    char *value;
+} host_http_header_t;
+
+typedef struct esp_http_client {
+    esp_http_client_method_t method;
+    host_http_header_t headers[HOST_HTTP_HEADER_MAX];
+    bool open;
+    int write_len;              /*!< Length passed to open, 0 for chunked */
+    uint8_t *body;              /*!< Everything written since open */
+    size_t body_len;
+    int timeout_ms;
+} *esp_http_client_handle_t;
+
+esp_http_client_handle_t host_http_client_create(void);
+void host_http_client_destroy(esp_http_client_handle_t client);
+const char *host_http_client_header(esp_http_client_handle_t client, const char *key);
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len);
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client);
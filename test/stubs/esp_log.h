@@ -0,0 +1,31 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include "esp_err.h"
+
+#define LOG_COLOR_GREEN     "32"
+#define LOG_COLOR(c)        "\033[0;" c "m"
+#define LOG_BOLD(c)         "\033[1;" c "m"
+
+/**
+ * @brief 0: errors only, 1: warnings, 2: info (default), 3: debug; set with the HOST_LOG_LEVEL environment variable.
+ */
+int host_log_level(void);
+
+#define HOST_LOG(level, letter, tag, format, ...) do {                      \
+        if (host_log_level() >= (level)) {                                  \
+            printf(letter " (%s) " format "\n", tag, ##__VA_ARGS__);        \
+        }                                                                   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(0, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(1, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(2, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(3, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(4, "V", tag, format, ##__VA_ARGS__)
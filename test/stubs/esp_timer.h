@@ -0,0 +1,23 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief Microseconds since start, or the virtual clock when enabled.
+ */
+int64_t esp_timer_get_time(void);
+
+/**
+ * @brief Switch to a virtual clock that only advances in vTaskDelay, so real-time replay runs at full speed.
+ *
+ * Only for single-threaded tests; other tasks keep waiting on real time.
+ */
+void host_clock_set_virtual(bool enable);
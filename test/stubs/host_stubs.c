@@ -0,0 +1,431 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+static _Thread_local struct host_task *host_current_task = NULL;
+static atomic_bool host_clock_virtual = false;
+static atomic_int_fast64_t host_clock_us = 0;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+int host_log_level(void)
+{
+    static int level = -1;
+    if (level < 0) {
+        const char *env = getenv("HOST_LOG_LEVEL");
+        level = env ? atoi(env) : 2;
+    }
+    return level;
+}
+
+/* ---------------------------------------------------------------- clock */
+
+static int64_t host_monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    if (atomic_load(&host_clock_virtual)) {
+        return atomic_load(&host_clock_us);
+    }
+    static int64_t start_us = 0;
+    if (start_us == 0) {
+        start_us = host_monotonic_us();
+    }
+    return host_monotonic_us() - start_us;
+}
+
+void host_clock_set_virtual(bool enable)
+{
+    atomic_store(&host_clock_us, 0);
+    atomic_store(&host_clock_virtual, enable);
+}
+
+// 按节拍计算条件变量的等待截止时间, portMAX_DELAY 返回 false 表示一直等
+static bool host_deadline(TickType_t ticks, struct timespec *ts)
+{
+    if (ticks == portMAX_DELAY) {
+        return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = (uint64_t)ts->tv_nsec + (uint64_t)ticks * 1000000 / configTICK_RATE_HZ * 1000;
+    ts->tv_sec += ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+    return true;
+}
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// 等到条件成立或超时, 调用前持有 lock
+static bool host_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, bool has_deadline, const struct timespec *ts)
+{
+    if (!has_deadline) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, ts) != ETIMEDOUT;
+}
+
+/* ---------------------------------------------------------------- tasks */
+
+static void *host_task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    host_current_task = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    (void)name;
+    (void)stack;
+    (void)prio;
+    (void)core;
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+    if (handle) {
+        *handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == host_current_task) {
+        pthread_exit(NULL);
+    }
+    fprintf(stderr, "vTaskDelete of another task is not supported on the host\n");
+    abort();
+}
+
+void host_task_join(TaskHandle_t task)
+{
+    pthread_join(task->thread, NULL);
+    pthread_mutex_destroy(&task->lock);
+    pthread_cond_destroy(&task->cond);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (atomic_load(&host_clock_virtual)) {
+        atomic_fetch_add(&host_clock_us, (int64_t)ticks * 1000000 / configTICK_RATE_HZ);
+        return;
+    }
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    nanosleep(&ts, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() * configTICK_RATE_HZ / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return host_current_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct host_task *task = host_current_task;
+    configASSERT(task);
+    struct timespec ts;
+    bool has_deadline = host_deadline(ticks, &ts);
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0 && ticks != 0) {
+        if (!host_cond_wait(&task->cond, &task->lock, has_deadline, &ts)) {
+            break;
+        }
+    }
+    uint32_t value = task->notify;
+    if (value) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskSetTimeOutState(TimeOut_t *timeout)
+{
+    timeout->start_us = esp_timer_get_time();
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticks_to_wait)
+{
+    if (*ticks_to_wait == portMAX_DELAY) {
+        return pdFALSE;
+    }
+    TickType_t elapsed = (TickType_t)((esp_timer_get_time() - timeout->start_us) * configTICK_RATE_HZ / 1000000);
+    if (elapsed >= *ticks_to_wait) {
+        *ticks_to_wait = 0;
+        return pdTRUE;
+    }
+    *ticks_to_wait -= elapsed;
+    timeout->start_us += (int64_t)elapsed * 1000000 / configTICK_RATE_HZ;
+    return pdFALSE;
+}
+
+/* ----------------------------------------------------------- semaphores */
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    struct host_semaphore *sem = calloc(1, sizeof(struct host_semaphore));
+    if (sem == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&sem->lock, NULL);
+    host_cond_init(&sem->cond);
+    sem->count = initial;
+    sem->max = max;
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec ts;
+    bool has_deadline = host_deadline(ticks, &ts);
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0 && ticks != 0) {
+        if (!host_cond_wait(&sem->cond, &sem->lock, has_deadline, &ts)) {
+            break;
+        }
+    }
+    BaseType_t taken = pdFALSE;
+    if (sem->count) {
+        sem->count--;
+        taken = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t given = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max) {
+        sem->count++;
+        given = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return given;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    free(sem);
+}
+
+/* ---------------------------------------------------------- http client */
+
+esp_http_client_handle_t host_http_client_create(void)
+{
+    return calloc(1, sizeof(struct esp_http_client));
+}
+
+void host_http_client_destroy(esp_http_client_handle_t client)
+{
+    for (int i = 0; i < HOST_HTTP_HEADER_MAX; i++) {
+        free(client->headers[i].key);
+        free(client->headers[i].value);
+    }
+    free(client->body);
+    free(client);
+}
+
+static host_http_header_t *host_http_find_header(esp_http_client_handle_t client, const char *key)
+{
+    for (int i = 0; i < HOST_HTTP_HEADER_MAX; i++) {
+        if (client->headers[i].key && strcasecmp(client->headers[i].key, key) == 0) {
+            return &client->headers[i];
+        }
+    }
+    return NULL;
+}
+
+const char *host_http_client_header(esp_http_client_handle_t client, const char *key)
+{
+    host_http_header_t *header = host_http_find_header(client, key);
+    return header ? header->value : NULL;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    host_http_header_t *header = host_http_find_header(client, key);
+    if (header == NULL) {
+        for (int i = 0; header == NULL && i < HOST_HTTP_HEADER_MAX; i++) {
+            if (client->headers[i].key == NULL) {
+                header = &client->headers[i];
+            }
+        }
+        if (header == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        header->key = strdup(key);
+    }
+    free(header->value);
+    header->value = strdup(value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    host_http_header_t *header = host_http_find_header(client, key);
+    if (header) {
+        free(header->key);
+        free(header->value);
+        header->key = NULL;
+        header->value = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    client->open = true;
+    client->write_len = write_len;
+    client->body_len = 0;
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len)
+{
+    if (!client->open) {
+        return -1;
+    }
+    uint8_t *body = realloc(client->body, client->body_len + len);
+    if (body == NULL) {
+        return -1;
+    }
+    memcpy(body + client->body_len, buffer, len);
+    client->body = body;
+    client->body_len += len;
+    return len;
+}
+
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms)
+{
+    client->timeout_ms = timeout_ms;
+    return ESP_OK;
+}
+
+// 没有服务器, 读取总是超时
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    return -ESP_ERR_HTTP_EAGAIN;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return false;
+}
+
+cJSON *cJSON_CreateObject(void)
+{
+    return NULL;
+}
+
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name)
+{
+    return NULL;
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+    return NULL;
+}
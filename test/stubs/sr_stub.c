@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <math.h>
+#include "sr_stub.h"
+
+#define SR_STUB_RATE            (16000)
+#define SR_STUB_VAD_MARGIN_DB   (10.0f) /*!< Frames this far above the noise floor are speech */
+#define SR_STUB_VAD_HANGOVER    (2)     /*!< Frames kept as speech after the energy drops */
+#define SR_STUB_NOISE_ALPHA     (0.05f)
+
+void sr_stub_init(sr_stub_t *sr, const sr_stub_labels_t *labels)
+{
+    memset(sr, 0, sizeof(sr_stub_t));
+    sr->labels = labels;
+    sr->wakenet_enabled = true;
+}
+
+uint32_t sr_stub_time_ms(const sr_stub_t *sr)
+{
+    return (uint64_t)sr->frames * SR_STUB_CHUNK * 1000 / SR_STUB_RATE;
+}
+
+static bool sr_stub_vad(sr_stub_t *sr, const int16_t *pcm, size_t samples)
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += pcm[i] * pcm[i];
+    }
+    float db = 10.0f * log10f((float)sum / samples + 1.0f);
+    if (!sr->noise_valid) {
+        sr->noise_db = db;
+        sr->noise_valid = true;
+    }
+    if (db > sr->noise_db + SR_STUB_VAD_MARGIN_DB) {
+        sr->hangover = SR_STUB_VAD_HANGOVER;
+        return true;
+    }
+    sr->noise_db += (db - sr->noise_db) * SR_STUB_NOISE_ALPHA;
+    if (sr->hangover) {
+        sr->hangover--;
+        return true;
+    }
+    return false;
+}
+
+void sr_stub_process(sr_stub_t *sr, const int16_t *feed, size_t frames, sr_stub_result_t *res)
+{
+    res->samples = frames < SR_STUB_CHUNK ? frames : SR_STUB_CHUNK;
+    for (size_t i = 0; i < res->samples; i++) {
+        res->data[i] = feed[i * 3];
+    }
+    sr->frames++;
+    res->speech = sr_stub_vad(sr, res->data, res->samples);
+
+    // 标注的唤醒时间所在的帧报告检测, 下一帧报告通道确认, 与 AFE 的顺序一致
+    uint32_t now_ms = sr_stub_time_ms(sr);
+    res->wakeup_state = SR_STUB_WAKE_NONE;
+    if (sr->verify_pending) {
+        sr->verify_pending = false;
+        res->wakeup_state = SR_STUB_WAKE_VERIFIED;
+    } else if (sr->wake_next < sr->labels->wake_count && now_ms >= sr->labels->wake_ms[sr->wake_next]) {
+        sr->wake_next++;
+        if (sr->wakenet_enabled) {
+            sr->verify_pending = true;
+            res->wakeup_state = SR_STUB_WAKE_DETECTED;
+        }
+    }
+}
+
+void sr_stub_enable_wakenet(sr_stub_t *sr, bool enable)
+{
+    sr->wakenet_enabled = enable;
+}
+
+void sr_stub_mn_clean(sr_stub_t *sr)
+{
+    sr->mn_open = true;
+    sr->mn_start_ms = sr_stub_time_ms(sr);
+    // 窗口打开之前的命令标注不再有效
+    while (sr->command_next < sr->labels->command_count && sr->labels->command_ms[sr->command_next] < sr->mn_start_ms) {
+        sr->command_next++;
+    }
+}
+
+sr_stub_mn_t sr_stub_mn_detect(sr_stub_t *sr, int *command_id)
+{
+    if (!sr->mn_open) {
+        return SR_STUB_MN_TIMEOUT;
+    }
+    uint32_t now_ms = sr_stub_time_ms(sr);
+    if (sr->command_next < sr->labels->command_count && now_ms >= sr->labels->command_ms[sr->command_next]) {
+        *command_id = sr->labels->command_id[sr->command_next++];
+        sr->mn_open = false;
+        return SR_STUB_MN_DETECTED;
+    }
+    if (now_ms - sr->mn_start_ms >= SR_STUB_MN_DURATION_MS) {
+        sr->mn_open = false;
+        return SR_STUB_MN_TIMEOUT;
+    }
+    return SR_STUB_MN_DETECTING;
+}
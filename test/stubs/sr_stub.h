@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+// 主机测试用的 AFE/WakeNet/VAD/MultiNet 替身: VAD 按能量判断, 唤醒词和命令按标注时间给出
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SR_STUB_CHUNK           (512)   /*!< AFE fetch chunk at 16 kHz, 32 ms */
+#define SR_STUB_LABEL_MAX       (32)
+#define SR_STUB_MN_DURATION_MS  (3000)  /*!< Same window as SR_MN_DURATION_MS in app_sr.c */
+
+typedef enum {
+    SR_STUB_WAKE_NONE = 0,
+    SR_STUB_WAKE_DETECTED,      /*!< WAKENET_DETECTED */
+    SR_STUB_WAKE_VERIFIED,      /*!< WAKENET_CHANNEL_VERIFIED, one frame after the detection */
+} sr_stub_wake_t;
+
+typedef enum {
+    SR_STUB_MN_DETECTING = 0,
+    SR_STUB_MN_DETECTED,
+    SR_STUB_MN_TIMEOUT,
+} sr_stub_mn_t;
+
+typedef struct {
+    uint32_t wake_ms[SR_STUB_LABEL_MAX];        /*!< End of each wake word in the file */
+    size_t wake_count;
+    uint32_t command_ms[SR_STUB_LABEL_MAX];     /*!< When MultiNet reports each command */
+    int command_id[SR_STUB_LABEL_MAX];
+    size_t command_count;
+} sr_stub_labels_t;
+
+typedef struct {
+    int16_t data[SR_STUB_CHUNK];    /*!< Channel 0 of the fed frame */
+    size_t samples;
+    bool speech;                    /*!< VAD result */
+    sr_stub_wake_t wakeup_state;
+} sr_stub_result_t;
+
+typedef struct {
+    const sr_stub_labels_t *labels;
+    uint32_t frames;
+    float noise_db;
+    bool noise_valid;
+    int hangover;                   /*!< Speech frames still reported after the energy drops */
+    size_t wake_next;
+    bool verify_pending;
+    bool wakenet_enabled;
+    bool mn_open;
+    uint32_t mn_start_ms;
+    size_t command_next;
+} sr_stub_t;
+
+void sr_stub_init(sr_stub_t *sr, const sr_stub_labels_t *labels);
+
+/**
+ * @brief Feed one chunk in the 3-channel AFE layout and fetch the result, like afe feed + fetch.
+ */
+void sr_stub_process(sr_stub_t *sr, const int16_t *feed, size_t frames, sr_stub_result_t *res);
+
+/**
+ * @brief Current position, end of the last processed frame.
+ */
+uint32_t sr_stub_time_ms(const sr_stub_t *sr);
+
+void sr_stub_enable_wakenet(sr_stub_t *sr, bool enable);
+
+/**
+ * @brief Open the MultiNet window, like multinet->clean.
+ */
+void sr_stub_mn_clean(sr_stub_t *sr);
+
+/**
+ * @brief MultiNet result of the last processed frame, like multinet->detect.
+ */
+sr_stub_mn_t sr_stub_mn_detect(sr_stub_t *sr, int *command_id);
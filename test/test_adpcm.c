@@ -0,0 +1,227 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "app_adpcm.h"
+#include "test_util.h"
+
+#define ADPCM_RATE      (16000)
+
+// 按 IMA/DVI 规范独立实现的解码器, 用来检查编码结果
+static const int16_t ref_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static int16_t ref_decode_nibble(int32_t *predictor, int32_t *index, uint8_t nibble)
+{
+    int32_t step = ref_step_table[*index];
+    int32_t diff = step >> 3;
+    if (nibble & 4) {
+        diff += step;
+    }
+    if (nibble & 2) {
+        diff += step >> 1;
+    }
+    if (nibble & 1) {
+        diff += step >> 2;
+    }
+    *predictor += (nibble & 8) ? -diff : diff;
+    *predictor = *predictor > 32767 ? 32767 : (*predictor < -32768 ? -32768 : *predictor);
+    static const int8_t adjust[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+    *index += adjust[nibble & 7];
+    *index = *index < 0 ? 0 : (*index > 88 ? 88 : *index);
+    return (int16_t)*predictor;
+}
+
+// 解码一个块, 返回 APP_ADPCM_SAMPLES_PER_BLOCK 个采样
+static void ref_decode_block(const uint8_t *block, int16_t *out)
+{
+    int32_t predictor = (int16_t)(block[0] | (block[1] << 8));
+    int32_t index = block[2];
+    CHECK(index <= 88 && block[3] == 0);
+    out[0] = (int16_t)predictor;
+    for (int i = 0; i < (APP_ADPCM_BLOCK_SIZE - 4); i++) {
+        out[1 + i * 2] = ref_decode_nibble(&predictor, &index, block[4 + i] & 0x0f);
+        out[2 + i * 2] = ref_decode_nibble(&predictor, &index, block[4 + i] >> 4);
+    }
+}
+
+static double snr_db(const int16_t *ref, const int16_t *out, size_t n)
+{
+    double sig = 0, err = 0;
+    for (size_t i = 0; i < n; i++) {
+        sig += (double)ref[i] * ref[i];
+        err += (double)(ref[i] - out[i]) * (ref[i] - out[i]);
+    }
+    return 10.0 * log10(sig / (err + 1e-9));
+}
+
+// 类语音信号: 谐波加音节包络
+static void make_signal(int16_t *pcm, size_t n, float amplitude)
+{
+    for (size_t i = 0; i < n; i++) {
+        float t = (float)i / ADPCM_RATE;
+        float env = 0.6f - 0.4f * cosf(2.0f * (float)M_PI * 4.0f * t);
+        float v = 0;
+        for (int h = 1; h <= 5; h++) {
+            v += sinf(2.0f * (float)M_PI * 180.0f * h * t) / h;
+        }
+        pcm[i] = (int16_t)lrintf(v * env * amplitude);
+    }
+}
+
+static size_t encode_all(const int16_t *pcm, size_t n, size_t stride, size_t chunk, uint8_t *out, size_t out_size,
+                         app_adpcm_encoder_t *enc)
+{
+    app_adpcm_encoder_reset(enc);
+    size_t len = 0;
+    for (size_t pos = 0; pos < n;) {
+        size_t take = chunk ? chunk : (size_t)(1 + rand() % 700);
+        take = take < n - pos ? take : n - pos;
+        len += app_adpcm_encode(enc, pcm + pos * stride, take, stride, out + len, out_size - len);
+        pos += take;
+    }
+    len += app_adpcm_encoder_flush(enc, out + len, out_size - len);
+    return len;
+}
+
+static void test_round_trip(void)
+{
+    const size_t n = ADPCM_RATE * 2 + 123;
+    int16_t *pcm = malloc(n * sizeof(int16_t));
+    make_signal(pcm, n, 9000);
+    size_t blocks = (n + APP_ADPCM_SAMPLES_PER_BLOCK - 1) / APP_ADPCM_SAMPLES_PER_BLOCK;
+    uint8_t *adpcm = malloc(blocks * APP_ADPCM_BLOCK_SIZE);
+    int16_t *decoded = malloc(blocks * APP_ADPCM_SAMPLES_PER_BLOCK * sizeof(int16_t));
+
+    app_adpcm_encoder_t enc;
+    size_t len = encode_all(pcm, n, 1, 0, adpcm, blocks * APP_ADPCM_BLOCK_SIZE, &enc);
+    CHECK(len == blocks * APP_ADPCM_BLOCK_SIZE);
+    CHECK(enc.samples == n);
+    for (size_t b = 0; b < blocks; b++) {
+        ref_decode_block(adpcm + b * APP_ADPCM_BLOCK_SIZE, decoded + b * APP_ADPCM_SAMPLES_PER_BLOCK);
+    }
+    double snr = snr_db(pcm, decoded, n);
+    printf("round trip: %zu samples -> %zu bytes (%.2f bits/sample), snr %.1f dB\n", n, len, len * 8.0 / n, snr);
+    CHECK(snr > 25.0);
+    // 末尾不足一块时用最后一个采样补齐
+    for (size_t i = n; i < blocks * APP_ADPCM_SAMPLES_PER_BLOCK; i++) {
+        CHECK(abs(decoded[i] - pcm[n - 1]) < 600);
+    }
+    free(pcm);
+    free(adpcm);
+    free(decoded);
+}
+
+// 分块大小和声道间隔不影响输出
+static void test_chunking_and_stride(void)
+{
+    const size_t n = APP_ADPCM_SAMPLES_PER_BLOCK * 7 + 11;
+    int16_t *mono = malloc(n * sizeof(int16_t));
+    int16_t *stereo = malloc(n * 2 * sizeof(int16_t));
+    make_signal(mono, n, 12000);
+    for (size_t i = 0; i < n; i++) {
+        stereo[i * 2] = mono[i];
+        stereo[i * 2 + 1] = (int16_t)(-mono[i] / 3);
+    }
+    const size_t size = 8 * APP_ADPCM_BLOCK_SIZE;
+    uint8_t *a = malloc(size), *b = malloc(size), *c = malloc(size);
+    app_adpcm_encoder_t enc;
+    size_t la = encode_all(mono, n, 1, n, a, size, &enc);
+    size_t lb = encode_all(mono, n, 1, 0, b, size, &enc);
+    size_t lc = encode_all(stereo, n, 2, 512, c, size, &enc);
+    CHECK(la == size && lb == la && lc == la);
+    CHECK(memcmp(a, b, la) == 0 && memcmp(a, c, la) == 0);
+    free(mono);
+    free(stereo);
+    free(a);
+    free(b);
+    free(c);
+}
+
+// 满幅方波: 预测值和步长索引都要夹在范围内
+static void test_full_scale(void)
+{
+    int16_t pcm[APP_ADPCM_SAMPLES_PER_BLOCK];
+    for (int i = 0; i < APP_ADPCM_SAMPLES_PER_BLOCK; i++) {
+        pcm[i] = ((i / 8) & 1) ? INT16_MAX : INT16_MIN;
+    }
+    uint8_t block[APP_ADPCM_BLOCK_SIZE];
+    int16_t decoded[APP_ADPCM_SAMPLES_PER_BLOCK];
+    app_adpcm_encoder_t enc;
+    app_adpcm_encoder_reset(&enc);
+    CHECK(app_adpcm_encode(&enc, pcm, APP_ADPCM_SAMPLES_PER_BLOCK, 1, block, sizeof(block)) == sizeof(block));
+    CHECK(enc.index >= 0 && enc.index <= 88);
+    ref_decode_block(block, decoded);
+    // 步长适应之后, 每半个周期的末尾解码值与输入同号, 没有溢出翻转
+    for (int i = 64 + 7; i < APP_ADPCM_SAMPLES_PER_BLOCK; i += 8) {
+        CHECK_MSG((decoded[i] > 0) == (pcm[i] > 0), "sample %d: %d", i, decoded[i]);
+    }
+}
+
+// 输出空间不足时只写完整的块, 其余输入丢弃
+static void test_output_full(void)
+{
+    const size_t n = APP_ADPCM_SAMPLES_PER_BLOCK * 3;
+    int16_t *pcm = calloc(n, sizeof(int16_t));
+    uint8_t out[APP_ADPCM_BLOCK_SIZE * 2 - 1];
+    app_adpcm_encoder_t enc;
+    app_adpcm_encoder_reset(&enc);
+    CHECK(app_adpcm_encode(&enc, pcm, n, 1, out, sizeof(out)) == APP_ADPCM_BLOCK_SIZE);
+    CHECK(enc.samples == APP_ADPCM_SAMPLES_PER_BLOCK);
+    CHECK(app_adpcm_encoder_flush(&enc, out, APP_ADPCM_BLOCK_SIZE - 1) == 0);
+    free(pcm);
+}
+
+static void test_wav_header(void)
+{
+    app_adpcm_wav_header_t head;
+    CHECK(sizeof(head) == 60);
+    app_adpcm_wav_header(&head, ADPCM_RATE, 1000, 3 * APP_ADPCM_BLOCK_SIZE);
+    CHECK(memcmp(head.riff, "RIFF", 4) == 0 && memcmp(head.data, "data", 4) == 0 && memcmp(head.fact, "fact", 4) == 0);
+    CHECK(head.riff_size == sizeof(head) - 8 + 3 * APP_ADPCM_BLOCK_SIZE);
+    CHECK(head.audio_format == 0x11 && head.channels == 1 && head.bits_per_sample == 4);
+    CHECK(head.block_align == APP_ADPCM_BLOCK_SIZE && head.samples_per_block == APP_ADPCM_SAMPLES_PER_BLOCK);
+    CHECK(head.sample_count == 1000 && head.data_size == 3 * APP_ADPCM_BLOCK_SIZE);
+    CHECK(head.byte_rate == ADPCM_RATE * APP_ADPCM_BLOCK_SIZE / APP_ADPCM_SAMPLES_PER_BLOCK);
+}
+
+// 基准: 每秒音频的编码耗时, 按 AFE 的 512 点块和双声道间隔送入
+static void bench_encode(void)
+{
+    const size_t seconds = 60;
+    const size_t n = ADPCM_RATE * seconds;
+    int16_t *pcm = malloc(n * 2 * sizeof(int16_t));
+    make_signal(pcm, n * 2, 9000);
+    size_t size = (n / APP_ADPCM_SAMPLES_PER_BLOCK + 1) * APP_ADPCM_BLOCK_SIZE;
+    uint8_t *out = malloc(size);
+    app_adpcm_encoder_t enc;
+    double start = test_now_us();
+    size_t len = encode_all(pcm, n, 2, 512, out, size, &enc);
+    double us = test_now_us() - start;
+    printf("bench encode: %.1f us per second of audio (%zu bytes for %zu s)\n", us / seconds, len, seconds);
+    CHECK(len == size);
+    free(pcm);
+    free(out);
+}
+
+int main(void)
+{
+    srand(1);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_chunking_and_stride);
+    RUN_TEST(test_full_scale);
+    RUN_TEST(test_output_full);
+    RUN_TEST(test_wav_header);
+    RUN_TEST(bench_encode);
+    return TEST_EXIT();
+}
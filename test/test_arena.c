@@ -0,0 +1,374 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "app_arena.h"
+#include "test_util.h"
+
+#define ARENA_SIZE          (CONFIG_TURN_ARENA_SIZE)
+#define ARENA_HALF          (ARENA_SIZE / 2)
+
+static bool in_half(app_arena_handle_t arena, const void *base, const void *ptr, int half)
+{
+    const uint8_t *p = ptr;
+    const uint8_t *b = base;
+    return p >= b + half * ARENA_HALF && p < b + (half + 1) * ARENA_HALF;
+}
+
+// 分配按 8 字节对齐且互不重叠, strndup 截断并补结尾
+static void test_alignment_and_strndup(void)
+{
+    app_arena_handle_t arena = app_arena_create(ARENA_SIZE, MALLOC_CAP_SPIRAM);
+    CHECK(arena != NULL);
+    uint8_t *last = NULL;
+    for (size_t size = 0; size < 40; size++) {
+        uint8_t *p = app_arena_alloc(arena, size);
+        CHECK_MSG(((uintptr_t)p & 7) == 0, "size %zu", size);
+        CHECK(last == NULL || p > last);
+        memset(p, 0x5a, size);
+        last = p;
+    }
+    char *s = app_arena_strndup(arena, "http://example.com/a.mp3\"tail", 24);
+    CHECK(strcmp(s, "http://example.com/a.mp3") == 0);
+    s = app_arena_strndup(arena, "short", 100);
+    CHECK(strcmp(s, "short") == 0);
+
+    app_arena_stats_t stats;
+    app_arena_get_stats(arena, &stats);
+    CHECK(stats.size == ARENA_SIZE && stats.live == 42 && stats.fallbacks == 0);
+    CHECK(stats.used == stats.high_water && stats.used % 8 == 0);
+    app_arena_delete(arena);
+}
+
+// 全部释放后复位从当前一半的开头重新分配
+static void test_rewind(void)
+{
+    app_arena_handle_t arena = app_arena_create(ARENA_SIZE, MALLOC_CAP_SPIRAM);
+    void *first = app_arena_alloc(arena, 100);
+    void *second = app_arena_alloc(arena, 100);
+    app_arena_free(arena, first);
+    app_arena_free(arena, second);
+    app_arena_free(arena, NULL);
+    CHECK(app_arena_reset(arena));
+    CHECK(app_arena_alloc(arena, 10) == first);
+
+    app_arena_stats_t stats;
+    app_arena_get_stats(arena, &stats);
+    CHECK(stats.resets == 1 && stats.used == 16 && stats.high_water == 208 && stats.live == 1);
+    app_arena_delete(arena);
+}
+
+// 上一轮的缓冲区未释放时换到另一半, 内容不被覆盖; 两半都在用时复位等到释放
+static void test_halves_and_deferred_reset(void)
+{
+    app_arena_handle_t arena = app_arena_create(ARENA_SIZE, MALLOC_CAP_SPIRAM);
+    char *held = app_arena_strndup(arena, "held by the fetch task", 64);
+    void *base = held;
+    CHECK(app_arena_reset(arena));
+    // 填满另一半, 仍在使用的字符串不变
+    void *blocks[ARENA_HALF / 64];
+    for (size_t i = 0; i < ARENA_HALF / 64; i++) {
+        blocks[i] = app_arena_alloc(arena, 64);
+        CHECK(in_half(arena, base, blocks[i], 1));
+        memset(blocks[i], 0xff, 64);
+    }
+    CHECK(strcmp(held, "held by the fetch task") == 0);
+
+    // 当前一半的块释放后原地复位
+    for (size_t i = 0; i < ARENA_HALF / 64; i++) {
+        app_arena_free(arena, blocks[i]);
+    }
+    CHECK(app_arena_reset(arena));
+    void *cur = app_arena_alloc(arena, 32);
+    CHECK(cur == blocks[0]);
+
+    // 两半都有块在用, 复位延后, 分配继续使用当前一半
+    CHECK(!app_arena_reset(arena));
+    CHECK(!app_arena_reset(arena));
+    void *more = app_arena_alloc(arena, 32);
+    CHECK(in_half(arena, base, more, 1));
+    app_arena_stats_t stats;
+    app_arena_get_stats(arena, &stats);
+    CHECK(stats.deferred == 1 && stats.resets == 2);
+
+    // 最后一个旧块释放时完成复位, 换回前一半
+    app_arena_free(arena, held);
+    app_arena_get_stats(arena, &stats);
+    CHECK(stats.resets == 3 && stats.used == 0 && stats.live == 2);
+    CHECK(app_arena_alloc(arena, 8) == base);
+    app_arena_delete(arena);
+}
+
+// 一半用满后由堆分配, 计入回退和在用块数, 释放时还给堆
+static void test_heap_fallback(void)
+{
+    app_arena_handle_t arena = app_arena_create(ARENA_SIZE, MALLOC_CAP_SPIRAM);
+    void *big = app_arena_alloc(arena, ARENA_HALF - 8);
+    void *tail = app_arena_alloc(arena, 8);
+    void *heap = app_arena_alloc(arena, 1);
+    CHECK(big && tail && heap);
+    CHECK((uint8_t *)tail == (uint8_t *)big + ARENA_HALF - 8);
+
+    app_arena_stats_t stats;
+    app_arena_get_stats(arena, &stats);
+    CHECK(stats.fallbacks == 1 && stats.live == 3 && stats.high_water == ARENA_HALF);
+    // 比一半还大的块直接由堆分配
+    void *huge = app_arena_alloc(arena, ARENA_SIZE);
+    CHECK(huge != NULL);
+    memset(huge, 0, ARENA_SIZE);
+    app_arena_free(arena, heap);
+    app_arena_free(arena, huge);
+    app_arena_free(arena, big);
+    app_arena_free(arena, tail);
+    app_arena_get_stats(arena, &stats);
+    CHECK(stats.fallbacks == 2 && stats.live == 0);
+    CHECK(app_arena_reset(arena));
+    app_arena_delete(arena);
+}
+
+/*
+ * 碎片基准: 用首次适配的堆模型重放一万轮对话, 对比每轮的临时缓冲区由堆分配
+ * 和由区域分配时, 长期存活的分配 (TTS 缓存条目) 周围留下的空洞.
+ */
+#define MODEL_HEAP_SIZE     (128 * 1024)
+#define MODEL_EXTENTS_MAX   (1024)
+#define MODEL_ALIGN(x)      (((x) + 7) & ~(uint32_t)7)
+#define MODEL_NONE          (UINT32_MAX)
+#define BENCH_TURNS         (10000)
+#define BENCH_CACHE_SLOTS   (16)
+#define BENCH_SEGMENTS_MAX  (6)
+
+typedef struct {
+    uint32_t off;
+    uint32_t len;
+} model_extent_t;
+
+// 按地址排序的空闲区间, 释放时与相邻区间合并
+static struct {
+    model_extent_t free[MODEL_EXTENTS_MAX];
+    size_t count;
+} model;
+
+static void model_init(void)
+{
+    model.free[0] = (model_extent_t) { 0, MODEL_HEAP_SIZE };
+    model.count = 1;
+}
+
+static uint32_t model_alloc(uint32_t size)
+{
+    size = MODEL_ALIGN(size);
+    for (size_t i = 0; i < model.count; i++) {
+        if (model.free[i].len >= size) {
+            uint32_t off = model.free[i].off;
+            model.free[i].off += size;
+            model.free[i].len -= size;
+            if (model.free[i].len == 0) {
+                memmove(&model.free[i], &model.free[i + 1], (model.count - i - 1) * sizeof(model_extent_t));
+                model.count--;
+            }
+            return off;
+        }
+    }
+    return MODEL_NONE;
+}
+
+static void model_free(uint32_t off, uint32_t size)
+{
+    size = MODEL_ALIGN(size);
+    size_t i = 0;
+    while (i < model.count && model.free[i].off < off) {
+        i++;
+    }
+    bool prev = i > 0 && model.free[i - 1].off + model.free[i - 1].len == off;
+    bool next = i < model.count && off + size == model.free[i].off;
+    if (prev && next) {
+        model.free[i - 1].len += size + model.free[i].len;
+        memmove(&model.free[i], &model.free[i + 1], (model.count - i - 1) * sizeof(model_extent_t));
+        model.count--;
+    } else if (prev) {
+        model.free[i - 1].len += size;
+    } else if (next) {
+        model.free[i].off = off;
+        model.free[i].len += size;
+    } else {
+        CHECK(model.count < MODEL_EXTENTS_MAX);
+        memmove(&model.free[i + 1], &model.free[i], (model.count - i) * sizeof(model_extent_t));
+        model.free[i] = (model_extent_t) { off, size };
+        model.count++;
+    }
+}
+
+static uint32_t model_largest(void)
+{
+    uint32_t largest = 0;
+    for (size_t i = 0; i < model.count; i++) {
+        largest = model.free[i].len > largest ? model.free[i].len : largest;
+    }
+    return largest;
+}
+
+// 1 - 最大空闲块 / 空闲总量
+static double model_fragmentation(void)
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < model.count; i++) {
+        total += model.free[i].len;
+    }
+    return total ? 1.0 - (double)model_largest() / total : 0.0;
+}
+
+typedef struct {
+    uint32_t off;
+    uint32_t size;
+    void *ptr;                  /*!< Arena block, NULL when taken from the heap model */
+} bench_block_t;
+
+typedef struct {
+    double frag_mean;
+    double frag_max;
+    double holes_mean;          /*!< Free extents, one means no fragmentation */
+    uint32_t largest_min;
+    uint32_t cache_failures;
+} bench_result_t;
+
+static uint32_t bench_rand(uint32_t *seed, uint32_t lo, uint32_t hi)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return lo + (*seed >> 8) % (hi - lo + 1);
+}
+
+static bench_block_t bench_alloc(app_arena_handle_t arena, uint32_t size)
+{
+    bench_block_t block = { MODEL_NONE, size, NULL };
+    if (arena) {
+        block.ptr = app_arena_alloc(arena, size);
+        CHECK(block.ptr != NULL);
+    } else {
+        block.off = model_alloc(size);
+        CHECK(block.off != MODEL_NONE);
+    }
+    return block;
+}
+
+static void bench_free(app_arena_handle_t arena, bench_block_t *block)
+{
+    if (block->ptr) {
+        app_arena_free(arena, block->ptr);
+    } else if (block->off != MODEL_NONE) {
+        model_free(block->off, block->size);
+    }
+    block->ptr = NULL;
+    block->off = MODEL_NONE;
+}
+
+/*
+ * 每轮: 1~6 段语音链接随 SSE 事件到达, 中途按一半的概率存入一个 1~8 KB 的缓存条目,
+ * 存活 8~64 轮 (槽满时淘汰最旧的); 之后解码回复文本. 最后一段链接被 TTS 下载任务
+ * 持有到下一轮开始之后才释放. arena 为 NULL 时临时缓冲区也由堆模型分配.
+ */
+static bench_result_t bench_turns(app_arena_handle_t arena)
+{
+    bench_result_t result = { 0, 0, 0, MODEL_HEAP_SIZE, 0 };
+    bench_block_t cache[BENCH_CACHE_SLOTS];
+    uint32_t expires[BENCH_CACHE_SLOTS] = {0};
+    bench_block_t held = { MODEL_NONE, 0, NULL };
+    uint32_t seed = 1;
+    size_t next_slot = 0;
+    for (size_t i = 0; i < BENCH_CACHE_SLOTS; i++) {
+        cache[i] = (bench_block_t) { MODEL_NONE, 0, NULL };
+    }
+    model_init();
+
+    for (uint32_t turn = 1; turn <= BENCH_TURNS; turn++) {
+        if (arena) {
+            app_arena_reset(arena);
+        }
+        bench_free(arena, &held);
+        for (size_t i = 0; i < BENCH_CACHE_SLOTS; i++) {
+            if (expires[i] == turn) {
+                bench_free(NULL, &cache[i]);
+            }
+        }
+
+        bench_block_t urls[BENCH_SEGMENTS_MAX];
+        uint32_t segments = bench_rand(&seed, 1, BENCH_SEGMENTS_MAX);
+        uint32_t cache_at = bench_rand(&seed, 0, 2 * segments - 1);
+        for (uint32_t s = 0; s < segments; s++) {
+            urls[s] = bench_alloc(arena, bench_rand(&seed, 80, 240));
+            if (s == cache_at) {
+                size_t slot = next_slot++ % BENCH_CACHE_SLOTS;
+                bench_free(NULL, &cache[slot]);
+                uint32_t size = bench_rand(&seed, 1024, 8192);
+                cache[slot] = (bench_block_t) { model_alloc(size), size, NULL };
+                result.cache_failures += cache[slot].off == MODEL_NONE;
+                expires[slot] = turn + bench_rand(&seed, 8, 64);
+            }
+        }
+        bench_block_t text = bench_alloc(arena, bench_rand(&seed, 100, 1200));
+        bench_free(arena, &text);
+        for (uint32_t s = 0; s + 1 < segments; s++) {
+            bench_free(arena, &urls[s]);
+        }
+        held = urls[segments - 1];
+
+        double frag = model_fragmentation();
+        uint32_t largest = model_largest();
+        result.frag_mean += frag / BENCH_TURNS;
+        result.holes_mean += (double)model.count / BENCH_TURNS;
+        result.frag_max = frag > result.frag_max ? frag : result.frag_max;
+        result.largest_min = largest < result.largest_min ? largest : result.largest_min;
+    }
+
+    bench_free(arena, &held);
+    for (size_t i = 0; i < BENCH_CACHE_SLOTS; i++) {
+        bench_free(NULL, &cache[i]);
+    }
+    CHECK(model.count == 1 && model.free[0].len == MODEL_HEAP_SIZE);
+    return result;
+}
+
+static void bench_fragmentation(void)
+{
+    bench_result_t heap = bench_turns(NULL);
+    app_arena_handle_t arena = app_arena_create(ARENA_SIZE, MALLOC_CAP_SPIRAM);
+    bench_result_t carved = bench_turns(arena);
+    app_arena_stats_t stats;
+    app_arena_get_stats(arena, &stats);
+    app_arena_delete(arena);
+
+    printf("bench %d turns, %d KB heap: per-turn buffers on the heap: fragmentation mean %.3f max %.3f, "
+           "%.1f free blocks, largest free min %" PRIu32 " B, %" PRIu32 " cache misses\n",
+           BENCH_TURNS, MODEL_HEAP_SIZE / 1024, heap.frag_mean, heap.frag_max, heap.holes_mean, heap.largest_min,
+           heap.cache_failures);
+    printf("bench %d turns, %d KB heap: per-turn buffers in the arena: fragmentation mean %.3f max %.3f, "
+           "%.1f free blocks, largest free min %" PRIu32 " B, %" PRIu32 " cache misses\n",
+           BENCH_TURNS, MODEL_HEAP_SIZE / 1024, carved.frag_mean, carved.frag_max, carved.holes_mean, carved.largest_min,
+           carved.cache_failures);
+    printf("arena: high water %" PRIu32 " / %d B per half, %" PRIu32 " resets, %" PRIu32 " deferred, %" PRIu32 " fallbacks\n",
+           stats.high_water, ARENA_HALF, stats.resets, stats.deferred, stats.fallbacks);
+
+    // 每轮都有一个链接跨过复位, 复位仍从不延后, 也不回退到堆
+    CHECK(stats.resets == BENCH_TURNS && stats.deferred == 0 && stats.fallbacks == 0 && stats.live == 0);
+    // 碎片主要来自缓存条目的淘汰, 临时缓冲区移出堆之后空洞更少, 最大空闲块不变小
+    CHECK(carved.holes_mean < heap.holes_mean);
+    CHECK(carved.largest_min >= heap.largest_min);
+    CHECK(carved.cache_failures <= heap.cache_failures);
+}
+
+int main(void)
+{
+    RUN_TEST(test_alignment_and_strndup);
+    RUN_TEST(test_rewind);
+    RUN_TEST(test_halves_and_deferred_reset);
+    RUN_TEST(test_heap_fallback);
+    RUN_TEST(bench_fragmentation);
+    return TEST_EXIT();
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "app_dsp.h"
+#include "test_util.h"
+
+#define INTERLEAVE_FRAMES_MAX   (600)
+
+// 改动之前 audio_feed_task 里的原地展开循环, 参考通道固定为零
+static void feed_loop_before(int16_t *audio_buffer, int audio_chunksize)
+{
+    for (int  i = audio_chunksize - 1; i >= 0; i--) {
+        audio_buffer[i * 3 + 2] = 0;
+        audio_buffer[i * 3 + 1] = audio_buffer[i * 2 + 1];
+        audio_buffer[i * 3 + 0] = audio_buffer[i * 2 + 0];
+    }
+}
+
+static void fill_random(int16_t *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = (int16_t)rand();
+    }
+}
+
+// 原地展开, 与原来的循环逐位一致; 缓冲区按 4 字节对齐和错开 2 字节各测一遍
+static void test_in_place_matches_feed_loop(void)
+{
+    static uint32_t a_words[INTERLEAVE_FRAMES_MAX * 3 / 2 + 2];
+    static uint32_t b_words[INTERLEAVE_FRAMES_MAX * 3 / 2 + 2];
+    for (int offset = 0; offset < 2; offset++) {
+        int16_t *a = (int16_t *)a_words + offset;
+        int16_t *b = (int16_t *)b_words + offset;
+        for (size_t frames = 0; frames <= INTERLEAVE_FRAMES_MAX; frames++) {
+            fill_random(a, frames * 3);
+            memcpy(b, a, frames * 3 * sizeof(int16_t));
+            app_dsp_interleave_2to3(a, NULL, a, frames);
+            feed_loop_before(b, frames);
+            CHECK_MSG(memcmp(a, b, frames * 3 * sizeof(int16_t)) == 0, "offset %d, %zu frames", offset, frames);
+        }
+    }
+}
+
+// 分开的输入输出和参考通道, 覆盖所有对齐组合, 与逐采样版本逐位一致
+static void test_matches_ref(void)
+{
+    static uint32_t in_words[INTERLEAVE_FRAMES_MAX + 2];
+    static uint32_t ref_words[INTERLEAVE_FRAMES_MAX / 2 + 2];
+    static uint32_t out_words[INTERLEAVE_FRAMES_MAX * 3 / 2 + 4];
+    static int16_t expect[INTERLEAVE_FRAMES_MAX * 3 + 2];
+    for (int align = 0; align < 8; align++) {
+        const int16_t *in = (int16_t *)in_words + (align & 1);
+        int16_t *out = (int16_t *)out_words + ((align >> 1) & 1);
+        const int16_t *ref = (align & 4) ? (int16_t *)ref_words + 1 : (int16_t *)ref_words;
+        for (size_t frames = 0; frames <= 67; frames++) {
+            fill_random((int16_t *)in, frames * 2);
+            fill_random((int16_t *)ref, frames);
+            for (int with_ref = 0; with_ref < 2; with_ref++) {
+                const int16_t *r = with_ref ? ref : NULL;
+                // 输出区间之后的内容不能被改写
+                memset(out_words, 0xa5, sizeof(out_words));
+                app_dsp_interleave_2to3(in, r, out, frames);
+                app_dsp_interleave_2to3_ref(in, r, expect, frames);
+                CHECK_MSG(memcmp(out, expect, frames * 3 * sizeof(int16_t)) == 0,
+                          "align %d, ref %d, %zu frames", align, with_ref, frames);
+                CHECK((uint16_t)out[frames * 3] == 0xa5a5);
+                for (size_t i = 0; i < frames; i++) {
+                    CHECK(expect[i * 3 + 0] == in[i * 2 + 0] && expect[i * 3 + 1] == in[i * 2 + 1]);
+                    CHECK(expect[i * 3 + 2] == (r ? r[i] : 0));
+                }
+            }
+        }
+    }
+}
+
+// 基准: AFE 每块 512 帧, 原地展开, 与原来的循环对比
+static void bench_interleave(void)
+{
+    const size_t frames = 512;
+    const int rounds = 200000;
+    static uint32_t words[512 * 3 / 2];
+    static int16_t ref[512];
+    int16_t *buf = (int16_t *)words;
+    fill_random(buf, frames * 3);
+    fill_random(ref, frames);
+
+    double start = test_now_us();
+    for (int i = 0; i < rounds; i++) {
+        feed_loop_before(buf, frames);
+    }
+    double loop_ns = (test_now_us() - start) * 1000.0 / rounds / frames;
+
+    start = test_now_us();
+    for (int i = 0; i < rounds; i++) {
+        app_dsp_interleave_2to3(buf, NULL, buf, frames);
+    }
+    double kernel_ns = (test_now_us() - start) * 1000.0 / rounds / frames;
+
+    start = test_now_us();
+    for (int i = 0; i < rounds; i++) {
+        app_dsp_interleave_2to3(buf, ref, buf, frames);
+    }
+    double kernel_ref_ns = (test_now_us() - start) * 1000.0 / rounds / frames;
+
+    printf("bench interleave: feed loop %.2f ns/frame, kernel %.2f ns/frame, kernel with ref %.2f ns/frame\n",
+           loop_ns, kernel_ns, kernel_ref_ns);
+}
+
+int main(void)
+{
+    srand(1);
+    RUN_TEST(test_in_place_matches_feed_loop);
+    RUN_TEST(test_matches_ref);
+    RUN_TEST(bench_interleave);
+    return TEST_EXIT();
+}
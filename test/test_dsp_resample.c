@@ -0,0 +1,268 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "app_dsp.h"
+#include "test_util.h"
+
+#define RESAMPLE_OUT_RATE   (16000)     /*!< AUDIO_CODEC_SAMPLE_RATE */
+#define RESAMPLE_SECONDS    (1)
+
+static const uint32_t resample_rates[] = { 8000, 11025, 22050, 24000, 32000, 44100, 48000, 16000 };
+
+// 按给定的块大小送入和取出, 0 表示每次随机
+static size_t resample_all(app_dsp_resampler_t *rs, const int16_t *in, size_t in_frames, int16_t *out, size_t out_frames,
+                           size_t in_chunk, size_t out_chunk)
+{
+    size_t done = 0, produced = 0;
+    // 输入送完之后, 历史里可能还有没取走的输出
+    while (produced < out_frames) {
+        size_t take = in_chunk ? in_chunk : (size_t)(1 + rand() % 1200);
+        size_t room = out_chunk ? out_chunk : (size_t)(1 + rand() % 700);
+        take = take < in_frames - done ? take : in_frames - done;
+        room = room < out_frames - produced ? room : out_frames - produced;
+        size_t consumed;
+        size_t n = app_dsp_resample(rs, in + done * rs->channels, take, &consumed,
+                                    out + produced * rs->channels, room);
+        produced += n;
+        done += consumed;
+        if (n == 0 && consumed == 0) {
+            break;
+        }
+    }
+    return produced;
+}
+
+static void make_tone(int16_t *pcm, size_t frames, int channels, uint32_t rate, float freq, float amplitude)
+{
+    for (size_t i = 0; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            // 右声道用反相的信号, 检查两个声道互不影响
+            float v = amplitude * sinf(2.0f * (float)M_PI * freq * i / rate);
+            pcm[i * channels + c] = (int16_t)lrintf(c ? -v : v);
+        }
+    }
+}
+
+// 对输出做指定频率的最小二乘拟合, 返回幅度和残差的信噪比
+static float fit_tone(const int16_t *pcm, size_t frames, int channels, int channel, uint32_t rate, float freq,
+                      float *snr_db)
+{
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+    for (size_t i = 0; i < frames; i++) {
+        double s = sin(2.0 * M_PI * freq * i / rate);
+        double c = cos(2.0 * M_PI * freq * i / rate);
+        double y = pcm[i * channels + channel];
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        ys += y * s;
+        yc += y * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double sig = 0, err = 0;
+    for (size_t i = 0; i < frames; i++) {
+        double fit = a * sin(2.0 * M_PI * freq * i / rate) + b * cos(2.0 * M_PI * freq * i / rate);
+        double y = pcm[i * channels + channel];
+        sig += fit * fit;
+        err += (y - fit) * (y - fit);
+    }
+    if (snr_db) {
+        *snr_db = 10.0f * log10f((float)(sig / (err + 1e-9)));
+    }
+    return (float)sqrt(a * a + b * b);
+}
+
+static float rms(const int16_t *pcm, size_t frames, int channels, int channel)
+{
+    double sum = 0;
+    for (size_t i = 0; i < frames; i++) {
+        sum += (double)pcm[i * channels + channel] * pcm[i * channels + channel];
+    }
+    return (float)sqrt(sum / frames);
+}
+
+static void test_init(void)
+{
+    app_dsp_resampler_t rs = {0};
+    CHECK(app_dsp_resampler_init(&rs, 44100, RESAMPLE_OUT_RATE, 2) == ESP_OK);
+    CHECK(rs.up == 160 && rs.down == 441);
+    int16_t *coef = rs.coef;
+    // 参数不变时沿用系数
+    CHECK(app_dsp_resampler_init(&rs, 44100, RESAMPLE_OUT_RATE, 2) == ESP_OK && rs.coef == coef);
+    CHECK(app_dsp_resampler_init(&rs, 11025, RESAMPLE_OUT_RATE, 1) == ESP_OK && rs.up == 640 && rs.down == 441);
+    CHECK(app_dsp_resampler_init(&rs, 44101, RESAMPLE_OUT_RATE, 1) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(app_dsp_resampler_init(&rs, 44100, RESAMPLE_OUT_RATE, 3) == ESP_ERR_INVALID_ARG);
+    app_dsp_resampler_deinit(&rs);
+    CHECK(rs.coef == NULL && rs.work == NULL);
+}
+
+// 每个相位的系数之和为 1.0, 直流增益不变; 输出帧数等于 in * up / down
+static void test_dc_and_length(void)
+{
+    for (size_t r = 0; r < sizeof(resample_rates) / sizeof(resample_rates[0]); r++) {
+        uint32_t rate = resample_rates[r];
+        app_dsp_resampler_t rs = {0};
+        CHECK(app_dsp_resampler_init(&rs, rate, RESAMPLE_OUT_RATE, 1) == ESP_OK);
+        size_t frames = rate * RESAMPLE_SECONDS;
+        int16_t *in = malloc(frames * sizeof(int16_t));
+        int16_t *out = malloc((RESAMPLE_OUT_RATE * RESAMPLE_SECONDS + 64) * sizeof(int16_t));
+        for (size_t i = 0; i < frames; i++) {
+            in[i] = 12000;
+        }
+        size_t n = resample_all(&rs, in, frames, out, RESAMPLE_OUT_RATE * RESAMPLE_SECONDS + 64, 0, 0);
+        // 最后半个滤波器长度的输入还留在历史里
+        size_t expect = (uint64_t)frames * RESAMPLE_OUT_RATE / rate;
+        size_t lag = (APP_DSP_RESAMPLE_TAPS / 2) * RESAMPLE_OUT_RATE / rate + 1;
+        CHECK_MSG(n <= expect && n + lag >= expect, "%u Hz: %zu frames, expect %zu", rate, n, expect);
+        int worst = 0;
+        for (size_t i = APP_DSP_RESAMPLE_TAPS; i < n; i++) {
+            worst = abs(out[i] - 12000) > worst ? abs(out[i] - 12000) : worst;
+        }
+        CHECK_MSG(worst <= 4, "%u Hz: dc error %d", rate, worst);
+        app_dsp_resampler_deinit(&rs);
+        free(in);
+        free(out);
+    }
+}
+
+// 通带内的正弦: 增益接近 1, 失真和噪声远低于信号; 左右声道各自独立
+static void test_passband_tone(void)
+{
+    for (size_t r = 0; r < sizeof(resample_rates) / sizeof(resample_rates[0]); r++) {
+        uint32_t rate = resample_rates[r];
+        for (size_t f = 0; f < 2; f++) {
+            float freq = f ? 3000.0f : 440.0f;
+            if (freq > 0.4f * (rate < RESAMPLE_OUT_RATE ? rate : RESAMPLE_OUT_RATE)) {
+                continue;
+            }
+            app_dsp_resampler_t rs = {0};
+            CHECK(app_dsp_resampler_init(&rs, rate, RESAMPLE_OUT_RATE, 2) == ESP_OK);
+            size_t frames = rate * RESAMPLE_SECONDS;
+            int16_t *in = malloc(frames * 2 * sizeof(int16_t));
+            int16_t *out = malloc(RESAMPLE_OUT_RATE * RESAMPLE_SECONDS * 2 * sizeof(int16_t));
+            make_tone(in, frames, 2, rate, freq, 16000);
+            size_t n = resample_all(&rs, in, frames, out, RESAMPLE_OUT_RATE * RESAMPLE_SECONDS, 0, 0);
+            for (int c = 0; c < 2; c++) {
+                float snr;
+                float amp = fit_tone(out + APP_DSP_RESAMPLE_TAPS * 2, n - APP_DSP_RESAMPLE_TAPS, 2, c,
+                                     RESAMPLE_OUT_RATE, freq, &snr);
+                float gain_db = 20.0f * log10f(amp / 16000);
+                CHECK_MSG(fabsf(gain_db) < 0.1f && snr > 60.0f, "%u Hz, %.0f Hz tone, ch %d: gain %.3f dB, snr %.1f dB",
+                          rate, freq, c, gain_db, snr);
+            }
+            app_dsp_resampler_deinit(&rs);
+            free(in);
+            free(out);
+        }
+    }
+}
+
+// 降采样时, 高于输出奈奎斯特频率的信号要被滤掉, 不能折叠到通带里
+static void test_alias_rejection(void)
+{
+    const uint32_t rates[] = { 22050, 24000, 44100, 48000 };
+    const float freqs[] = { 10000.0f, 12000.0f, 15000.0f, 20000.0f };
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+            if (freqs[f] >= rates[r] / 2) {
+                continue;
+            }
+            app_dsp_resampler_t rs = {0};
+            CHECK(app_dsp_resampler_init(&rs, rates[r], RESAMPLE_OUT_RATE, 1) == ESP_OK);
+            size_t frames = rates[r] * RESAMPLE_SECONDS;
+            int16_t *in = malloc(frames * sizeof(int16_t));
+            int16_t *out = malloc(RESAMPLE_OUT_RATE * RESAMPLE_SECONDS * sizeof(int16_t));
+            make_tone(in, frames, 1, rates[r], freqs[f], 16000);
+            size_t n = resample_all(&rs, in, frames, out, RESAMPLE_OUT_RATE * RESAMPLE_SECONDS, 0, 0);
+            float level_db = 20.0f * log10f(rms(out + APP_DSP_RESAMPLE_TAPS, n - APP_DSP_RESAMPLE_TAPS, 1, 0) /
+                                            (16000 / sqrtf(2)) + 1e-9f);
+            // 每相位固定 32 个抽头, 44.1/48 kHz 输入时过渡带延伸到 11 kHz 左右, 10 kHz 只要求 30 dB
+            float limit = freqs[f] < 12000.0f ? -30.0f : -50.0f;
+            CHECK_MSG(level_db < limit, "%u Hz, %.0f Hz tone: %.1f dB", rates[r], freqs[f], level_db);
+            app_dsp_resampler_deinit(&rs);
+            free(in);
+            free(out);
+        }
+    }
+}
+
+// 送入和取出的块大小不影响结果, 复位后与新建的转换器一致
+static void test_chunking_and_reset(void)
+{
+    const uint32_t rate = 22050;
+    const size_t frames = rate / 2;
+    const size_t cap = RESAMPLE_OUT_RATE;
+    int16_t *in = malloc(frames * 2 * sizeof(int16_t));
+    int16_t *a = malloc(cap * 2 * sizeof(int16_t));
+    int16_t *b = malloc(cap * 2 * sizeof(int16_t));
+    for (size_t i = 0; i < frames * 2; i++) {
+        in[i] = (int16_t)rand();
+    }
+    app_dsp_resampler_t rs = {0};
+    CHECK(app_dsp_resampler_init(&rs, rate, RESAMPLE_OUT_RATE, 2) == ESP_OK);
+    size_t na = resample_all(&rs, in, frames, a, cap, frames, cap);
+    app_dsp_resampler_reset(&rs);
+    size_t nb = resample_all(&rs, in, frames, b, cap, 0, 0);
+    CHECK(na == nb && memcmp(a, b, na * 2 * sizeof(int16_t)) == 0);
+    app_dsp_resampler_reset(&rs);
+    nb = resample_all(&rs, in, frames, b, cap, 1, 1);
+    CHECK(na == nb && memcmp(a, b, na * 2 * sizeof(int16_t)) == 0);
+    app_dsp_resampler_deinit(&rs);
+    free(in);
+    free(a);
+    free(b);
+}
+
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 基准: 解码器常见的采样率, 双声道, 按播放路径的 256 帧输出块
+static void bench_resample(void)
+{
+    const uint32_t rates[] = { 22050, 24000, 44100 };
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        const size_t seconds = 10;
+        size_t frames = rates[r] * seconds;
+        int16_t *in = malloc(frames * 2 * sizeof(int16_t));
+        int16_t *out = malloc(RESAMPLE_OUT_RATE * seconds * 2 * sizeof(int16_t));
+        make_tone(in, frames, 2, rates[r], 1000.0f, 12000);
+        app_dsp_resampler_t rs = {0};
+        app_dsp_resampler_init(&rs, rates[r], RESAMPLE_OUT_RATE, 2);
+        double start = test_now_us();
+        uint64_t cycles = bench_cycles();
+        size_t n = resample_all(&rs, in, frames, out, RESAMPLE_OUT_RATE * seconds, frames, 256);
+        cycles = bench_cycles() - cycles;
+        double us = test_now_us() - start;
+        printf("bench resample %u -> %u Hz stereo: %.1f ns, %.0f host cycles per output frame\n",
+               rates[r], RESAMPLE_OUT_RATE, us * 1000.0 / n, (double)cycles / n);
+        app_dsp_resampler_deinit(&rs);
+        free(in);
+        free(out);
+    }
+}
+
+int main(void)
+{
+    srand(1);
+    RUN_TEST(test_init);
+    RUN_TEST(test_dc_and_length);
+    RUN_TEST(test_passband_tone);
+    RUN_TEST(test_alias_rejection);
+    RUN_TEST(test_chunking_and_reset);
+    RUN_TEST(bench_resample);
+    return TEST_EXIT();
+}
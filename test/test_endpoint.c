@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "app_endpoint.h"
+#include "test_util.h"
+
+#define EP_RATE         (16000)
+#define EP_FRAME        (512)       /*!< AFE fetch chunk, 32 ms */
+#define EP_FRAME_MS     (32)
+
+static const app_endpoint_config_t ep_config = {
+    .sample_rate = EP_RATE,
+    .min_ms = 500,
+    .max_ms = 1600,
+    .length_percent = 20,
+    .low_snr_db = 15,
+    .no_speech_ms = 3200,
+};
+
+// 给定幅度的一帧, 幅度为 0 时不做电平跟踪
+static const int16_t *ep_frame(int amplitude)
+{
+    static int16_t pcm[EP_FRAME];
+    static int last = -1;
+    if (amplitude != last) {
+        for (int i = 0; i < EP_FRAME; i++) {
+            pcm[i] = (int16_t)lrintf(amplitude * sinf(2.0f * (float)M_PI * 200.0f * i / EP_RATE));
+        }
+        last = amplitude;
+    }
+    return pcm;
+}
+
+// 送入 ms 毫秒的同一种帧, 返回第一个非 CONTINUE 的结果, frames 为触发时已送入的帧数
+static app_endpoint_result_t ep_feed(app_endpoint_t *ep, bool speech, int amplitude, uint32_t ms, uint32_t *frames)
+{
+    for (uint32_t t = 0; t < ms; t += EP_FRAME_MS) {
+        app_endpoint_result_t result = app_endpoint_update(ep, speech, amplitude ? ep_frame(amplitude) : NULL, EP_FRAME);
+        if (result != APP_ENDPOINT_CONTINUE) {
+            if (frames) {
+                *frames = ep->frames;
+            }
+            return result;
+        }
+    }
+    return APP_ENDPOINT_CONTINUE;
+}
+
+// 说完 speech_ms 之后要多长的静音才判定结束
+static uint32_t ep_tail(app_endpoint_t *ep, int noise, int level, uint32_t speech_ms)
+{
+    app_endpoint_reset(ep);
+    CHECK(ep_feed(ep, false, noise, 320, NULL) == APP_ENDPOINT_CONTINUE);
+    CHECK(ep_feed(ep, true, level, speech_ms, NULL) == APP_ENDPOINT_CONTINUE);
+    uint32_t before = ep->frames;
+    uint32_t frames = 0;
+    CHECK(ep_feed(ep, false, noise, 10000, &frames) == APP_ENDPOINT_END_OF_SPEECH);
+    return (frames - before) * EP_FRAME_MS;
+}
+
+static uint32_t ep_round_up(uint32_t ms)
+{
+    return (ms + EP_FRAME_MS - 1) / EP_FRAME_MS * EP_FRAME_MS;
+}
+
+// 静音时长随说话时长增长, 并夹在 [min_ms, max_ms] 之间
+static void test_hangover_scales_and_bounds(void)
+{
+    app_endpoint_t ep;
+    app_endpoint_init(&ep, &ep_config);
+    const uint32_t speech[] = { 64, 320, 1600, 3200, 5504, 20000 };
+    uint32_t last = 0;
+    for (size_t i = 0; i < sizeof(speech) / sizeof(speech[0]); i++) {
+        uint32_t tail = ep_tail(&ep, 30, 8000, speech[i]);
+        uint32_t spoken = ep_round_up(speech[i]);
+        uint32_t expect = ep_config.min_ms + spoken * ep_config.length_percent / 100;
+        expect = expect < ep_config.max_ms ? expect : ep_config.max_ms;
+        printf("speech %5" PRIu32 " ms -> tail %4" PRIu32 " ms (hangover %" PRIu32 " ms)\n", spoken, tail, ep.hangover_ms);
+        CHECK_MSG(tail == ep_round_up(expect), "speech %" PRIu32 " ms: tail %" PRIu32 " ms, expect %" PRIu32, spoken, tail, expect);
+        CHECK(tail >= last);
+        last = tail;
+    }
+    CHECK(last == ep_config.max_ms);
+}
+
+// 语音接近噪声时静音时长加长一半, 仍不超过上限
+static void test_low_snr_is_longer(void)
+{
+    app_endpoint_t ep;
+    app_endpoint_init(&ep, &ep_config);
+    uint32_t clean = ep_tail(&ep, 30, 8000, 1600);
+    // 噪声电平随静音帧缓慢跟踪, 换一个新的判定器从高噪声开始
+    app_endpoint_init(&ep, &ep_config);
+    uint32_t noisy = ep_tail(&ep, 1000, 3000, 1600);
+    printf("speech 1600 ms: tail %" PRIu32 " ms clean, %" PRIu32 " ms at %.1f dB SNR\n", clean, noisy, ep.speech_db - ep.noise_db);
+    CHECK(ep.speech_db - ep.noise_db < ep_config.low_snr_db);
+    CHECK(noisy == ep_round_up((ep_config.min_ms + 1600 * ep_config.length_percent / 100) * 3 / 2));
+    CHECK(clean == ep_round_up(ep_config.min_ms + 1600 * ep_config.length_percent / 100));
+    CHECK(ep_tail(&ep, 1000, 3000, 3200) == ep_config.max_ms);
+}
+
+// 句中停顿短于所需静音时不结束, 停顿不计入说话时长
+static void test_pauses(void)
+{
+    app_endpoint_t ep;
+    app_endpoint_init(&ep, &ep_config);
+    CHECK(ep_feed(&ep, true, 8000, 960, NULL) == APP_ENDPOINT_CONTINUE);
+    CHECK(ep_feed(&ep, false, 30, 480, NULL) == APP_ENDPOINT_CONTINUE);
+    CHECK(ep_feed(&ep, true, 8000, 960, NULL) == APP_ENDPOINT_CONTINUE);
+    CHECK(ep.speech_ms == 1920 && ep.silence_ms == 0);
+    uint32_t frames = 0;
+    CHECK(ep_feed(&ep, false, 30, 5000, &frames) == APP_ENDPOINT_END_OF_SPEECH);
+    CHECK(ep.silence_ms == ep_round_up(ep_config.min_ms + 1920 * ep_config.length_percent / 100));
+}
+
+// 唤醒后一直不说话, 到 no_speech_ms 结束; 复位保留噪声电平
+static void test_no_speech_and_reset(void)
+{
+    app_endpoint_t ep;
+    app_endpoint_init(&ep, &ep_config);
+    uint32_t frames = 0;
+    CHECK(ep_feed(&ep, false, 500, 10000, &frames) == APP_ENDPOINT_NO_SPEECH);
+    CHECK(frames == ep_round_up(ep_config.no_speech_ms) / EP_FRAME_MS);
+    float noise = ep.noise_db;
+    CHECK(ep.noise_valid && noise > 40 && noise < 60);
+    app_endpoint_reset(&ep);
+    CHECK(ep.noise_valid && ep.noise_db == noise && ep.frames == 0 && ep.speech_ms == 0);
+    CHECK(ep.hangover_ms == ep_config.min_ms);
+    // 不给采样时只按 VAD 判断, 电平不变
+    CHECK(ep_feed(&ep, true, 0, 320, NULL) == APP_ENDPOINT_CONTINUE);
+    CHECK(ep.speech_frames == 0 && ep.noise_db == noise);
+    CHECK(ep_feed(&ep, false, 0, 5000, &frames) == APP_ENDPOINT_END_OF_SPEECH);
+}
+
+int main(void)
+{
+    RUN_TEST(test_hangover_scales_and_bounds);
+    RUN_TEST(test_low_snr_is_longer);
+    RUN_TEST(test_pauses);
+    RUN_TEST(test_no_speech_and_reset);
+    return TEST_EXIT();
+}
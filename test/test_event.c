@@ -0,0 +1,213 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "app_event.h"
+#include "test_util.h"
+
+#define EVENT_PRODUCERS         (4)
+#define EVENT_PER_PRODUCER      (200000)
+#define EVENT_TOTAL             (EVENT_PRODUCERS * EVENT_PER_PRODUCER)
+#define EVENT_SMALL_DEPTH       (64)
+#define EVENT_LARGE_DEPTH       (1 << 20)   /*!< Holds every event of a run, nothing may be dropped */
+#define EVENT_SEQ_BITS          (24)
+
+// 事件值: 高位是生产者编号, 低位是该生产者的序号
+#define EVENT_VALUE(producer, seq)  (((uint32_t)(producer) << EVENT_SEQ_BITS) | (seq))
+
+static atomic_int event_producers_ready;
+static atomic_bool event_start;
+
+// 单线程收发: 按发布顺序收到, 只收到订阅的类型, 队列满时丢弃最新的
+static void test_single_thread(void)
+{
+    CHECK(app_event_subscribe(APP_EVENT_BIT(APP_EVENT_WAKE), 6) == NULL);
+    app_event_sub_handle_t sub = app_event_subscribe(APP_EVENT_BIT(APP_EVENT_WIFI) | APP_EVENT_BIT(APP_EVENT_MANUAL_WAKE), 4);
+    CHECK(sub != NULL);
+
+    app_event_t event;
+    CHECK(!app_event_receive(sub, &event));
+    app_event_publish(APP_EVENT_WIFI, 1);
+    app_event_publish(APP_EVENT_WAKE, 2);
+    app_event_publish(APP_EVENT_MANUAL_WAKE, 3);
+    app_event_publish(APP_EVENT_MAX, 4);
+    CHECK(app_event_receive(sub, &event) && event.type == APP_EVENT_WIFI && event.value == 1);
+    int64_t first_us = event.time_us;
+    CHECK(app_event_receive(sub, &event) && event.type == APP_EVENT_MANUAL_WAKE && event.value == 3);
+    CHECK(event.time_us >= first_us);
+    CHECK(!app_event_receive(sub, &event));
+    CHECK(app_event_value(APP_EVENT_WAKE) == 2 && app_event_value(APP_EVENT_MAX) == 0);
+
+    for (uint32_t i = 0; i < 6; i++) {
+        app_event_publish(APP_EVENT_WIFI, 10 + i);
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(app_event_receive(sub, &event) && event.value == 10 + i);
+    }
+    CHECK(!app_event_receive(sub, &event));
+    CHECK(app_event_get_dropped(sub) == 2);
+}
+
+// 阶段延迟: 每个起点事件之后只统计第一次出现的终点事件
+static void test_latency_pairs(void)
+{
+    host_clock_set_virtual(true);
+    app_event_latency_t latency;
+    CHECK(app_event_get_latency(APP_EVENT_WAKE, APP_EVENT_REPLY_AUDIO_END, &latency) == ESP_ERR_NOT_FOUND);
+
+    app_event_publish(APP_EVENT_WAKE, 1);
+    vTaskDelay(pdMS_TO_TICKS(40));
+    app_event_publish(APP_EVENT_RECORD_START, 0);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    app_event_publish(APP_EVENT_RECORD_START, 0);
+    CHECK(app_event_get_latency(APP_EVENT_WAKE, APP_EVENT_RECORD_START, &latency) == ESP_OK);
+    CHECK(latency.count == 1 && latency.last_us == 40000 && latency.max_us == 40000 && latency.avg_us == 40000);
+
+    app_event_publish(APP_EVENT_WAKE, 1);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    app_event_publish(APP_EVENT_RECORD_START, 0);
+    CHECK(app_event_get_latency(APP_EVENT_WAKE, APP_EVENT_RECORD_START, &latency) == ESP_OK);
+    CHECK(latency.count == 2 && latency.last_us == 20000 && latency.max_us == 40000 && latency.avg_us == 30000);
+
+    // 一轮回复有多段语音, 只有第一段计入
+    app_event_publish(APP_EVENT_RECORD_STOP, 1000);
+    vTaskDelay(pdMS_TO_TICKS(300));
+    app_event_publish(APP_EVENT_UPLOADED, 1000);
+    vTaskDelay(pdMS_TO_TICKS(500));
+    app_event_publish(APP_EVENT_REPLY_TEXT, 20);
+    vTaskDelay(pdMS_TO_TICKS(200));
+    app_event_publish(APP_EVENT_REPLY_AUDIO_START, 0);
+    vTaskDelay(pdMS_TO_TICKS(900));
+    app_event_publish(APP_EVENT_REPLY_AUDIO_START, 0);
+    CHECK(app_event_get_latency(APP_EVENT_RECORD_STOP, APP_EVENT_UPLOADED, &latency) == ESP_OK && latency.last_us == 300000);
+    CHECK(app_event_get_latency(APP_EVENT_UPLOADED, APP_EVENT_REPLY_TEXT, &latency) == ESP_OK && latency.last_us == 500000);
+    CHECK(app_event_get_latency(APP_EVENT_RECORD_STOP, APP_EVENT_REPLY_TEXT, &latency) == ESP_OK && latency.last_us == 800000);
+    CHECK(app_event_get_latency(APP_EVENT_RECORD_STOP, APP_EVENT_REPLY_AUDIO_START, &latency) == ESP_OK);
+    CHECK(latency.count == 1 && latency.last_us == 1000000);
+    host_clock_set_virtual(false);
+}
+
+// 生产者: 各自按序号发布, 两个类型交替, 订阅者同时订阅两者
+static void event_producer_task(void *arg)
+{
+    uint32_t producer = (uint32_t)(uintptr_t)arg;
+    atomic_fetch_add(&event_producers_ready, 1);
+    while (!atomic_load(&event_start)) {
+        taskYIELD();
+    }
+    for (uint32_t seq = 0; seq < EVENT_PER_PRODUCER; seq++) {
+        app_event_type_t type = (seq & 1) ? APP_EVENT_REPLY_AUDIO_END : APP_EVENT_MANUAL_WAKE;
+        app_event_publish(type, EVENT_VALUE(producer, seq));
+    }
+    vTaskDelete(NULL);
+}
+
+// 多个生产者同时发布, 唯一的订阅者边收边检查: 每个生产者的事件按序到达, 不重复, 收到加丢弃等于发布总数
+static void event_run_producers(size_t depth, uint32_t *received, uint32_t *dropped)
+{
+    app_event_sub_handle_t sub = app_event_subscribe(APP_EVENT_BIT(APP_EVENT_MANUAL_WAKE) |
+                                                     APP_EVENT_BIT(APP_EVENT_REPLY_AUDIO_END), depth);
+    CHECK(sub != NULL);
+    if (sub == NULL) {
+        return;
+    }
+    atomic_store(&event_producers_ready, 0);
+    atomic_store(&event_start, false);
+    TaskHandle_t producers[EVENT_PRODUCERS];
+    for (uint32_t i = 0; i < EVENT_PRODUCERS; i++) {
+        CHECK(xTaskCreatePinnedToCore(event_producer_task, "producer", 4096, (void *)(uintptr_t)i, 5, &producers[i], 0) == pdPASS);
+    }
+    while (atomic_load(&event_producers_ready) < EVENT_PRODUCERS) {
+        taskYIELD();
+    }
+    atomic_store(&event_start, true);
+
+    int64_t last_seq[EVENT_PRODUCERS];
+    int64_t last_time_us[EVENT_PRODUCERS] = {0};
+    for (int i = 0; i < EVENT_PRODUCERS; i++) {
+        last_seq[i] = -1;
+    }
+    uint32_t count = 0, bad = 0, out_of_order = 0, wrong_type = 0, time_back = 0;
+    app_event_t event;
+    while (count + app_event_get_dropped(sub) < EVENT_TOTAL) {
+        if (!app_event_receive(sub, &event)) {
+            taskYIELD();
+            continue;
+        }
+        uint32_t producer = event.value >> EVENT_SEQ_BITS;
+        uint32_t seq = event.value & ((1 << EVENT_SEQ_BITS) - 1);
+        if (producer >= EVENT_PRODUCERS || seq >= EVENT_PER_PRODUCER) {
+            bad++;
+            continue;
+        }
+        out_of_order += (int64_t)seq <= last_seq[producer];
+        last_seq[producer] = seq;
+        wrong_type += event.type != ((seq & 1) ? APP_EVENT_REPLY_AUDIO_END : APP_EVENT_MANUAL_WAKE);
+        // 同一生产者的时间戳不会倒退, 不同生产者之间可以交错
+        time_back += event.time_us < last_time_us[producer];
+        last_time_us[producer] = event.time_us;
+        count++;
+    }
+    for (int i = 0; i < EVENT_PRODUCERS; i++) {
+        host_task_join(producers[i]);
+    }
+    CHECK(!app_event_receive(sub, &event));
+    CHECK(bad == 0);
+    CHECK(out_of_order == 0);
+    CHECK(wrong_type == 0);
+    CHECK(time_back == 0);
+    *received = count;
+    *dropped = app_event_get_dropped(sub);
+    CHECK(*received + *dropped == EVENT_TOTAL);
+}
+
+static void test_producers_lossless(void)
+{
+    uint32_t received = 0, dropped = 0;
+    double start = test_now_us();
+    event_run_producers(EVENT_LARGE_DEPTH, &received, &dropped);
+    double elapsed = test_now_us() - start;
+    printf("%d producers, depth %d: %u received, %u dropped, %.0f ns per event\n",
+           EVENT_PRODUCERS, EVENT_LARGE_DEPTH, received, dropped, elapsed * 1000 / EVENT_TOTAL);
+    CHECK(received == EVENT_TOTAL && dropped == 0);
+}
+
+// 队列很小时会丢弃, 但收到的事件仍按各生产者的顺序, 且丢弃都被计数
+static void test_producers_overflow(void)
+{
+    uint32_t received = 0, dropped = 0;
+    event_run_producers(EVENT_SMALL_DEPTH, &received, &dropped);
+    printf("%d producers, depth %d: %u received, %u dropped\n", EVENT_PRODUCERS, EVENT_SMALL_DEPTH, received, dropped);
+    CHECK(received > 0);
+}
+
+// 分配失败不占用订阅位置, 位置用完后订阅失败
+static void test_subscriber_slots(void)
+{
+    CHECK(app_event_subscribe(APP_EVENT_BIT(APP_EVENT_WIFI), (size_t)1 << 62) == NULL);
+    int added = 0;
+    while (app_event_subscribe(APP_EVENT_BIT(APP_EVENT_WIFI), 2) != NULL) {
+        added++;
+    }
+    // 前面的测试已订阅了 3 个
+    CHECK_MSG(added == 5, "added %d", added);
+    CHECK(app_event_subscribe(APP_EVENT_BIT(APP_EVENT_WIFI), 2) == NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_single_thread);
+    RUN_TEST(test_latency_pairs);
+    RUN_TEST(test_producers_lossless);
+    RUN_TEST(test_producers_overflow);
+    RUN_TEST(test_subscriber_slots);
+    return TEST_EXIT();
+}
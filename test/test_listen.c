@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "app_listen.h"
+#include "test_util.h"
+
+#define LISTEN_FRAME        (512)       /*!< AFE fetch chunk, 32 ms */
+#define LISTEN_FRAME_MS     (32)
+
+static const app_endpoint_config_t listen_config = {
+    .sample_rate = 16000,
+    .min_ms = 500,
+    .max_ms = 1600,
+    .length_percent = 20,
+    .low_snr_db = 15,
+    .no_speech_ms = 3200,
+};
+
+// 送入 ms 毫秒只有 VAD 结果的帧, MultiNet 一直在识别; 返回第一个非 CONTINUE 的结果
+static app_listen_result_t listen_feed(app_listen_t *ls, bool speech, uint32_t ms)
+{
+    for (uint32_t t = 0; t < ms; t += LISTEN_FRAME_MS) {
+        app_listen_result_t result = app_listen_update(ls, APP_LISTEN_MN_NONE, speech, NULL, LISTEN_FRAME);
+        if (result != APP_LISTEN_CONTINUE) {
+            return result;
+        }
+    }
+    return APP_LISTEN_CONTINUE;
+}
+
+// 没有命令窗口时按静音时长结束
+static void test_end_without_window(void)
+{
+    app_listen_t ls;
+    app_listen_init(&ls, &listen_config);
+    CHECK(app_listen_update(&ls, APP_LISTEN_MN_DETECTED, true, NULL, LISTEN_FRAME) == APP_LISTEN_CONTINUE);
+    app_listen_start(&ls, false);
+    CHECK(listen_feed(&ls, true, 640) == APP_LISTEN_CONTINUE);
+    CHECK(listen_feed(&ls, false, 2000) == APP_LISTEN_END_OF_SPEECH);
+    CHECK(!ls.active && !ls.end_deferred);
+    CHECK(ls.endpoint.silence_ms >= ls.endpoint.hangover_ms &&
+          ls.endpoint.silence_ms < ls.endpoint.hangover_ms + LISTEN_FRAME_MS);
+}
+
+// 命令说完后静音已够长, 仍等 MultiNet 给出结果, 识别到的命令不上传
+static void test_command_after_end_of_speech(void)
+{
+    app_listen_t ls;
+    app_listen_init(&ls, &listen_config);
+    app_listen_start(&ls, true);
+    CHECK(listen_feed(&ls, true, 640) == APP_LISTEN_CONTINUE);
+    CHECK(listen_feed(&ls, false, 1280) == APP_LISTEN_CONTINUE);
+    CHECK(ls.active && ls.end_deferred);
+    CHECK(ls.endpoint.silence_ms > ls.endpoint.hangover_ms);
+    CHECK(app_listen_update(&ls, APP_LISTEN_MN_DETECTED, false, NULL, LISTEN_FRAME) == APP_LISTEN_COMMAND);
+    CHECK(!ls.active && !ls.command_window);
+}
+
+// 窗口超时时已经说完, 在超时的这一帧结束并上传
+static void test_timeout_releases_end_of_speech(void)
+{
+    app_listen_t ls;
+    app_listen_init(&ls, &listen_config);
+    app_listen_start(&ls, true);
+    CHECK(listen_feed(&ls, true, 640) == APP_LISTEN_CONTINUE);
+    CHECK(listen_feed(&ls, false, 1280) == APP_LISTEN_CONTINUE);
+    CHECK(app_listen_update(&ls, APP_LISTEN_MN_TIMEOUT, false, NULL, LISTEN_FRAME) == APP_LISTEN_END_OF_SPEECH);
+    CHECK(!ls.active && ls.end_deferred);
+}
+
+// 等待期间继续说话, 超时之后重新按静音时长判定
+static void test_speech_resumes_in_window(void)
+{
+    app_listen_t ls;
+    app_listen_init(&ls, &listen_config);
+    app_listen_start(&ls, true);
+    CHECK(listen_feed(&ls, true, 640) == APP_LISTEN_CONTINUE);
+    CHECK(listen_feed(&ls, false, 1280) == APP_LISTEN_CONTINUE);
+    CHECK(listen_feed(&ls, true, 960) == APP_LISTEN_CONTINUE);
+    CHECK(app_listen_update(&ls, APP_LISTEN_MN_TIMEOUT, true, NULL, LISTEN_FRAME) == APP_LISTEN_CONTINUE);
+    CHECK(ls.active && !ls.command_window);
+    CHECK(listen_feed(&ls, false, 320) == APP_LISTEN_CONTINUE);
+    CHECK(listen_feed(&ls, false, 2000) == APP_LISTEN_END_OF_SPEECH);
+    CHECK(ls.endpoint.silence_ms >= ls.endpoint.hangover_ms &&
+          ls.endpoint.silence_ms < ls.endpoint.hangover_ms + LISTEN_FRAME_MS);
+
+    // 下一次唤醒清除等待状态
+    app_listen_start(&ls, true);
+    CHECK(ls.active && ls.command_window && !ls.end_deferred);
+}
+
+// 唤醒后不说话, 不等命令窗口
+static void test_no_speech_in_window(void)
+{
+    app_listen_t ls;
+    app_listen_init(&ls, &listen_config);
+    app_listen_start(&ls, true);
+    CHECK(listen_feed(&ls, false, 5000) == APP_LISTEN_NO_SPEECH);
+    CHECK(ls.endpoint.elapsed_ms == listen_config.no_speech_ms);
+}
+
+int main(void)
+{
+    RUN_TEST(test_end_without_window);
+    RUN_TEST(test_command_after_end_of_speech);
+    RUN_TEST(test_timeout_releases_end_of_speech);
+    RUN_TEST(test_speech_resumes_in_window);
+    RUN_TEST(test_no_speech_in_window);
+    return TEST_EXIT();
+}
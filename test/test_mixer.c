@@ -0,0 +1,236 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "app_audio.h"
+#include "app_mixer.h"
+#include "test_util.h"
+
+#define PERIOD_FRAMES       (256)       /*!< MIXER_PERIOD_FRAMES */
+#define PERIOD_SIZE         (PERIOD_FRAMES * 2 * sizeof(int16_t))
+#define CAPTURE_PERIODS     (64)
+#define DUCK_GAIN           (32768 * CONFIG_MIXER_DUCK_PERCENT / 100)
+#define RING_PERIODS        (CONFIG_MIXER_RING_SIZE / PERIOD_SIZE)
+
+// I2S 由测试驱动: 每放行一次, 混音任务写出一个周期
+static SemaphoreHandle_t i2s_clock;
+static SemaphoreHandle_t i2s_done;
+static int16_t i2s_out[CAPTURE_PERIODS][PERIOD_FRAMES * 2];
+static size_t i2s_periods;
+static int codec_prepares;
+
+esp_err_t audio_playback_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    xSemaphoreTake(i2s_clock, portMAX_DELAY);
+    CHECK(len == PERIOD_SIZE);
+    memcpy(i2s_out[i2s_periods % CAPTURE_PERIODS], audio_buffer, len);
+    i2s_periods++;
+    *bytes_written = len;
+    xSemaphoreGive(i2s_done);
+    return ESP_OK;
+}
+
+esp_err_t audio_codec_prepare(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    CHECK(rate == AUDIO_CODEC_SAMPLE_RATE && bits_cfg == 16 && ch == I2S_SLOT_MODE_STEREO);
+    codec_prepares++;
+    return ESP_OK;
+}
+
+// 放行最多 n 个周期, 返回实际写出的周期数; 混音任务空闲时不会写出
+static size_t i2s_step(size_t n)
+{
+    size_t done = 0;
+    while (done < n) {
+        xSemaphoreGive(i2s_clock);
+        if (xSemaphoreTake(i2s_done, pdMS_TO_TICKS(100)) != pdTRUE) {
+            xSemaphoreTake(i2s_clock, 0);
+            break;
+        }
+        done++;
+    }
+    return done;
+}
+
+static const int16_t *i2s_period(size_t index)
+{
+    return i2s_out[index % CAPTURE_PERIODS];
+}
+
+// 让音源播完, 混音任务回到空闲
+static void mixer_drain(void)
+{
+    app_mixer_close(APP_MIXER_SOURCE_TTS);
+    while (i2s_step(1)) {
+    }
+}
+
+static void fill(int16_t *pcm, size_t frames, int16_t left, int16_t right)
+{
+    for (size_t i = 0; i < frames; i++) {
+        pcm[i * 2 + 0] = left;
+        pcm[i * 2 + 1] = right;
+    }
+}
+
+// 单个音源以单位增益原样输出, 播完后混音任务休眠
+static void test_stream_passthrough(void)
+{
+    const size_t frames = PERIOD_FRAMES * 5;
+    int16_t *pcm = malloc(frames * 2 * sizeof(int16_t));
+    for (size_t i = 0; i < frames * 2; i++) {
+        pcm[i] = (int16_t)(i * 37);
+    }
+    int prepares = codec_prepares;
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, pcm, frames * 2 * sizeof(int16_t), 0) == frames * 2 * sizeof(int16_t));
+    app_mixer_close(APP_MIXER_SOURCE_TTS);
+    size_t first = i2s_periods;
+    CHECK(i2s_step(10) == 5);
+    CHECK(codec_prepares == prepares + 1);
+    for (size_t p = 0; p < 5; p++) {
+        CHECK_MSG(memcmp(i2s_period(first + p), pcm + p * PERIOD_FRAMES * 2, PERIOD_SIZE) == 0, "period %zu", p);
+    }
+    free(pcm);
+}
+
+// 提示音播放时压低回复, 增益在一个周期内渐变; 提示音结束后回复恢复原来的电平
+static void test_ducking(void)
+{
+    static int16_t tts[PERIOD_FRAMES * 2 * 8];
+    static int16_t prompt[PERIOD_FRAMES * 2 * 2];
+    fill(tts, PERIOD_FRAMES * 8, 10000, -10000);
+    fill(prompt, PERIOD_FRAMES * 2, 4000, 4000);
+
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, tts, sizeof(tts), 0) == sizeof(tts));
+    size_t first = i2s_periods;
+    CHECK(i2s_step(1) == 1);
+    // 混音任务已经算好下一个周期, 提示音从再下一个周期开始
+    CHECK(app_mixer_play_buffer(APP_MIXER_SOURCE_PROMPT, prompt, sizeof(prompt)) == ESP_OK);
+    CHECK(i2s_step(6) == 6);
+
+    const int16_t *p0 = i2s_period(first);
+    CHECK(p0[0] == 10000 && p0[1] == -10000);
+    size_t start = first + 1;
+    while (start < first + 3 && i2s_period(start)[0] == 10000) {
+        start++;
+    }
+    const int16_t *ramp_down = i2s_period(start);
+    const int16_t *ducked = i2s_period(start + 1);
+    const int16_t *ramp_up = i2s_period(start + 2);
+    const int16_t *restored = i2s_period(start + 3);
+    int16_t duck_l = 4000 + (10000 * DUCK_GAIN >> 15);
+    int16_t duck_r = 4000 + (-10000 * DUCK_GAIN >> 15);
+    CHECK(ramp_down[0] == 14000);
+    CHECK(ramp_down[PERIOD_FRAMES * 2 - 2] > duck_l && ramp_down[PERIOD_FRAMES * 2 - 2] < duck_l + 100);
+    for (int i = 1; i < PERIOD_FRAMES; i++) {
+        CHECK(ramp_down[i * 2] <= ramp_down[(i - 1) * 2]);
+    }
+    CHECK_MSG(ducked[0] == duck_l && ducked[1] == duck_r && ducked[PERIOD_FRAMES * 2 - 2] == duck_l,
+              "ducked %d %d, expect %d %d", ducked[0], ducked[1], duck_l, duck_r);
+    // 提示音播完, 回复从压低的电平渐变回来
+    CHECK(abs(ramp_up[0] - (10000 * DUCK_GAIN >> 15)) <= 1);
+    CHECK(ramp_up[PERIOD_FRAMES * 2 - 2] > 9900);
+    CHECK(restored[0] == 10000 && restored[1] == -10000);
+    mixer_drain();
+}
+
+// 写端还在播放但数据不够时补零并计数; 关闭后不足一个周期的结尾不算断流
+static void test_underrun(void)
+{
+    static int16_t pcm[PERIOD_FRAMES * 2 * 3 / 2];
+    fill(pcm, PERIOD_FRAMES * 3 / 2, 1000, 1000);
+    app_mixer_stats_t before, after;
+    app_mixer_get_stats(&before);
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, pcm, sizeof(pcm), 0) == sizeof(pcm));
+    size_t first = i2s_periods;
+    CHECK(i2s_step(3) == 3);
+    app_mixer_get_stats(&after);
+    // 混音任务可能已经算好了下一个周期, 多计一次
+    CHECK(after.underruns >= before.underruns + 2 && after.underruns <= before.underruns + 3);
+    const int16_t *half = i2s_period(first + 1);
+    CHECK(half[0] == 1000 && half[PERIOD_FRAMES - 2] == 1000 && half[PERIOD_FRAMES] == 0);
+    CHECK(i2s_period(first + 2)[0] == 0);
+
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, pcm, sizeof(pcm), 0) == sizeof(pcm));
+    app_mixer_close(APP_MIXER_SOURCE_TTS);
+    app_mixer_get_stats(&before);
+    mixer_drain();
+    app_mixer_get_stats(&after);
+    CHECK(after.underruns == before.underruns);
+    CHECK(after.periods > before.periods && after.start_latency_max_us >= after.start_latency_us);
+}
+
+// 写满时不等待的写入立即返回已放入的部分; 清空后写端和输出都立即恢复
+static void test_full_and_flush(void)
+{
+    static int16_t pcm[PERIOD_FRAMES * 2 * (RING_PERIODS + 4)];
+    fill(pcm, PERIOD_FRAMES * (RING_PERIODS + 4), 3000, 3000);
+    double start = test_now_us();
+    size_t queued = app_mixer_write(APP_MIXER_SOURCE_TTS, pcm, sizeof(pcm), 0);
+    CHECK(test_now_us() - start < 20000);
+    // 混音任务取走一个周期后停在 I2S 写入上, 再补满
+    vTaskDelay(pdMS_TO_TICKS(20));
+    queued += app_mixer_write(APP_MIXER_SOURCE_TTS, (uint8_t *)pcm + queued, sizeof(pcm) - queued, 0);
+    CHECK(queued == CONFIG_MIXER_RING_SIZE + PERIOD_SIZE);
+    // 带超时的写入在超时后返回
+    start = test_now_us();
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, pcm, PERIOD_SIZE, pdMS_TO_TICKS(50)) == 0);
+    CHECK(test_now_us() - start >= 40000);
+
+    app_mixer_stats_t stats;
+    app_mixer_get_stats(&stats);
+    CHECK(stats.queue_max_ms >= (CONFIG_MIXER_RING_SIZE - PERIOD_SIZE) * 1000 / (AUDIO_CODEC_SAMPLE_RATE * 4));
+
+    CHECK(i2s_step(1) == 1);
+    app_mixer_flush(APP_MIXER_SOURCE_TTS);
+    size_t first = i2s_periods;
+    CHECK(i2s_step(2) == 2);
+    // 清空之前可能已算好一个周期, 最多再输出这一个周期, 之后是静音
+    CHECK(i2s_period(first)[0] == 3000 || i2s_period(first)[0] == 0);
+    CHECK(i2s_period(first + 1)[0] == 0);
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, pcm, CONFIG_MIXER_RING_SIZE, 0) == CONFIG_MIXER_RING_SIZE);
+    app_mixer_flush(APP_MIXER_SOURCE_TTS);
+    mixer_drain();
+}
+
+// 新提交的缓冲区替换正在播放的
+static void test_play_buffer_replaces(void)
+{
+    static int16_t a[PERIOD_FRAMES * 2 * 4];
+    static int16_t b[PERIOD_FRAMES * 2];
+    fill(a, PERIOD_FRAMES * 4, 111, 111);
+    fill(b, PERIOD_FRAMES, 222, 222);
+    CHECK(app_mixer_play_buffer(APP_MIXER_SOURCE_PROMPT, a, sizeof(a)) == ESP_OK);
+    size_t first = i2s_periods;
+    CHECK(i2s_step(1) == 1);
+    CHECK(app_mixer_play_buffer(APP_MIXER_SOURCE_PROMPT, b, sizeof(b)) == ESP_OK);
+    // 混音任务可能已算好 a 的下一个周期, 之后立即换成 b
+    size_t n = i2s_step(8);
+    CHECK(n == 1 || n == 2);
+    CHECK(i2s_period(first)[0] == 111 && i2s_period(first + n)[0] == 222);
+    if (n == 2) {
+        CHECK(i2s_period(first + 1)[0] == 111);
+    }
+}
+
+int main(void)
+{
+    i2s_clock = xSemaphoreCreateCounting(1, 0);
+    i2s_done = xSemaphoreCreateCounting(1, 0);
+    CHECK(app_mixer_play_buffer(APP_MIXER_SOURCE_PROMPT, NULL, 0) == ESP_ERR_INVALID_STATE);
+    CHECK(app_mixer_write(APP_MIXER_SOURCE_TTS, i2s_out, PERIOD_SIZE, 0) == 0);
+    CHECK(app_mixer_init() == ESP_OK);
+    RUN_TEST(test_stream_passthrough);
+    RUN_TEST(test_ducking);
+    RUN_TEST(test_underrun);
+    RUN_TEST(test_full_and_flush);
+    RUN_TEST(test_play_buffer_replaces);
+    return TEST_EXIT();
+}
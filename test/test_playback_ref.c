@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "app_playback_ref.h"
+#include "test_util.h"
+
+#define REF_RATE            (16000)
+#define REF_CHUNK           (512)       /*!< AFE feed chunk */
+#define REF_BLOCK           (256)       /*!< Mixer period */
+#define REF_DMA_FRAMES      (6 * 240)   /*!< I2S TX DMA queue */
+#define REF_DELAY_FRAMES    (REF_RATE * CONFIG_SR_AEC_REF_DELAY_MS / 1000)
+#define REF_RING_SIZE       (16384)
+#define REF_ROOM_DELAY      (40)        /*!< Speaker to microphone, 2.5 ms */
+#define REF_SEGMENT         (REF_RATE * 3 / 2)
+#define REF_GAP             (REF_RATE)
+#define REF_TOTAL           (REF_RATE * 5)
+
+// 仿真的时间线, 以采样为单位
+typedef struct {
+    int16_t spk[REF_TOTAL];     /*!< What the speaker plays */
+    int16_t mic[REF_TOTAL];     /*!< Echo picked up by the microphone */
+    int16_t ref[REF_TOTAL];     /*!< Reference handed to AFE with the microphone chunk */
+    size_t real[REF_TOTAL / REF_CHUNK];
+} ref_timeline_t;
+
+static ref_timeline_t timeline;
+
+// 两段播放, 中间停顿, 第一段从 start 开始; 播放内容是伪随机信号, 相关峰唯一
+static void ref_simulate(size_t start)
+{
+    const size_t seg_start[2] = { start, start + REF_SEGMENT + REF_GAP };
+    int16_t queue[REF_DMA_FRAMES];
+    size_t queue_head = 0, queue_fill = 0;
+    size_t written[2] = { 0, 0 };
+    uint32_t rnd = 1 + start;
+    memset(&timeline, 0, sizeof(timeline));
+    app_playback_ref_handle_t ref = app_playback_ref_create(REF_RING_SIZE, REF_DELAY_FRAMES);
+    CHECK(ref != NULL);
+
+    for (size_t n = 0; n < REF_TOTAL; n++) {
+        // 混音任务: DMA 队列有空位时写一个周期, 写入返回后放入参考
+        for (int s = 0; s < 2; s++) {
+            while (n >= seg_start[s] && written[s] < REF_SEGMENT && queue_fill + REF_BLOCK <= REF_DMA_FRAMES) {
+                int16_t block[REF_BLOCK * 2];
+                for (int i = 0; i < REF_BLOCK; i++) {
+                    rnd = rnd * 1103515245 + 12345;
+                    int16_t v = (int16_t)((rnd >> 16) & 0x3fff) - 0x2000;
+                    block[i * 2 + 0] = block[i * 2 + 1] = v;
+                    queue[(queue_head + queue_fill + i) % REF_DMA_FRAMES] = v;
+                }
+                queue_fill += REF_BLOCK;
+                written[s] += REF_BLOCK;
+                CHECK(app_playback_ref_write(ref, block, REF_BLOCK));
+            }
+        }
+
+        // 扬声器: DMA 队列空时输出静音
+        if (queue_fill) {
+            timeline.spk[n] = queue[queue_head];
+            queue_head = (queue_head + 1) % REF_DMA_FRAMES;
+            queue_fill--;
+        }
+        timeline.mic[n] = (n >= REF_ROOM_DELAY) ? timeline.spk[n - REF_ROOM_DELAY] / 2 : 0;
+
+        // 采集任务: 每收到一块麦克风数据取一块参考
+        if ((n + 1) % REF_CHUNK == 0) {
+            size_t chunk = n / REF_CHUNK;
+            timeline.real[chunk] = app_playback_ref_read(ref, &timeline.ref[n + 1 - REF_CHUNK], REF_CHUNK);
+        }
+    }
+    app_playback_ref_delete(ref);
+}
+
+// 参考相对于扬声器的超前量: 返回 lead 使 ref[t] == spk[t + lead] 在整段上成立, 找不到时返回 INT32_MIN
+static int32_t ref_find_lead(size_t from, size_t to)
+{
+    for (int32_t lead = -2 * REF_CHUNK; lead <= 2 * REF_CHUNK; lead++) {
+        size_t match = 0, count = 0;
+        for (size_t t = from; t < to; t++) {
+            if (timeline.ref[t] == 0 || (int64_t)t + lead < 0 || t + lead >= REF_TOTAL) {
+                continue;
+            }
+            count++;
+            match += timeline.ref[t] == timeline.spk[t + lead];
+        }
+        if (count > REF_CHUNK && match == count) {
+            return lead;
+        }
+    }
+    return INT32_MIN;
+}
+
+// 参考总是与回声对齐且不落后于回声: AEC 只能消除参考之后出现的回声
+static void test_echo_alignment(void)
+{
+    for (size_t start = 0; start < REF_CHUNK; start += 37) {
+        ref_simulate(start);
+        const size_t seg_start[2] = { start, start + REF_SEGMENT + REF_GAP };
+        for (int s = 0; s < 2; s++) {
+            int32_t lead = ref_find_lead(seg_start[s], seg_start[s] + REF_SEGMENT + REF_DMA_FRAMES);
+            // 回声比参考晚 lead + REF_ROOM_DELAY, 误差不超过一个混音周期
+            CHECK_MSG(lead >= 0 && lead <= REF_BLOCK, "start %zu, segment %d: reference leads the speaker by %d frames",
+                      start, s, lead);
+            // 回声全部落在参考的时间线之后, 按对齐后的位置相减为零
+            size_t residual = 0;
+            for (size_t t = seg_start[s]; t + lead + REF_ROOM_DELAY < REF_TOTAL && t < seg_start[s] + REF_SEGMENT; t++) {
+                if (timeline.ref[t]) {
+                    residual += timeline.mic[t + lead + REF_ROOM_DELAY] != timeline.ref[t] / 2;
+                }
+            }
+            CHECK_MSG(residual == 0, "start %zu, segment %d: %zu echo samples not matched", start, s, residual);
+        }
+    }
+}
+
+// 播放停止后参考为零, 下一段重新对齐; 返回值只计入真实的参考
+static void test_idle_and_counts(void)
+{
+    ref_simulate(100);
+    size_t real = 0, nonzero = 0;
+    for (size_t c = 0; c < REF_TOTAL / REF_CHUNK; c++) {
+        real += timeline.real[c];
+        CHECK(timeline.real[c] <= REF_CHUNK);
+    }
+    for (size_t t = 0; t < REF_TOTAL; t++) {
+        nonzero += timeline.ref[t] != 0;
+    }
+    // 伪随机信号中为零的采样很少, 两段播放都在结束前完整读出
+    CHECK(real >= nonzero && real <= 2 * REF_SEGMENT);
+    CHECK(real + REF_CHUNK + REF_DMA_FRAMES >= 2 * REF_SEGMENT);
+    // 两段之间的停顿里没有参考
+    size_t gap_from = 100 + REF_SEGMENT + REF_DMA_FRAMES + REF_CHUNK;
+    for (size_t t = gap_from; t < 100 + REF_SEGMENT + REF_GAP; t++) {
+        CHECK_MSG(timeline.ref[t] == 0, "t %zu", t);
+        if (timeline.ref[t]) {
+            break;
+        }
+    }
+}
+
+// 读端停住时写端丢弃整块, 不阻塞播放
+static void test_overrun(void)
+{
+    app_playback_ref_handle_t ref = app_playback_ref_create(4096, 1024);
+    int16_t block[REF_BLOCK * 2] = {0};
+    int accepted = 0;
+    for (int i = 0; i < 16; i++) {
+        accepted += app_playback_ref_write(ref, block, REF_BLOCK);
+    }
+    CHECK(accepted == 4096 / (REF_BLOCK * 2));
+    int16_t out[REF_CHUNK];
+    CHECK(app_playback_ref_read(ref, out, REF_CHUNK) == REF_CHUNK);
+    app_playback_ref_delete(ref);
+    CHECK(app_playback_ref_create(4096, 2048) == NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_echo_alignment);
+    RUN_TEST(test_idle_and_counts);
+    RUN_TEST(test_overrun);
+    return TEST_EXIT();
+}
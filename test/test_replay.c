@@ -0,0 +1,382 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+// 回放测试: 录音经 app_replay, app_dsp 和 AFE 替身送入与检测任务相同的判定 (app_listen),
+// 录音用 app_multipart 上传到不联网的 HTTP 客户端, 回复按时间逐段送入 app_sse,
+// 唤醒即开始新的一轮 (app_turn), 检查每一轮的结果和打断
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "app_audio.h"
+#include "app_dsp.h"
+#include "app_listen.h"
+#include "app_multipart.h"
+#include "app_replay.h"
+#include "app_sse.h"
+#include "app_turn.h"
+#include "sr_stub.h"
+#include "test_util.h"
+
+#define REPLAY_TURN_MAX         (SR_STUB_LABEL_MAX)
+#define REPLAY_TAIL_MS          (5000)      /*!< Silence replayed after the file so the last turn can end */
+#define REPLAY_SSE_BYTES        (16)        /*!< Reply bytes arriving per 32 ms frame */
+#define REPLAY_SSE_MAX_EVENT    (1024)
+#define REPLAY_RECORD_MAX       (16000 * 30)
+#define REPLAY_FRAME_MS         (32)        /*!< One SR_STUB_CHUNK */
+#define REPLAY_FIXED_TAIL_MS    (100 * REPLAY_FRAME_MS)  /*!< The 100 silent frames the detect task used to wait for */
+
+typedef struct {
+    bool used;
+    app_listen_result_t expect;
+    int expect_command;
+    bool expect_cancelled;
+} replay_expect_t;
+
+typedef struct {
+    app_turn_id_t turn;
+    uint32_t wake_ms;
+    uint32_t end_ms;
+    app_listen_result_t result;
+    int command;
+    uint32_t tail_ms;           /*!< Silence heard before the end of speech was declared */
+    uint32_t recorded;
+    uint32_t uploaded;
+    uint32_t events;            /*!< SSE events handled */
+    uint32_t events_late;       /*!< SSE events handled after the turn was cancelled */
+    bool reply_done;
+    bool cancelled;
+} replay_turn_t;
+
+static const app_endpoint_config_t replay_endpoint_config = {
+    .sample_rate = AUDIO_CODEC_SAMPLE_RATE,
+    .min_ms = CONFIG_SR_ENDPOINT_MIN_MS,
+    .max_ms = CONFIG_SR_ENDPOINT_MAX_MS,
+    .length_percent = CONFIG_SR_ENDPOINT_LENGTH_PERCENT,
+    .low_snr_db = CONFIG_SR_ENDPOINT_LOW_SNR_DB,
+    .no_speech_ms = CONFIG_SR_ENDPOINT_NO_SPEECH_MS,
+};
+
+static sr_stub_labels_t replay_labels;
+static replay_expect_t replay_expects[REPLAY_TURN_MAX + 1];
+static replay_turn_t replay_turns[REPLAY_TURN_MAX + 1];
+static size_t replay_turn_count = 0;
+static replay_turn_t *replay_reply_turn = NULL;     /*!< Turn whose reply is streaming */
+static uint32_t replay_reply_events = 0;            /*!< Events in the full reply */
+
+static const char *replay_result_name(app_listen_result_t result)
+{
+    switch (result) {
+    case APP_LISTEN_COMMAND: return "command";
+    case APP_LISTEN_END_OF_SPEECH: return "end_of_speech";
+    case APP_LISTEN_NO_SPEECH: return "no_speech";
+    default: return "none";
+    }
+}
+
+static int replay_load_labels(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned ms, turn;
+        int id;
+        char what[32], extra[32] = "";
+        if (sscanf(line, "wake %u", &ms) == 1 && replay_labels.wake_count < SR_STUB_LABEL_MAX) {
+            replay_labels.wake_ms[replay_labels.wake_count++] = ms;
+        } else if (sscanf(line, "command %u %d", &ms, &id) == 2 && replay_labels.command_count < SR_STUB_LABEL_MAX) {
+            replay_labels.command_ms[replay_labels.command_count] = ms;
+            replay_labels.command_id[replay_labels.command_count++] = id;
+        } else if (sscanf(line, "expect %u %31s %31s", &turn, what, extra) >= 2 && turn && turn <= REPLAY_TURN_MAX) {
+            replay_expect_t *expect = &replay_expects[turn];
+            expect->used = true;
+            expect->expect = strcmp(what, "command") == 0 ? APP_LISTEN_COMMAND
+                             : strcmp(what, "no_speech") == 0 ? APP_LISTEN_NO_SPEECH : APP_LISTEN_END_OF_SPEECH;
+            expect->expect_command = (expect->expect == APP_LISTEN_COMMAND) ? atoi(extra) : -1;
+            expect->expect_cancelled = strcmp(extra, "cancelled") == 0;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static char *replay_load_file(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *buf = malloc(*len + 1);
+    if (buf && fread(buf, 1, *len, fp) != *len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+// 与 chat_sse_event_cb 相同: 已被打断的一轮不再处理剩余事件
+static void replay_sse_event_cb(const char *data, size_t len, void *user_ctx)
+{
+    replay_turn_t *turn = *(replay_turn_t **)user_ctx;
+    if (turn == NULL) {
+        replay_reply_events++;
+        return;
+    }
+    if (app_turn_cancelled(turn->turn)) {
+        return;
+    }
+    // 每次回调正好一个 JSON 对象
+    const char *second = strstr(data, "\"content\"");
+    second = second ? strstr(second + 1, "\"content\"") : NULL;
+    CHECK_MSG(len && data[0] == '{' && data[len - 1] == '}' && second == NULL,
+              "turn %" PRIu32 " event '%.*s'", turn->turn, (int)len, data);
+    turn->events++;
+    if (turn->cancelled) {
+        turn->events_late++;
+    }
+}
+
+// 与 chat_turn_cancel_cb 相同, 只有回复还在进行时才算被打断
+static void replay_turn_cancel_cb(app_turn_id_t turn, void *ctx)
+{
+    if (replay_reply_turn && replay_reply_turn->turn == turn) {
+        replay_reply_turn->cancelled = true;
+    }
+}
+
+// 录音结束后上传, 请求体与 chat_request 相同
+static void replay_upload(replay_turn_t *turn, uint8_t *record, size_t samples, esp_http_client_handle_t client)
+{
+    size_t len = sizeof(wav_header_t) + samples * sizeof(int16_t);
+    memset(record, 0, sizeof(wav_header_t));
+    turn->recorded = len;
+    app_replay_mark(APP_REPLAY_RECORDED, turn->recorded);
+
+    const app_multipart_part_t parts[] = {
+        { .name = "file", .filename = "test.mp3", .content_type = "audio/wav", .data = record, .len = len },
+        { .name = "format", .data = "wav", .len = strlen("wav") },
+        { .name = "convertMp3", .data = "true", .len = strlen("true") },
+    };
+    app_multipart_writer_t writer = {
+        .client = client,
+    };
+    CHECK(app_multipart_open(&writer, parts, 3) == ESP_OK);
+    CHECK(app_multipart_write_parts(&writer, parts, 3) == ESP_OK);
+    turn->uploaded = writer.sent;
+    app_replay_mark(APP_REPLAY_UPLOADED, writer.sent);
+    CHECK(writer.sent == app_multipart_length(parts, 3));
+    CHECK(client->write_len == (int)writer.sent && client->body_len == writer.sent);
+    CHECK(memmem(client->body, client->body_len, record, len) != NULL);
+}
+
+static uint32_t replay_wav_ms(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size * 1000 / (AUDIO_CODEC_SAMPLE_RATE * sizeof(int16_t)) : 0;
+}
+
+static int replay_check(void)
+{
+    uint64_t tail_sum = 0;
+    uint32_t tail_count = 0;
+    for (size_t i = 1; i <= replay_turn_count; i++) {
+        const replay_turn_t *turn = &replay_turns[i];
+        const replay_expect_t *expect = &replay_expects[i];
+        printf("turn %zu: wake %" PRIu32 " ms, %s at %" PRIu32 " ms, tail %" PRIu32 " ms, recorded %" PRIu32 " B, "
+               "uploaded %" PRIu32 " B, events %" PRIu32 "/%" PRIu32 "%s\n",
+               i, turn->wake_ms, replay_result_name(turn->result), turn->end_ms, turn->tail_ms, turn->recorded,
+               turn->uploaded, turn->events, replay_reply_events, turn->cancelled ? ", cancelled" : "");
+
+        CHECK_MSG(turn->result != APP_LISTEN_CONTINUE, "turn %zu never ended", i);
+        CHECK_MSG(turn->events_late == 0, "turn %zu handled %" PRIu32 " events after cancel", i, turn->events_late);
+        if (turn->result == APP_LISTEN_END_OF_SPEECH) {
+            // 命令窗口里说完的话等到窗口关闭才结束, 这时静音时长由窗口决定
+            bool held = turn->end_ms <= turn->wake_ms + SR_STUB_MN_DURATION_MS + 2 * REPLAY_FRAME_MS;
+            CHECK_MSG(turn->tail_ms >= replay_endpoint_config.min_ms &&
+                      (held || turn->tail_ms <= replay_endpoint_config.max_ms * 3 / 2),
+                      "turn %zu tail %" PRIu32 " ms", i, turn->tail_ms);
+            tail_sum += turn->tail_ms;
+            tail_count++;
+        }
+        if (turn->result == APP_LISTEN_END_OF_SPEECH || turn->result == APP_LISTEN_NO_SPEECH) {
+            CHECK_MSG(turn->uploaded > turn->recorded, "turn %zu uploaded %" PRIu32 " B", i, turn->uploaded);
+            // 没被打断的回复必须完整, 被打断的不能完整
+            if (turn->reply_done && !turn->cancelled) {
+                CHECK_MSG(turn->events == replay_reply_events, "turn %zu got %" PRIu32 " events", i, turn->events);
+            }
+            if (turn->cancelled) {
+                CHECK_MSG(turn->events < replay_reply_events, "turn %zu not interrupted", i);
+            }
+        } else {
+            CHECK_MSG(turn->uploaded == 0 && turn->events == 0, "turn %zu uploaded a local command", i);
+        }
+        if (expect->used) {
+            CHECK_MSG(turn->result == expect->expect, "turn %zu: %s, expected %s", i,
+                      replay_result_name(turn->result), replay_result_name(expect->expect));
+            if (expect->expect == APP_LISTEN_COMMAND) {
+                CHECK_MSG(turn->command == expect->expect_command, "turn %zu command %d", i, turn->command);
+            }
+            CHECK_MSG(turn->cancelled == expect->expect_cancelled, "turn %zu cancelled %d", i, turn->cancelled);
+        }
+    }
+    for (size_t i = replay_turn_count + 1; i <= REPLAY_TURN_MAX; i++) {
+        CHECK_MSG(!replay_expects[i].used, "turn %zu expected but never woken", i);
+    }
+    if (tail_count) {
+        uint64_t mean = tail_sum / tail_count;
+        printf("end of speech: %" PRIu32 " turns, mean tail %" PRIu64 " ms, fixed 100-frame timeout %d ms\n",
+               tail_count, mean, REPLAY_FIXED_TAIL_MS);
+        CHECK(mean < REPLAY_FIXED_TAIL_MS);
+    }
+    return TEST_EXIT();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <recording.wav> <labels> <reply.sse>\n", argv[0]);
+        return 2;
+    }
+    size_t sse_len = 0;
+    char *sse = replay_load_file(argv[3], &sse_len);
+    if (sse == NULL || replay_load_labels(argv[2])) {
+        return 2;
+    }
+
+    // 录音按采样率节拍读取, 虚拟时钟让回放不必真的等待
+    host_clock_set_virtual(true);
+    ESP_ERROR_CHECK(app_replay_open(argv[1]));
+    ESP_ERROR_CHECK(app_turn_init(replay_turn_cancel_cb, NULL));
+
+    // 先完整解析一次回复, 得到事件总数
+    replay_turn_t *sse_turn = NULL;
+    app_sse_parser_handle_t parser = app_sse_parser_create(REPLAY_SSE_MAX_EVENT, APP_SSE_DISPATCH_LINE,
+                                                           replay_sse_event_cb, &sse_turn);
+    CHECK(parser != NULL);
+    CHECK(app_sse_parser_feed(parser, sse, sse_len) == ESP_OK);
+    app_sse_parser_finish(parser);
+    CHECK(replay_reply_events > 0);
+
+    sr_stub_t sr;
+    sr_stub_init(&sr, &replay_labels);
+    static app_listen_t listen;
+    app_listen_init(&listen, &replay_endpoint_config);
+
+    static int16_t stereo[SR_STUB_CHUNK * 2];
+    static int16_t feed[SR_STUB_CHUNK * 3];
+    static sr_stub_result_t res;
+    // 录音前留出 WAV 头的位置, 上传时整块发送
+    uint8_t *record = malloc(sizeof(wav_header_t) + REPLAY_RECORD_MAX * sizeof(int16_t));
+    int16_t *record_pcm = (int16_t *)(record + sizeof(wav_header_t));
+    size_t record_samples = 0;
+    bool recording = false;
+    esp_http_client_handle_t client = NULL;
+    size_t sse_pos = 0;
+    replay_turn_t *turn = NULL;
+
+    uint32_t total_ms = replay_wav_ms(argv[1]) + REPLAY_TAIL_MS;
+    for (uint32_t fetch_frames = 1; sr_stub_time_ms(&sr) < total_ms; fetch_frames++) {
+        ESP_ERROR_CHECK(app_replay_read(stereo, SR_STUB_CHUNK));
+        app_dsp_interleave_2to3(stereo, NULL, feed, SR_STUB_CHUNK);
+        sr_stub_process(&sr, feed, SR_STUB_CHUNK, &res);
+
+        if (res.wakeup_state == SR_STUB_WAKE_DETECTED) {
+            CHECK_MSG(replay_turn_count < REPLAY_TURN_MAX, "too many turns");
+            app_replay_mark(APP_REPLAY_WAKE, fetch_frames);
+            // 唤醒即开始新的一轮, 进行中的回复随之取消
+            turn = &replay_turns[++replay_turn_count];
+            turn->turn = app_turn_begin();
+            turn->wake_ms = sr_stub_time_ms(&sr);
+            turn->command = -1;
+            recording = true;
+            record_samples = 0;
+        } else if (res.wakeup_state == SR_STUB_WAKE_VERIFIED) {
+            sr_stub_mn_clean(&sr);
+            app_listen_start(&listen, true);
+            sr_stub_enable_wakenet(&sr, false);
+        }
+        if (recording) {
+            size_t n = res.samples < REPLAY_RECORD_MAX - record_samples ? res.samples : REPLAY_RECORD_MAX - record_samples;
+            memcpy(record_pcm + record_samples, res.data, n * sizeof(int16_t));
+            record_samples += n;
+        }
+
+        if (listen.active) {
+            app_listen_mn_t mn = APP_LISTEN_MN_NONE;
+            int command_id = -1;
+            if (listen.command_window) {
+                sr_stub_mn_t mn_state = sr_stub_mn_detect(&sr, &command_id);
+                mn = (mn_state == SR_STUB_MN_DETECTED) ? APP_LISTEN_MN_DETECTED
+                     : (mn_state == SR_STUB_MN_TIMEOUT) ? APP_LISTEN_MN_TIMEOUT : APP_LISTEN_MN_NONE;
+            }
+            app_listen_result_t result = app_listen_update(&listen, mn, res.speech, res.data, res.samples);
+            if (result != APP_LISTEN_CONTINUE) {
+                app_replay_mark(APP_REPLAY_END, fetch_frames);
+                sr_stub_enable_wakenet(&sr, true);
+                recording = false;
+                turn->result = result;
+                turn->end_ms = sr_stub_time_ms(&sr);
+                turn->tail_ms = listen.endpoint.silence_ms;
+                if (result == APP_LISTEN_COMMAND) {
+                    // 本地命令同样开始新的一轮, 录音不上传
+                    turn->command = command_id;
+                    app_turn_begin();
+                } else {
+                    if (client) {
+                        host_http_client_destroy(client);
+                    }
+                    client = host_http_client_create();
+                    replay_upload(turn, record, record_samples, client);
+                    CHECK(app_turn_attach(turn->turn, client) == ESP_OK);
+                    app_sse_parser_reset(parser);
+                    sse_turn = turn;
+                    sse_pos = 0;
+                    replay_reply_turn = turn;
+                }
+            }
+        }
+
+        // 回复按网络到达的节奏逐段送入解析器, 读取的任务在下一次轮询时发现这一轮已取消, 不再读取
+        if (replay_reply_turn) {
+            bool cancelled = app_turn_cancelled(replay_reply_turn->turn);
+            size_t n = sse_len - sse_pos < REPLAY_SSE_BYTES ? sse_len - sse_pos : REPLAY_SSE_BYTES;
+            if (!cancelled && n) {
+                CHECK(app_sse_parser_feed(parser, sse + sse_pos, n) == ESP_OK);
+                sse_pos += n;
+            }
+            if (cancelled || sse_pos == sse_len) {
+                if (!cancelled) {
+                    app_sse_parser_finish(parser);
+                }
+                replay_reply_turn->reply_done = true;
+                app_turn_detach(client);
+                replay_reply_turn = NULL;
+            }
+        }
+    }
+
+    int ret = replay_check();
+    if (client) {
+        host_http_client_destroy(client);
+    }
+    app_sse_parser_delete(parser);
+    free(record);
+    free(sse);
+    return ret;
+}
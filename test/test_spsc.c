@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "app_spsc.h"
+#include "test_util.h"
+
+#define SPSC_RECORDS        (100000)
+#define SPSC_RECORD_MAX     (700)       /*!< Larger than an AFE chunk of one channel */
+#define SPSC_RING_SIZE      (8192)
+
+// 记录格式: 4 字节序号, 2 字节长度, 之后是由序号决定的内容
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint16_t len;
+} spsc_record_head_t;
+
+static app_spsc_handle_t spsc_ring;
+static atomic_bool spsc_writer_done;
+static uint64_t spsc_bytes_written;
+
+static uint8_t spsc_pattern(uint32_t seq, size_t i)
+{
+    return (uint8_t)(seq * 31 + i * 7);
+}
+
+static void test_single_thread(void)
+{
+    CHECK(app_spsc_create(1000, MALLOC_CAP_INTERNAL) == NULL);
+    app_spsc_handle_t ring = app_spsc_create(64, MALLOC_CAP_INTERNAL);
+    uint8_t data[64];
+    for (int i = 0; i < 64; i++) {
+        data[i] = i;
+    }
+    CHECK(app_spsc_write(ring, data, 40));
+    CHECK(app_spsc_used(ring) == 40);
+    CHECK(!app_spsc_write(ring, data, 30));
+    CHECK(app_spsc_write_pos(ring) == 40);
+
+    const uint8_t *ptr;
+    CHECK(app_spsc_read_acquire(ring, &ptr) == 40 && memcmp(ptr, data, 40) == 0);
+    app_spsc_read_commit(ring, 40);
+
+    // 跨越缓冲区末尾的记录分两段读出
+    CHECK(app_spsc_write(ring, data, 50));
+    CHECK(app_spsc_read_acquire(ring, &ptr) == 24 && memcmp(ptr, data, 24) == 0);
+    app_spsc_read_commit(ring, 24);
+    CHECK(app_spsc_read_acquire(ring, &ptr) == 26 && memcmp(ptr, data + 24, 26) == 0);
+    app_spsc_read_commit(ring, 26);
+    CHECK(app_spsc_used(ring) == 0);
+    CHECK(app_spsc_read_acquire(ring, &ptr) == 0);
+
+    // 正好写满, 写入位置累计不回绕到缓冲区内
+    CHECK(app_spsc_write(ring, data, 64));
+    CHECK(!app_spsc_write(ring, data, 1));
+    CHECK(app_spsc_write_pos(ring) == 154);
+
+    app_spsc_stats_t stats;
+    app_spsc_get_stats(ring, &stats);
+    CHECK(stats.writes == 3 && stats.overruns == 2 && stats.dropped == 31 && stats.high_water == 64);
+    app_spsc_delete(ring);
+}
+
+// 写端: 与采集任务一样只管写, 放不下就丢弃整条记录
+static void spsc_writer_task(void *arg)
+{
+    uint8_t record[sizeof(spsc_record_head_t) + SPSC_RECORD_MAX];
+    uint32_t rnd = 7;
+    for (uint32_t seq = 0; seq < SPSC_RECORDS; seq++) {
+        rnd = rnd * 1103515245 + 12345;
+        spsc_record_head_t head = { .seq = seq, .len = 1 + (rnd >> 16) % SPSC_RECORD_MAX };
+        memcpy(record, &head, sizeof(head));
+        for (size_t i = 0; i < head.len; i++) {
+            record[sizeof(head) + i] = spsc_pattern(seq, i);
+        }
+        size_t len = sizeof(head) + head.len;
+        if (app_spsc_write(spsc_ring, record, len)) {
+            spsc_bytes_written += len;
+        } else {
+            // 满了就让出 CPU, 相当于等下一帧到来
+            taskYIELD();
+        }
+    }
+    atomic_store_explicit(&spsc_writer_done, true, memory_order_release);
+    vTaskDelete(NULL);
+}
+
+// 读端: 记录可能分段提交, 按字节流重新拼接后检查序号和内容
+static void test_two_threads(void)
+{
+    spsc_ring = app_spsc_create(SPSC_RING_SIZE, MALLOC_CAP_INTERNAL);
+    atomic_store(&spsc_writer_done, false);
+    TaskHandle_t writer;
+    CHECK(xTaskCreatePinnedToCore(spsc_writer_task, "writer", 4096, NULL, 5, &writer, 0) == pdPASS);
+
+    uint8_t record[sizeof(spsc_record_head_t) + SPSC_RECORD_MAX];
+    size_t have = 0;
+    spsc_record_head_t head = {0};
+    int64_t last_seq = -1;
+    uint32_t received = 0, gaps = 0, bad = 0;
+    uint64_t bytes_read = 0;
+    uint32_t rnd = 3;
+    while (true) {
+        bool done = atomic_load_explicit(&spsc_writer_done, memory_order_acquire);
+        const uint8_t *ptr;
+        size_t n = app_spsc_read_acquire(spsc_ring, &ptr);
+        if (n == 0) {
+            if (done) {
+                break;
+            }
+            taskYIELD();
+            continue;
+        }
+        // 每次只取一部分, 并不时停顿, 让写端遇到满的情况
+        rnd = rnd * 1103515245 + 12345;
+        n = MIN(n, 1 + (rnd >> 16) % 1024);
+        for (size_t i = 0; i < n; i++) {
+            record[have++] = ptr[i];
+            if (have == sizeof(head)) {
+                memcpy(&head, record, sizeof(head));
+                if (head.len == 0 || head.len > SPSC_RECORD_MAX) {
+                    bad++;
+                    have = 0;
+                }
+            } else if (have > sizeof(head) && have == sizeof(head) + head.len) {
+                for (size_t j = 0; j < head.len; j++) {
+                    bad += record[sizeof(head) + j] != spsc_pattern(head.seq, j);
+                }
+                bad += (int64_t)head.seq <= last_seq;
+                gaps += head.seq - last_seq - 1;
+                last_seq = head.seq;
+                received++;
+                have = 0;
+            }
+        }
+        app_spsc_read_commit(spsc_ring, n);
+        bytes_read += n;
+        if ((rnd >> 8) % 4096 == 0) {
+            vTaskDelay(1);
+        }
+    }
+    host_task_join(writer);
+
+    app_spsc_stats_t stats;
+    app_spsc_get_stats(spsc_ring, &stats);
+    printf("two threads: %u records received, %u dropped as overruns, high water %u of %d bytes\n",
+           received, stats.overruns, stats.high_water, SPSC_RING_SIZE);
+    CHECK(bad == 0);
+    CHECK(have == 0);
+    CHECK(received == stats.writes);
+    CHECK(received + stats.overruns == SPSC_RECORDS);
+    CHECK(gaps + (SPSC_RECORDS - 1 - last_seq) == stats.overruns);
+    CHECK(bytes_read == spsc_bytes_written);
+    CHECK(stats.overruns > 0);
+    CHECK(stats.high_water <= SPSC_RING_SIZE);
+    CHECK(app_spsc_used(spsc_ring) == 0);
+    app_spsc_delete(spsc_ring);
+}
+
+int main(void)
+{
+    RUN_TEST(test_single_thread);
+    RUN_TEST(test_two_threads);
+    return TEST_EXIT();
+}
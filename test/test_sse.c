@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "app_sse.h"
+#include "test_util.h"
+
+#define SSE_EVENT_MAX   (8)
+
+typedef struct {
+    char data[SSE_EVENT_MAX][128];
+    size_t count;
+} sse_events_t;
+
+static void sse_event_cb(const char *data, size_t len, void *user_ctx)
+{
+    sse_events_t *events = user_ctx;
+    CHECK(data[len] == '\0');
+    if (events->count < SSE_EVENT_MAX) {
+        snprintf(events->data[events->count], sizeof(events->data[0]), "%.*s", (int)len, data);
+    }
+    events->count++;
+}
+
+// 逐字节送入, 检验跨块的行拼接
+static void sse_feed_bytes(app_sse_parser_handle_t parser, const char *text)
+{
+    for (size_t i = 0; text[i]; i++) {
+        CHECK(app_sse_parser_feed(parser, &text[i], 1) == ESP_OK);
+    }
+}
+
+// 回归: 连续的 data: 行之间没有空行时, 每行都要在行结束时立即派发, 不能拼成一个事件等到流结束
+static void test_line_back_to_back(void)
+{
+    sse_events_t events = {0};
+    app_sse_parser_handle_t parser = app_sse_parser_create(256, APP_SSE_DISPATCH_LINE, sse_event_cb, &events);
+    sse_feed_bytes(parser, "data: {\"content\":\"a\"}\n");
+    CHECK(events.count == 1);
+    sse_feed_bytes(parser, "data: {\"content\":\"b\"}\r\ndata:{\"content\":\"c\"}\n");
+    CHECK(events.count == 3);
+    // 最后一行还没收完, 不派发
+    sse_feed_bytes(parser, "data: {\"content\":\"d\"}");
+    CHECK(events.count == 3);
+    app_sse_parser_finish(parser);
+    CHECK(events.count == 4);
+    CHECK(strcmp(events.data[0], "{\"content\":\"a\"}") == 0);
+    CHECK(strcmp(events.data[1], "{\"content\":\"b\"}") == 0);
+    CHECK(strcmp(events.data[2], "{\"content\":\"c\"}") == 0);
+    CHECK(strcmp(events.data[3], "{\"content\":\"d\"}") == 0);
+    app_sse_parser_delete(parser);
+}
+
+static void test_line_blank_and_comments(void)
+{
+    sse_events_t events = {0};
+    app_sse_parser_handle_t parser = app_sse_parser_create(256, APP_SSE_DISPATCH_LINE, sse_event_cb, &events);
+    const char *stream = ": keep-alive\n\nevent: message\nid: 7\ndata: one\n\n\ndata: two\n\n";
+    CHECK(app_sse_parser_feed(parser, stream, strlen(stream)) == ESP_OK);
+    CHECK(events.count == 2);
+    CHECK(strcmp(events.data[0], "one") == 0 && strcmp(events.data[1], "two") == 0);
+    app_sse_parser_finish(parser);
+    CHECK(events.count == 2);
+    app_sse_parser_delete(parser);
+}
+
+static void test_event_joins_lines(void)
+{
+    sse_events_t events = {0};
+    app_sse_parser_handle_t parser = app_sse_parser_create(256, APP_SSE_DISPATCH_EVENT, sse_event_cb, &events);
+    sse_feed_bytes(parser, "data: first\ndata: second\n");
+    CHECK(events.count == 0);
+    sse_feed_bytes(parser, "\r\n");
+    CHECK(events.count == 1);
+    CHECK(strcmp(events.data[0], "first\nsecond") == 0);
+    sse_feed_bytes(parser, "data: tail");
+    app_sse_parser_finish(parser);
+    CHECK(events.count == 2 && strcmp(events.data[1], "tail") == 0);
+    app_sse_parser_delete(parser);
+}
+
+static void test_overflow_and_reset(void)
+{
+    sse_events_t events = {0};
+    app_sse_parser_handle_t parser = app_sse_parser_create(16, APP_SSE_DISPATCH_LINE, sse_event_cb, &events);
+    // 超长的行被跳过, 后面的行不受影响
+    sse_feed_bytes(parser, "data: 0123456789abcdefghij\ndata: ok\n");
+    CHECK(events.count == 1 && strcmp(events.data[0], "ok") == 0);
+    // 复位丢弃半行
+    sse_feed_bytes(parser, "data: lost");
+    app_sse_parser_reset(parser);
+    sse_feed_bytes(parser, "data: new\n");
+    CHECK(events.count == 2 && strcmp(events.data[1], "new") == 0);
+    app_sse_parser_delete(parser);
+}
+
+int main(void)
+{
+    RUN_TEST(test_line_back_to_back);
+    RUN_TEST(test_line_blank_and_comments);
+    RUN_TEST(test_event_joins_lines);
+    RUN_TEST(test_overflow_and_reset);
+    return TEST_EXIT();
+}
@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);          \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_MSG(cond, format, ...) do {                                   \
+        if (!(cond)) {                                                      \
+            printf("FAIL %s:%d: %s: " format "\n", __FILE__, __LINE__, #cond, ##__VA_ARGS__); \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define RUN_TEST(fn) do {                                                   \
+        int before_ = test_failures;                                        \
+        fn();                                                               \
+        printf("%s %s\n", test_failures == before_ ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+#define TEST_EXIT() (test_failures ? 1 : 0)
+
+// 基准测试用的单调时钟, 不受虚拟时钟影响
+static inline double test_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}